@@ -1,6 +1,6 @@
 #include <string.h>
 
-#include <a2blocked.h>
+#include "a2blocked.h"
 #include "uarray2b.h"
 
 // define a private version of each function in A2Methods_T that we implement
@@ -51,6 +51,21 @@ static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
         UArray2b_map(array2, (applyfun *) apply, cl);
 }
 
+typedef void blockfun(int col, int row, int width, int height,
+                      UArray2b_T array2b, void *block, void *cl);
+
+void A2Blocked_map_blocks(A2 array2, A2Blocked_blockfun apply, void *cl)
+{
+        UArray2b_map_blocks(array2, (blockfun *) apply, cl);
+}
+
+void A2Blocked_map_region(A2 array2, int col, int row, int width, int height,
+                          A2Blocked_blockfun apply, void *cl)
+{
+        UArray2b_map_region(array2, col, row, width, height,
+                            (blockfun *) apply, cl);
+}
+
 struct small_closure {
         A2Methods_smallapplyfun *apply;
         void *cl;
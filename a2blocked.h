@@ -0,0 +1,31 @@
+#ifndef A2BLOCKED_INCLUDED
+#define A2BLOCKED_INCLUDED
+
+#include "a2methods.h"
+
+/* the A2Methods_T suite backed by UArray2b_T */
+extern A2Methods_T uarray2_methods_blocked;
+
+/*
+ * block-granular map of the blocked suite, see UArray2b_map_blocks: apply
+ * is called once per block with the block's origin, its extents inside
+ * the array and a pointer to its storage, whose rows are
+ * methods->blocksize(array2) elements apart
+ */
+typedef void A2Blocked_blockfun(int col, int row, int width, int height,
+                                A2Methods_UArray2 array2,
+                                A2Methods_Object *block, void *cl);
+
+extern void A2Blocked_map_blocks(A2Methods_UArray2 array2,
+                                 A2Blocked_blockfun apply, void *cl);
+
+/*
+ * the same over the width x height region at (col, row) only, see
+ * UArray2b_map_region: apply gets the part of each overlapped block inside
+ * the region and a pointer to its first element; other blocks are not read
+ */
+extern void A2Blocked_map_region(A2Methods_UArray2 array2, int col, int row,
+                                 int width, int height,
+                                 A2Blocked_blockfun apply, void *cl);
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ *     a2cursor.c
+ *     Locality
+ *
+ *     Implementation of the A2Cursor traversal (see a2cursor.h). Only the
+ *     row and block changes live here; stepping within a run is inline in
+ *     the header. Element pointers come from the public at() functions
+ *     once per run, relying on each UArray2 row and each UArray2b block
+ *     being contiguous (blocks are stored row by row, blocksize elements
+ *     per row).
+ */
+
+#include <stdlib.h>
+#include "assert.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "uarray2.h"
+#include "uarray2b.h"
+#include "a2cursor.h"
+
+/* mark cursor as past the end; deref is no longer allowed */
+static bool finish(struct A2Cursor *cursor)
+{
+        cursor->done     = true;
+        cursor->elem     = NULL;
+        cursor->span_end = NULL;
+        return false;
+}
+
+/* point cursor at the first element of the block whose origin is
+   (block_col, block_row) */
+static bool enter_block(struct A2Cursor *cursor)
+{
+        int bs = cursor->blocksize;
+        int cols = cursor->width - cursor->block_col;
+        int rows = cursor->height - cursor->block_row;
+
+        cursor->block_cols   = cols < bs ? cols : bs;
+        cursor->block_rows   = rows < bs ? rows : bs;
+        cursor->row_in_block = 0;
+        cursor->block_base   = UArray2b_at(cursor->array2, cursor->block_col,
+                                           cursor->block_row);
+        cursor->col      = cursor->block_col;
+        cursor->row      = cursor->block_row;
+        cursor->elem     = cursor->block_base;
+        cursor->span_end = cursor->elem +
+                           (size_t)cursor->block_cols * cursor->size;
+        return true;
+}
+
+/* point cursor at the first element of plain row cursor->row */
+static bool enter_row(struct A2Cursor *cursor)
+{
+        if (cursor->row >= cursor->height || cursor->width == 0) {
+                return finish(cursor);
+        }
+        cursor->col      = 0;
+        cursor->elem     = UArray2_at(cursor->array2, 0, cursor->row);
+        cursor->span_end = cursor->elem +
+                           (size_t)cursor->width * cursor->size;
+        return true;
+}
+
+/*
+ * Name: A2Cursor_start
+ * 
+ * Description: positions a cursor on the first element of an array, in
+ * the array's native order
+ *
+ * Parameters:
+ *           struct A2Cursor *cursor: the cursor to initialize
+ *           A2Methods_T methods: the methods array2 was created with
+ *           A2Methods_UArray2 array2: the array to walk
+ *        
+ * Returns: None
+ * 
+ * Expects: methods is uarray2_methods_plain or uarray2_methods_blocked
+ * 
+ * Notes: cursor->done is true right away for an empty array. Results in a
+ * checked runtime error for NULL arguments or any other methods suite
+ */
+void A2Cursor_start(struct A2Cursor *cursor, A2Methods_T methods,
+                    A2Methods_UArray2 array2)
+{
+        assert(cursor != NULL && array2 != NULL);
+        assert(methods == uarray2_methods_plain ||
+               methods == uarray2_methods_blocked);
+
+        cursor->array2  = array2;
+        cursor->blocked = (methods == uarray2_methods_blocked);
+        cursor->done    = false;
+        cursor->width   = methods->width(array2);
+        cursor->height  = methods->height(array2);
+        cursor->size    = methods->size(array2);
+        cursor->blocksize = methods->blocksize(array2);
+        cursor->block_col = 0;
+        cursor->block_row = 0;
+        cursor->row = 0;
+
+        if (cursor->blocked) {
+                enter_block(cursor);
+        } else {
+                enter_row(cursor);
+        }
+}
+
+/*
+ * Name: A2Cursor_next_row
+ * 
+ * Description: moves a cursor to the start of the next row; for a blocked
+ * array this is the next row of the current block, or the first row of the
+ * next block once the current one is exhausted
+ *
+ * Parameters:
+ *           struct A2Cursor *cursor: the cursor to move
+ *        
+ * Returns: true if the cursor is on an element, false if the array is
+ * exhausted
+ * 
+ * Expects: cursor was started with A2Cursor_start
+ * 
+ * Notes: calling it on a finished cursor keeps returning false
+ */
+bool A2Cursor_next_row(struct A2Cursor *cursor)
+{
+        assert(cursor != NULL);
+        if (cursor->done) {
+                return false;
+        }
+        if (!cursor->blocked) {
+                cursor->row++;
+                return enter_row(cursor);
+        }
+
+        cursor->row_in_block++;
+        if (cursor->row_in_block == cursor->block_rows) {
+                return A2Cursor_next_block(cursor);
+        }
+        cursor->row++;
+        cursor->col      = cursor->block_col;
+        cursor->elem     = cursor->block_base + (size_t)cursor->row_in_block *
+                                                cursor->blocksize *
+                                                cursor->size;
+        cursor->span_end = cursor->elem +
+                           (size_t)cursor->block_cols * cursor->size;
+        return true;
+}
+
+/*
+ * Name: A2Cursor_next_block
+ * 
+ * Description: moves a cursor to the first element of the next block, in
+ * the block order of UArray2b_map; each row of a plain array is a block
+ *
+ * Parameters:
+ *           struct A2Cursor *cursor: the cursor to move
+ *        
+ * Returns: true if the cursor is on an element, false if the array is
+ * exhausted
+ * 
+ * Expects: cursor was started with A2Cursor_start
+ * 
+ * Notes: calling it on a finished cursor keeps returning false
+ */
+bool A2Cursor_next_block(struct A2Cursor *cursor)
+{
+        assert(cursor != NULL);
+        if (cursor->done) {
+                return false;
+        }
+        if (!cursor->blocked) {
+                cursor->row++;
+                return enter_row(cursor);
+        }
+
+        cursor->block_col += cursor->blocksize;
+        if (cursor->block_col >= cursor->width) {
+                cursor->block_col = 0;
+                cursor->block_row += cursor->blocksize;
+                if (cursor->block_row >= cursor->height) {
+                        return finish(cursor);
+                }
+        }
+        return enter_block(cursor);
+}
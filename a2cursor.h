@@ -0,0 +1,90 @@
+#ifndef A2CURSOR_INCLUDED
+#define A2CURSOR_INCLUDED
+/****************************************************************
+ *
+ *                         a2cursor.h
+ *
+ *       Interface to struct A2Cursor, which walks a plain (UArray2) or
+ *       blocked (UArray2b) array element by element in the array's
+ *       native order: row-major for plain arrays, block-major (blocks
+ *       row by row, each block row by row) for blocked arrays. That is
+ *       map_default's order for plain arrays and for blocked arrays whose
+ *       blocks are not tiled; map_default visits a tiled block (one
+ *       larger than UARRAY2B_TILED_TILES tile budgets, see uarray2b.h)
+ *       tile by tile, while the cursor still walks it row by row.
+ *
+ *       The cursor keeps a pointer into the current row (or row of a
+ *       block) and only moves it, so stepping costs an add and a
+ *       compare; the array is consulted again only when a row or block
+ *       runs out. Unlike the map functions, the client drives the loop,
+ *       so two cursors can walk a source and a destination in lockstep.
+ *
+ *       Usage:
+ *
+ *       struct A2Cursor src, dst;
+ *       A2Cursor_start(&src, methods, source);
+ *       A2Cursor_start(&dst, methods, dest);
+ *       for (bool more = !src.done; more; ) {
+ *               *(T *)A2Cursor_deref(&dst) = *(T *)A2Cursor_deref(&src);
+ *               more = A2Cursor_advance(&src) & A2Cursor_advance(&dst);
+ *       }
+ *
+ *       col and row always hold the position of the current element.
+ *       The other fields are private to a2cursor.c. Cursors are plain
+ *       values: they need no freeing and are invalidated by freeing the
+ *       array they walk.
+ *
+ *****************************************************************/
+
+#include <stdbool.h>
+#include "a2methods.h"
+
+struct A2Cursor {
+        int col, row;           /* position of the current element */
+        bool done;              /* walked past the last element */
+
+        /* private */
+        char *elem;             /* current element */
+        char *span_end;         /* one past the end of the current run */
+        int size;               /* bytes per element */
+        A2Methods_UArray2 array2;
+        bool blocked;
+        int width, height;
+        int blocksize;          /* 1 for plain arrays */
+        int block_col, block_row;       /* origin of the current block */
+        int block_cols, block_rows;     /* its extents inside the array */
+        int row_in_block;
+        char *block_base;
+};
+
+/* position cursor on the first element of array2, which must belong to
+   uarray2_methods_plain or uarray2_methods_blocked */
+extern void A2Cursor_start(struct A2Cursor *cursor, A2Methods_T methods,
+                           A2Methods_UArray2 array2);
+
+/* move to the first element of the next row (plain) or the next row of the
+   current block (blocked); returns false once the array is exhausted */
+extern bool A2Cursor_next_row(struct A2Cursor *cursor);
+
+/* move to the first element of the next block; for a plain array each row
+   is a block. Returns false once the array is exhausted */
+extern bool A2Cursor_next_block(struct A2Cursor *cursor);
+
+static inline A2Methods_Object *A2Cursor_deref(struct A2Cursor *cursor)
+{
+        return cursor->elem;
+}
+
+/* move to the next element in native order; returns false once the
+   array is exhausted */
+static inline bool A2Cursor_advance(struct A2Cursor *cursor)
+{
+        cursor->elem += cursor->size;
+        cursor->col++;
+        if (cursor->elem != cursor->span_end) {
+                return true;
+        }
+        return A2Cursor_next_row(cursor);
+}
+
+#endif
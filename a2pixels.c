@@ -0,0 +1,65 @@
+/*
+ *     a2pixels.c
+ *     Locality
+ *
+ *     Implementation of struct A2Pixels (see a2pixels.h): building and
+ *     freeing the row or block pointer tables. Lookups are inline in the
+ *     header.
+ */
+
+#include <stdlib.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "uarray2.h"
+#include "uarray2b.h"
+#include "a2pixels.h"
+
+void A2Pixels_open(struct A2Pixels *pixels, A2Methods_T methods,
+                   A2Methods_UArray2 array2)
+{
+        assert(pixels != NULL && methods != NULL && array2 != NULL);
+        assert(methods->size(array2) == sizeof(struct Pnm_rgb));
+        pixels->width       = methods->width(array2);
+        pixels->height      = methods->height(array2);
+        pixels->methods     = methods;
+        pixels->array2      = array2;
+        pixels->rows        = NULL;
+        pixels->blocks      = NULL;
+        pixels->blocksize   = methods->blocksize(array2);
+        pixels->block_width = 0;
+
+        if (methods == uarray2_methods_plain && pixels->width > 0) {
+                pixels->rows = ALLOC((long)(pixels->height + 1) *
+                                     sizeof(*pixels->rows));
+                for (int j = 0; j < pixels->height; j++) {
+                        pixels->rows[j] = UArray2_at(array2, 0, j);
+                }
+        } else if (methods == uarray2_methods_blocked) {
+                int bs = pixels->blocksize;
+                int block_height = (pixels->height + bs - 1) / bs;
+                pixels->block_width = (pixels->width + bs - 1) / bs;
+                pixels->blocks = ALLOC((long)pixels->block_width *
+                                       block_height * sizeof(*pixels->blocks));
+                for (int by = 0; by < block_height; by++) {
+                        for (int bx = 0; bx < pixels->block_width; bx++) {
+                                pixels->blocks[by * pixels->block_width + bx]
+                                        = UArray2b_at(array2, bx * bs,
+                                                      by * bs);
+                        }
+                }
+        }
+}
+
+void A2Pixels_close(struct A2Pixels *pixels)
+{
+        assert(pixels != NULL);
+        if (pixels->rows != NULL) {
+                FREE(pixels->rows);
+        }
+        if (pixels->blocks != NULL) {
+                FREE(pixels->blocks);
+        }
+}
@@ -0,0 +1,69 @@
+#ifndef A2PIXELS_INCLUDED
+#define A2PIXELS_INCLUDED
+/****************************************************************
+ *
+ *                         a2pixels.h
+ *
+ *       Interface to struct A2Pixels, random access to the Pnm_rgb
+ *       pixels of a plain (UArray2) or blocked (UArray2b) array
+ *       without a call through the methods table per pixel. Opening
+ *       builds a table of row pointers (plain) or block pointers
+ *       (blocked) once; A2Pixels_at is then an inline lookup. Arrays
+ *       of any other suite go through at() as usual.
+ *
+ *       Usage:
+ *
+ *       struct A2Pixels src;
+ *       A2Pixels_open(&src, methods, source);
+ *       ... A2Pixels_at(&src, i, j)->red ...
+ *       A2Pixels_close(&src);
+ *
+ *       The table relies on each UArray2 row and each UArray2b block
+ *       being contiguous, blocks stored row by row (see uarray2b.c).
+ *       Any number of threads may call A2Pixels_at on the same open
+ *       struct. width and height are public; the other fields are
+ *       private to a2pixels.c.
+ *
+ *****************************************************************/
+
+#include "a2methods.h"
+#include "pnm.h"
+
+struct A2Pixels {
+        int width, height;
+
+        /* private */
+        A2Methods_T methods;
+        A2Methods_UArray2 array2;
+        struct Pnm_rgb **rows;          /* plain: one per row */
+        struct Pnm_rgb **blocks;        /* blocked: row of blocks by row */
+        int blocksize, block_width;
+};
+
+extern void A2Pixels_open(struct A2Pixels *pixels, A2Methods_T methods,
+                          A2Methods_UArray2 array2);
+extern void A2Pixels_close(struct A2Pixels *pixels);
+
+/* the pixel at (i, j), which must be inside the array */
+static inline struct Pnm_rgb *A2Pixels_at(const struct A2Pixels *pixels,
+                                          int i, int j)
+{
+        if (pixels->rows != NULL) {
+                return &pixels->rows[j][i];
+        }
+        if (pixels->blocks != NULL) {
+                int bs = pixels->blocksize;
+                return &pixels->blocks[(j / bs) * pixels->block_width +
+                                       i / bs][(j % bs) * bs + i % bs];
+        }
+        return pixels->methods->at(pixels->array2, i, j);
+}
+
+/* v clamped to [0, hi]: the column or row of the edge pixel that stands in
+   for one outside the image */
+static inline int A2Pixels_clamp(int v, int hi)
+{
+        return v < 0 ? 0 : v > hi ? hi : v;
+}
+
+#endif
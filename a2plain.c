@@ -12,7 +12,7 @@
 
 
 #include <string.h>
-#include <a2plain.h>
+#include "a2plain.h"
 #include "uarray2.h"
 
 
@@ -108,6 +108,30 @@ static void map_col_major(A2Methods_UArray2 uarray2,
         UArray2_map_col_major(uarray2, (UArray2_applyfun*)apply, cl);
 }
 
+/* Apply the function apply once per row of the A2Methods_UArray2 uarray2, top
+to bottom, with a pointer to the row's contiguous elements */
+void A2Plain_map_row_spans(A2Methods_UArray2 uarray2, A2Plain_spanfun apply,
+                           void *cl)
+{
+        UArray2_map_row_spans(uarray2, (UArray2_spanfun *)apply, cl);
+}
+
+/* Return a width x height view of the A2Methods_UArray2 uarray2 starting at
+(i, j), sharing its elements */
+A2Methods_UArray2 A2Plain_view(A2Methods_UArray2 uarray2, int i, int j,
+                               int width, int height)
+{
+        return UArray2_view(uarray2, i, j, width, height);
+}
+
+/* Apply the function apply to each element of the A2Methods_UArray2 uarray2 in
+cache-oblivious order, passing cl as an additional argument */
+void A2Plain_map_cache_oblivious(A2Methods_UArray2 uarray2,
+                                 A2Methods_applyfun apply, void *cl)
+{
+        UArray2_map_cache_oblivious(uarray2, (UArray2_applyfun *)apply, cl);
+}
+
 /******************************************************************************/
                         /* THIS PART WAS PROVIDED */
 /******************************************************************************/
@@ -0,0 +1,37 @@
+#ifndef A2PLAIN_INCLUDED
+#define A2PLAIN_INCLUDED
+
+#include "a2methods.h"
+
+/* the A2Methods_T suite backed by UArray2_T */
+extern A2Methods_T uarray2_methods_plain;
+
+/*
+ * row-span map of the plain suite, see UArray2_map_row_spans: apply is
+ * called once per row, in order, with the row index, the row's width and
+ * a pointer to its width contiguous elements
+ */
+typedef void A2Plain_spanfun(int j, int width, A2Methods_UArray2 array2,
+                             A2Methods_Object *row, void *cl);
+
+extern void A2Plain_map_row_spans(A2Methods_UArray2 array2,
+                                  A2Plain_spanfun apply, void *cl);
+
+/*
+ * cache-oblivious map of the plain suite, see UArray2_map_cache_oblivious:
+ * a recursive split of the array along its longer side, so that nearby
+ * elements are visited together at every cache level without a blocksize.
+ * It has the type of the suite's other maps (A2Methods_mapfun)
+ */
+extern void A2Plain_map_cache_oblivious(A2Methods_UArray2 array2,
+                                        A2Methods_applyfun apply, void *cl);
+
+/*
+ * zero-copy region of a plain array, see UArray2_view: a width x height
+ * array of the suite whose (0, 0) is (i, j) of array2 and whose elements
+ * are array2's. Free it with the suite's free before array2
+ */
+extern A2Methods_UArray2 A2Plain_view(A2Methods_UArray2 array2, int i, int j,
+                                      int width, int height);
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ *     a2sim.c
+ *     Locality
+ *
+ *     This file implements the instrumented A2Methods suite declared in
+ *     a2sim.h. Everything but at() and the maps is forwarded unchanged.
+ *     at() reports the element it returns, and the maps wrap the client's
+ *     apply function in one that reports each element before calling it.
+ *     A map the wrapped suite does not provide stays NULL.
+ */
+
+#include <stdlib.h>
+#include "assert.h"
+#include "a2methods.h"
+#include "cachesim.h"
+#include "a2sim.h"
+
+typedef A2Methods_UArray2 A2;
+
+static A2Methods_T inner;
+static CacheSim_T  sim;
+static A2Methods_mapfun *extra;     /* the map wrapped by A2Sim_map */
+
+static A2 new(int width, int height, int size)
+{
+        return inner->new(width, height, size);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        return inner->new_with_blocksize(width, height, size, blocksize);
+}
+
+static void a2free(A2 *array2p)
+{
+        inner->free(array2p);
+}
+
+static int width(A2 array2)
+{
+        return inner->width(array2);
+}
+
+static int height(A2 array2)
+{
+        return inner->height(array2);
+}
+
+static int size(A2 array2)
+{
+        return inner->size(array2);
+}
+
+static int blocksize(A2 array2)
+{
+        return inner->blocksize(array2);
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        A2Methods_Object *elem = inner->at(array2, i, j);
+        CacheSim_access(sim, elem, inner->size(array2));
+        return elem;
+}
+
+/* struct to call the client's apply function after recording the access */
+struct sim_closure {
+        A2Methods_applyfun      *apply;
+        A2Methods_smallapplyfun *small_apply;
+        void                    *cl;
+        int                      size;
+};
+
+static void apply_sim(int i, int j, A2 array2, void *elem, void *vcl)
+{
+        struct sim_closure *cl = vcl;
+        CacheSim_access(sim, elem, cl->size);
+        cl->apply(i, j, array2, elem, cl->cl);
+}
+
+static void small_apply_sim(void *elem, void *vcl)
+{
+        struct sim_closure *cl = vcl;
+        CacheSim_access(sim, elem, cl->size);
+        cl->small_apply(elem, cl->cl);
+}
+
+static void map_row_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        struct sim_closure mycl = { apply, NULL, cl, inner->size(array2) };
+        inner->map_row_major(array2, apply_sim, &mycl);
+}
+
+static void map_col_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        struct sim_closure mycl = { apply, NULL, cl, inner->size(array2) };
+        inner->map_col_major(array2, apply_sim, &mycl);
+}
+
+static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        struct sim_closure mycl = { apply, NULL, cl, inner->size(array2) };
+        inner->map_block_major(array2, apply_sim, &mycl);
+}
+
+static void map_default(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        struct sim_closure mycl = { apply, NULL, cl, inner->size(array2) };
+        inner->map_default(array2, apply_sim, &mycl);
+}
+
+static void map_extra(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        struct sim_closure mycl = { apply, NULL, cl, inner->size(array2) };
+        extra(array2, apply_sim, &mycl);
+}
+
+static void small_map_row_major(A2 array2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct sim_closure mycl = { NULL, apply, cl, inner->size(array2) };
+        inner->small_map_row_major(array2, small_apply_sim, &mycl);
+}
+
+static void small_map_col_major(A2 array2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct sim_closure mycl = { NULL, apply, cl, inner->size(array2) };
+        inner->small_map_col_major(array2, small_apply_sim, &mycl);
+}
+
+static void small_map_block_major(A2 array2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        struct sim_closure mycl = { NULL, apply, cl, inner->size(array2) };
+        inner->small_map_block_major(array2, small_apply_sim, &mycl);
+}
+
+static void small_map_default(A2 array2, A2Methods_smallapplyfun apply,
+                              void *cl)
+{
+        struct sim_closure mycl = { NULL, apply, cl, inner->size(array2) };
+        inner->small_map_default(array2, small_apply_sim, &mycl);
+}
+
+static struct A2Methods_T uarray2_methods_sim_struct;
+
+/*
+ * Name: A2Sim_wrap
+ * 
+ * Description: makes the instrumented suite forward to methods and report
+ * element accesses to cachesim
+ *
+ * Parameters:
+ *           A2Methods_T methods: the suite to instrument
+ *           CacheSim_T cachesim: the simulator that receives the accesses
+ *        
+ * Returns: the instrumented suite
+ * 
+ * Expects: methods and cachesim are not NULL
+ * 
+ * Notes: a previously returned suite now forwards to the new methods
+ */
+A2Methods_T A2Sim_wrap(A2Methods_T methods, CacheSim_T cachesim)
+{
+        assert(methods != NULL && cachesim != NULL);
+        inner = methods;
+        sim   = cachesim;
+
+        struct A2Methods_T wrapped = {
+                new,
+                new_with_blocksize,
+                a2free,
+                width,
+                height,
+                size,
+                blocksize,
+                at,
+                methods->map_row_major   ? map_row_major   : NULL,
+                methods->map_col_major   ? map_col_major   : NULL,
+                methods->map_block_major ? map_block_major : NULL,
+                methods->map_default     ? map_default     : NULL,
+                methods->small_map_row_major   ? small_map_row_major : NULL,
+                methods->small_map_col_major   ? small_map_col_major : NULL,
+                methods->small_map_block_major ? small_map_block_major
+                                               : NULL,
+                methods->small_map_default     ? small_map_default : NULL,
+        };
+        uarray2_methods_sim_struct = wrapped;
+        return &uarray2_methods_sim_struct;
+}
+
+/* a map that reports every element it visits through the simulator of the
+   last A2Sim_wrap before calling apply; map must work on the arrays of the
+   suite that was wrapped */
+A2Methods_mapfun *A2Sim_map(A2Methods_mapfun *map)
+{
+        assert(map != NULL && inner != NULL);
+        extra = map;
+        return map_extra;
+}
@@ -0,0 +1,27 @@
+/*
+ *     a2sim.h
+ *     Locality
+ *
+ *     Interface to an instrumented A2Methods suite. A2Sim_wrap returns
+ *     methods that behave exactly like the methods they wrap, but every
+ *     element address handed out by at() or passed to an apply function
+ *     during a map is also replayed through a cache simulator.
+ *
+ *     A2Sim_map instruments a map that works on the wrapped suite's
+ *     arrays but is not in its table, such as A2Plain_map_cache_oblivious.
+ *
+ *     The wrapper keeps its state in static variables, so only one
+ *     wrapped suite and one extra map exist at a time; wrapping again
+ *     replaces them.
+ */
+
+#ifndef A2SIM_INCLUDED
+#define A2SIM_INCLUDED
+
+#include "a2methods.h"
+#include "cachesim.h"
+
+extern A2Methods_T A2Sim_wrap(A2Methods_T methods, CacheSim_T cachesim);
+extern A2Methods_mapfun *A2Sim_map(A2Methods_mapfun *map);
+
+#endif
@@ -0,0 +1,538 @@
+/*
+ *     a2special.h
+ *     Locality
+ *
+ *     Header-only, compile-time specialized map+apply loops. Each
+ *     A2SPECIAL_DEFINE_* macro expands to a static function for one
+ *     (storage backend, traversal, element type, operation), in which the
+ *     operation's coordinate mapping is a macro expanded straight into
+ *     the traversal loop. Nothing goes through A2Methods_applyfun or the
+ *     methods table, so the compiler sees a plain copy loop it can
+ *     optimize like a hand-written one.
+ *
+ *     An operation OP is a macro OP(i, j, w, h, di, dj) that, given the
+ *     source position (i, j) in a w x h image, assigns the destination
+ *     position to the lvalues di and dj. Its inverse GOP(di, dj, w, h, i, j)
+ *     gives the source position of a destination position, w and h still
+ *     being the source dimensions. The plain _ROW/_COL/_CO and _BLOCKED
+ *     kernels scatter: they walk the source and write to remapped
+ *     positions. The _GATHER_ kernels walk the destination in the same
+ *     orders and read from remapped positions instead. The _STREAM_
+ *     kernels gather like the plain row-major and blocked ones, but into a
+ *     small buffer that stays in cache, which is then copied out with
+ *     non-temporal stores. Those bypass the cache, so a destination larger
+ *     than the last-level cache does not evict the source; full aligned
+ *     16-byte stores let the write-combining buffers emit whole lines.
+ *
+ *     Usage:
+ *
+ *     A2SPECIAL_DEFINE_PLAIN_ROW(rot90, struct Pnm_rgb, A2SPECIAL_ROTATE90)
+ *     ...
+ *     rot90(source, dest);     source, dest are UArray2_T
+ *
+ *     The generated functions take void pointers so that they share the
+ *     type of every other specialization (see Transform_kernel).
+ *
+ *     The functions look up a row (or block) pointer once with the public
+ *     at() and then index it directly. They therefore rely on each row of
+ *     a UArray2_T being contiguous, and on each block of a UArray2b_T
+ *     being a contiguous blocksize x blocksize array stored row by row
+ *     (see UArray2b_at in uarray2b.c).
+ */
+
+#ifndef A2SPECIAL_INCLUDED
+#define A2SPECIAL_INCLUDED
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "assert.h"
+#include "uarray2.h"
+#include "uarray2b.h"
+
+/* coordinate mappings of the ppmtrans operations */
+#define A2SPECIAL_ROTATE0(i, j, w, h, di, dj) \
+        ((di) = (i), (dj) = (j))
+#define A2SPECIAL_ROTATE90(i, j, w, h, di, dj) \
+        ((di) = (h) - (j) - 1, (dj) = (i))
+#define A2SPECIAL_ROTATE180(i, j, w, h, di, dj) \
+        ((di) = (w) - (i) - 1, (dj) = (h) - (j) - 1)
+#define A2SPECIAL_ROTATE270(i, j, w, h, di, dj) \
+        ((di) = (j), (dj) = (w) - (i) - 1)
+#define A2SPECIAL_FLIP_HORIZONTAL(i, j, w, h, di, dj) \
+        ((di) = (w) - (i) - 1, (dj) = (j))
+#define A2SPECIAL_FLIP_VERTICAL(i, j, w, h, di, dj) \
+        ((di) = (i), (dj) = (h) - (j) - 1)
+#define A2SPECIAL_TRANSPOSE(i, j, w, h, di, dj) \
+        ((di) = (j), (dj) = (i))
+
+/* elements gathered into the buffer of a streaming kernel per flush */
+#define A2SPECIAL_STREAM_RUN 256
+
+/*
+ * copy n bytes to dst with non-temporal stores, 16 aligned bytes at a
+ * time, where the target supports them (SSE2); the unaligned head and
+ * tail, and everything on other targets, are copied normally
+ */
+static inline void a2special_stream(void *dst, const void *src, size_t n)
+{
+#if defined(__SSE2__)
+        char *d = dst;
+        const char *s = src;
+        size_t head = (16 - (uintptr_t)d % 16) % 16;
+        if (head > n) {
+                head = n;
+        }
+        memcpy(d, s, head);
+        size_t k = head;
+        for (; k + 16 <= n; k += 16) {
+                __m128i line = _mm_loadu_si128((const __m128i *)(s + k));
+                _mm_stream_si128((__m128i *)(d + k), line);
+        }
+        memcpy(d + k, s + k, n - k);
+#else
+        memcpy(dst, src, n);
+#endif
+}
+
+/* order the non-temporal stores before anything that follows */
+static inline void a2special_stream_fence(void)
+{
+#if defined(__SSE2__)
+        _mm_sfence();
+#endif
+}
+
+/* inverse coordinate mappings, for gathering */
+#define A2SPECIAL_GATHER_ROTATE0(di, dj, w, h, i, j) \
+        ((i) = (di), (j) = (dj))
+#define A2SPECIAL_GATHER_ROTATE90(di, dj, w, h, i, j) \
+        ((i) = (dj), (j) = (h) - (di) - 1)
+#define A2SPECIAL_GATHER_ROTATE180(di, dj, w, h, i, j) \
+        ((i) = (w) - (di) - 1, (j) = (h) - (dj) - 1)
+#define A2SPECIAL_GATHER_ROTATE270(di, dj, w, h, i, j) \
+        ((i) = (w) - (dj) - 1, (j) = (di))
+#define A2SPECIAL_GATHER_FLIP_HORIZONTAL(di, dj, w, h, i, j) \
+        ((i) = (w) - (di) - 1, (j) = (dj))
+#define A2SPECIAL_GATHER_FLIP_VERTICAL(di, dj, w, h, i, j) \
+        ((i) = (di), (j) = (h) - (dj) - 1)
+#define A2SPECIAL_GATHER_TRANSPOSE(di, dj, w, h, i, j) \
+        ((i) = (dj), (j) = (di))
+
+/* table of destination row pointers, one per row of a UArray2_T */
+#define A2SPECIAL_ROWS_(TYPE, ROWS, A) do {                                  \
+        int h_ = UArray2_height(A);                                          \
+        ROWS = malloc((size_t)h_ * sizeof(*(ROWS)));                         \
+        assert(ROWS != NULL);                                                \
+        for (int r_ = 0; r_ < h_; r_++)                                      \
+                (ROWS)[r_] = UArray2_at((A), 0, r_);                         \
+} while (0)
+
+/* table of block pointers of a UArray2b_T, row of blocks by row */
+#define A2SPECIAL_BLOCKS_(TYPE, BLOCKS, BW, A) do {                          \
+        int bs_ = UArray2b_blocksize(A);                                     \
+        int bh_ = (UArray2b_height(A) + bs_ - 1) / bs_;                      \
+        BW = (UArray2b_width(A) + bs_ - 1) / bs_;                            \
+        BLOCKS = malloc((size_t)(BW) * bh_ * sizeof(*(BLOCKS)));             \
+        assert(BLOCKS != NULL);                                              \
+        for (int by_ = 0; by_ < bh_; by_++)                                  \
+                for (int bx_ = 0; bx_ < (BW); bx_++)                         \
+                        (BLOCKS)[by_ * (BW) + bx_] =                         \
+                                UArray2b_at((A), bx_ * bs_, by_ * bs_);      \
+} while (0)
+
+/*
+ * A2SPECIAL_DEFINE_PLAIN_ROW / _COL: void NAME(void *src, void *dst)
+ * copies every element of the UArray2_T src to its OP position in the
+ * UArray2_T dst, visiting src in row-major (or column-major) order
+ */
+#define A2SPECIAL_DEFINE_PLAIN_ROW(NAME, TYPE, OP)                           \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2_T src = source, dst = dest;                                  \
+        int w = UArray2_width(src), h = UArray2_height(src);                 \
+        TYPE **drows;                                                        \
+        A2SPECIAL_ROWS_(TYPE, drows, dst);                                   \
+        for (int j = 0; j < h; j++) {                                        \
+                const TYPE *srow = UArray2_at(src, 0, j);                    \
+                for (int i = 0; i < w; i++) {                                \
+                        int di, dj;                                          \
+                        OP(i, j, w, h, di, dj);                              \
+                        drows[dj][di] = srow[i];                             \
+                }                                                            \
+        }                                                                    \
+        free(drows);                                                         \
+}
+
+#define A2SPECIAL_DEFINE_PLAIN_COL(NAME, TYPE, OP)                           \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2_T src = source, dst = dest;                                  \
+        int w = UArray2_width(src), h = UArray2_height(src);                 \
+        TYPE **srows, **drows;                                               \
+        A2SPECIAL_ROWS_(TYPE, srows, src);                                   \
+        A2SPECIAL_ROWS_(TYPE, drows, dst);                                   \
+        for (int i = 0; i < w; i++) {                                        \
+                for (int j = 0; j < h; j++) {                                \
+                        int di, dj;                                          \
+                        OP(i, j, w, h, di, dj);                              \
+                        drows[dj][di] = srows[j][i];                         \
+                }                                                            \
+        }                                                                    \
+        free(srows);                                                         \
+        free(drows);                                                         \
+}
+
+/*
+ * A2SPECIAL_DEFINE_PLAIN_CO: void NAME(void *src, void *dst)
+ * copies every element of the UArray2_T src to its OP position in the
+ * UArray2_T dst, visiting src in the order of UArray2_map_cache_oblivious.
+ * The recursion is in NAME_region_
+ */
+#define A2SPECIAL_DEFINE_PLAIN_CO(NAME, TYPE, OP)                            \
+static void NAME##_region_(TYPE **srows, TYPE **drows, int w, int h,         \
+                           int i0, int j0, int cols, int rows)               \
+{                                                                            \
+        if (cols > UARRAY2_CO_LEAF && cols >= rows) {                        \
+                int half = cols / 2;                                         \
+                NAME##_region_(srows, drows, w, h, i0, j0, half, rows);      \
+                NAME##_region_(srows, drows, w, h, i0 + half, j0,            \
+                               cols - half, rows);                           \
+        } else if (rows > UARRAY2_CO_LEAF) {                                 \
+                int half = rows / 2;                                         \
+                NAME##_region_(srows, drows, w, h, i0, j0, cols, half);      \
+                NAME##_region_(srows, drows, w, h, i0, j0 + half, cols,      \
+                               rows - half);                                 \
+        } else {                                                             \
+                for (int j = j0; j < j0 + rows; j++) {                       \
+                        const TYPE *srow = srows[j];                         \
+                        for (int i = i0; i < i0 + cols; i++) {               \
+                                int di, dj;                                  \
+                                OP(i, j, w, h, di, dj);                      \
+                                drows[dj][di] = srow[i];                     \
+                        }                                                    \
+                }                                                            \
+        }                                                                    \
+}                                                                            \
+                                                                             \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2_T src = source, dst = dest;                                  \
+        int w = UArray2_width(src), h = UArray2_height(src);                 \
+        if (w == 0 || h == 0) {                                              \
+                return;                                                      \
+        }                                                                    \
+        TYPE **srows, **drows;                                               \
+        A2SPECIAL_ROWS_(TYPE, srows, src);                                   \
+        A2SPECIAL_ROWS_(TYPE, drows, dst);                                   \
+        NAME##_region_(srows, drows, w, h, 0, 0, w, h);                      \
+        free(srows);                                                         \
+        free(drows);                                                         \
+}
+
+/*
+ * A2SPECIAL_DEFINE_BLOCKED: void NAME(void *src, void *dst)
+ * copies every element of the UArray2b_T src to its OP position in the
+ * UArray2b_T dst, visiting src block by block, and each block tile by
+ * tile, as UArray2b_map does. dst may have any blocksize
+ */
+#define A2SPECIAL_DEFINE_BLOCKED(NAME, TYPE, OP)                             \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2b_T src = source, dst = dest;                                 \
+        int w = UArray2b_width(src), h = UArray2b_height(src);               \
+        int bs = UArray2b_blocksize(src), dbs = UArray2b_blocksize(dst);     \
+        int ts = UArray2b_tilesize(src);                                     \
+        int bw, dbw;                                                         \
+        TYPE **sblocks, **dblocks;                                           \
+        A2SPECIAL_BLOCKS_(TYPE, sblocks, bw, src);                           \
+        A2SPECIAL_BLOCKS_(TYPE, dblocks, dbw, dst);                          \
+        int bh = (h + bs - 1) / bs;                                          \
+        for (int by = 0; by < bh; by++) {                                    \
+                int rows = h - by * bs < bs ? h - by * bs : bs;              \
+                for (int bx = 0; bx < bw; bx++) {                            \
+                        int cols = w - bx * bs < bs ? w - bx * bs : bs;      \
+                        const TYPE *block = sblocks[by * bw + bx];           \
+                        int tcols = (cols + ts - 1) / ts;                    \
+                        int tiles = (rows + ts - 1) / ts * tcols;            \
+                        for (int t = 0; t < tiles; t++) {                    \
+                                int r0 = t / tcols * ts;                     \
+                                int c0 = t % tcols * ts;                     \
+                                int rend = r0 + ts < rows ? r0 + ts : rows;  \
+                                int cend = c0 + ts < cols ? c0 + ts : cols;  \
+                                for (int r = r0; r < rend; r++) {            \
+                                        int j = by * bs + r;                 \
+                                        for (int c = c0; c < cend; c++) {    \
+                                                int i = bx * bs + c;         \
+                                                int di, dj;                  \
+                                                OP(i, j, w, h, di, dj);      \
+                                                dblocks[(dj / dbs) * dbw +   \
+                                                        di / dbs]            \
+                                                       [(dj % dbs) * dbs +   \
+                                                        di % dbs] =          \
+                                                        block[r * bs + c];   \
+                                        }                                    \
+                                }                                            \
+                        }                                                    \
+                }                                                            \
+        }                                                                    \
+        free(sblocks);                                                       \
+        free(dblocks);                                                       \
+}
+
+/*
+ * A2SPECIAL_DEFINE_GATHER_PLAIN_ROW / _COL: void NAME(void *src, void *dst)
+ * fills every element of the UArray2_T dst from its GOP position in the
+ * UArray2_T src, visiting dst in row-major (or column-major) order
+ */
+#define A2SPECIAL_DEFINE_GATHER_PLAIN_ROW(NAME, TYPE, GOP)                   \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2_T src = source, dst = dest;                                  \
+        int w = UArray2_width(src), h = UArray2_height(src);                 \
+        int dw = UArray2_width(dst), dh = UArray2_height(dst);               \
+        (void)w; (void)h;       /* not every GOP needs them */               \
+        TYPE **srows;                                                        \
+        A2SPECIAL_ROWS_(TYPE, srows, src);                                   \
+        for (int dj = 0; dj < dh; dj++) {                                    \
+                TYPE *drow = UArray2_at(dst, 0, dj);                         \
+                for (int di = 0; di < dw; di++) {                            \
+                        int i, j;                                            \
+                        GOP(di, dj, w, h, i, j);                             \
+                        drow[di] = srows[j][i];                              \
+                }                                                            \
+        }                                                                    \
+        free(srows);                                                         \
+}
+
+#define A2SPECIAL_DEFINE_GATHER_PLAIN_COL(NAME, TYPE, GOP)                   \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2_T src = source, dst = dest;                                  \
+        int w = UArray2_width(src), h = UArray2_height(src);                 \
+        int dw = UArray2_width(dst), dh = UArray2_height(dst);               \
+        (void)w; (void)h;       /* not every GOP needs them */               \
+        TYPE **srows, **drows;                                               \
+        A2SPECIAL_ROWS_(TYPE, srows, src);                                   \
+        A2SPECIAL_ROWS_(TYPE, drows, dst);                                   \
+        for (int di = 0; di < dw; di++) {                                    \
+                for (int dj = 0; dj < dh; dj++) {                            \
+                        int i, j;                                            \
+                        GOP(di, dj, w, h, i, j);                             \
+                        drows[dj][di] = srows[j][i];                         \
+                }                                                            \
+        }                                                                    \
+        free(srows);                                                         \
+        free(drows);                                                         \
+}
+
+/*
+ * A2SPECIAL_DEFINE_GATHER_PLAIN_CO: void NAME(void *src, void *dst)
+ * fills every element of the UArray2_T dst from its GOP position in the
+ * UArray2_T src, visiting dst in the order of UArray2_map_cache_oblivious
+ */
+#define A2SPECIAL_DEFINE_GATHER_PLAIN_CO(NAME, TYPE, GOP)                    \
+static void NAME##_region_(TYPE **srows, TYPE **drows, int w, int h,         \
+                           int di0, int dj0, int cols, int rows)             \
+{                                                                            \
+        (void)w; (void)h;       /* not every GOP needs them */               \
+        if (cols > UARRAY2_CO_LEAF && cols >= rows) {                        \
+                int half = cols / 2;                                         \
+                NAME##_region_(srows, drows, w, h, di0, dj0, half, rows);    \
+                NAME##_region_(srows, drows, w, h, di0 + half, dj0,          \
+                               cols - half, rows);                           \
+        } else if (rows > UARRAY2_CO_LEAF) {                                 \
+                int half = rows / 2;                                         \
+                NAME##_region_(srows, drows, w, h, di0, dj0, cols, half);    \
+                NAME##_region_(srows, drows, w, h, di0, dj0 + half, cols,    \
+                               rows - half);                                 \
+        } else {                                                             \
+                for (int dj = dj0; dj < dj0 + rows; dj++) {                  \
+                        TYPE *drow = drows[dj];                              \
+                        for (int di = di0; di < di0 + cols; di++) {          \
+                                int i, j;                                    \
+                                GOP(di, dj, w, h, i, j);                     \
+                                drow[di] = srows[j][i];                      \
+                        }                                                    \
+                }                                                            \
+        }                                                                    \
+}                                                                            \
+                                                                             \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2_T src = source, dst = dest;                                  \
+        int w = UArray2_width(src), h = UArray2_height(src);                 \
+        int dw = UArray2_width(dst), dh = UArray2_height(dst);               \
+        if (dw == 0 || dh == 0) {                                            \
+                return;                                                      \
+        }                                                                    \
+        TYPE **srows, **drows;                                               \
+        A2SPECIAL_ROWS_(TYPE, srows, src);                                   \
+        A2SPECIAL_ROWS_(TYPE, drows, dst);                                   \
+        NAME##_region_(srows, drows, w, h, 0, 0, dw, dh);                    \
+        free(srows);                                                         \
+        free(drows);                                                         \
+}
+
+/*
+ * A2SPECIAL_DEFINE_GATHER_BLOCKED: void NAME(void *src, void *dst)
+ * fills every element of the UArray2b_T dst from its GOP position in the
+ * UArray2b_T src, visiting dst block by block and each block tile by tile.
+ * src may have any blocksize
+ */
+#define A2SPECIAL_DEFINE_GATHER_BLOCKED(NAME, TYPE, GOP)                     \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2b_T src = source, dst = dest;                                 \
+        int w = UArray2b_width(src), h = UArray2b_height(src);               \
+        int dw = UArray2b_width(dst), dh = UArray2b_height(dst);             \
+        (void)w; (void)h;                                                    \
+        int bs = UArray2b_blocksize(src), dbs = UArray2b_blocksize(dst);     \
+        int ts = UArray2b_tilesize(dst);                                     \
+        int bw, dbw;                                                         \
+        TYPE **sblocks, **dblocks;                                           \
+        A2SPECIAL_BLOCKS_(TYPE, sblocks, bw, src);                           \
+        A2SPECIAL_BLOCKS_(TYPE, dblocks, dbw, dst);                          \
+        int dbh = (dh + dbs - 1) / dbs;                                      \
+        for (int by = 0; by < dbh; by++) {                                   \
+                int rows = dh - by * dbs < dbs ? dh - by * dbs : dbs;        \
+                for (int bx = 0; bx < dbw; bx++) {                           \
+                        int cols = dw - bx * dbs < dbs ? dw - bx * dbs : dbs;\
+                        TYPE *block = dblocks[by * dbw + bx];                \
+                        int tcols = (cols + ts - 1) / ts;                    \
+                        int tiles = (rows + ts - 1) / ts * tcols;            \
+                        for (int t = 0; t < tiles; t++) {                    \
+                                int r0 = t / tcols * ts;                     \
+                                int c0 = t % tcols * ts;                     \
+                                int rend = r0 + ts < rows ? r0 + ts : rows;  \
+                                int cend = c0 + ts < cols ? c0 + ts : cols;  \
+                                for (int r = r0; r < rend; r++) {            \
+                                        int dj = by * dbs + r;               \
+                                        for (int c = c0; c < cend; c++) {    \
+                                                int di = bx * dbs + c;       \
+                                                int i, j;                    \
+                                                GOP(di, dj, w, h, i, j);     \
+                                                block[r * dbs + c] =         \
+                                                        sblocks[(j / bs) * bw\
+                                                                + i / bs]    \
+                                                        [(j % bs) * bs +     \
+                                                         i % bs];            \
+                                        }                                    \
+                                }                                            \
+                        }                                                    \
+                }                                                            \
+        }                                                                    \
+        free(sblocks);                                                       \
+        free(dblocks);                                                       \
+}
+
+/*
+ * A2SPECIAL_DEFINE_STREAM_PLAIN_ROW: like A2SPECIAL_DEFINE_GATHER_PLAIN_ROW,
+ * but each row of dst is gathered A2SPECIAL_STREAM_RUN elements at a time
+ * into a buffer that is then streamed out
+ */
+#define A2SPECIAL_DEFINE_STREAM_PLAIN_ROW(NAME, TYPE, GOP)                   \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2_T src = source, dst = dest;                                  \
+        int w = UArray2_width(src), h = UArray2_height(src);                 \
+        int dw = UArray2_width(dst), dh = UArray2_height(dst);               \
+        (void)w; (void)h;                                                    \
+        TYPE **srows;                                                        \
+        TYPE run[A2SPECIAL_STREAM_RUN];                                      \
+        A2SPECIAL_ROWS_(TYPE, srows, src);                                   \
+        for (int dj = 0; dj < dh; dj++) {                                    \
+                TYPE *drow = UArray2_at(dst, 0, dj);                         \
+                for (int d0 = 0; d0 < dw; d0 += A2SPECIAL_STREAM_RUN) {      \
+                        int n = dw - d0 < A2SPECIAL_STREAM_RUN ?             \
+                                dw - d0 : A2SPECIAL_STREAM_RUN;              \
+                        for (int k = 0; k < n; k++) {                        \
+                                int i, j;                                    \
+                                GOP(d0 + k, dj, w, h, i, j);                 \
+                                run[k] = srows[j][i];                        \
+                        }                                                    \
+                        a2special_stream(drow + d0, run,                     \
+                                         (size_t)n * sizeof(TYPE));          \
+                }                                                            \
+        }                                                                    \
+        a2special_stream_fence();                                            \
+        free(srows);                                                         \
+}
+
+/*
+ * A2SPECIAL_DEFINE_STREAM_BLOCKED: like A2SPECIAL_DEFINE_GATHER_BLOCKED,
+ * but each block of dst is gathered into a block-sized buffer that is then
+ * streamed out in one piece, unused cells included
+ */
+#define A2SPECIAL_DEFINE_STREAM_BLOCKED(NAME, TYPE, GOP)                     \
+static void NAME(void *source, void *dest)                                   \
+{                                                                            \
+        UArray2b_T src = source, dst = dest;                                 \
+        int w = UArray2b_width(src), h = UArray2b_height(src);               \
+        int dw = UArray2b_width(dst), dh = UArray2b_height(dst);             \
+        (void)w; (void)h;                                                    \
+        int bs = UArray2b_blocksize(src), dbs = UArray2b_blocksize(dst);     \
+        int bw, dbw;                                                         \
+        TYPE **sblocks, **dblocks;                                           \
+        A2SPECIAL_BLOCKS_(TYPE, sblocks, bw, src);                           \
+        A2SPECIAL_BLOCKS_(TYPE, dblocks, dbw, dst);                          \
+        TYPE *buffer = calloc((size_t)dbs * dbs, sizeof(TYPE));              \
+        assert(buffer != NULL);                                              \
+        int dbh = (dh + dbs - 1) / dbs;                                      \
+        for (int by = 0; by < dbh; by++) {                                   \
+                int rows = dh - by * dbs < dbs ? dh - by * dbs : dbs;        \
+                for (int bx = 0; bx < dbw; bx++) {                           \
+                        int cols = dw - bx * dbs < dbs ? dw - bx * dbs : dbs;\
+                        for (int r = 0; r < rows; r++) {                     \
+                                int dj = by * dbs + r;                       \
+                                for (int c = 0; c < cols; c++) {             \
+                                        int di = bx * dbs + c;               \
+                                        int i, j;                            \
+                                        GOP(di, dj, w, h, i, j);             \
+                                        buffer[r * dbs + c] =                \
+                                                sblocks[(j / bs) * bw +      \
+                                                        i / bs]              \
+                                                [(j % bs) * bs + i % bs];    \
+                                }                                            \
+                        }                                                    \
+                        a2special_stream(dblocks[by * dbw + bx], buffer,     \
+                                         (size_t)rows * dbs * sizeof(TYPE)); \
+                }                                                            \
+        }                                                                    \
+        a2special_stream_fence();                                            \
+        free(buffer);                                                        \
+        free(sblocks);                                                       \
+        free(dblocks);                                                       \
+}
+
+/* both streaming specializations of one operation, named
+   PREFIX_stream_plain_row and PREFIX_stream_blocked */
+#define A2SPECIAL_DEFINE_ALL_STREAM(PREFIX, TYPE, GOP)                       \
+        A2SPECIAL_DEFINE_STREAM_PLAIN_ROW(PREFIX##_stream_plain_row, TYPE,   \
+                                          GOP)                               \
+        A2SPECIAL_DEFINE_STREAM_BLOCKED(PREFIX##_stream_blocked, TYPE, GOP)
+
+/* all four gathering specializations of one operation, named
+   PREFIX_gather_plain_row, PREFIX_gather_plain_col, PREFIX_gather_plain_co
+   and PREFIX_gather_blocked */
+#define A2SPECIAL_DEFINE_ALL_GATHER(PREFIX, TYPE, GOP)                       \
+        A2SPECIAL_DEFINE_GATHER_PLAIN_ROW(PREFIX##_gather_plain_row, TYPE,   \
+                                          GOP)                               \
+        A2SPECIAL_DEFINE_GATHER_PLAIN_COL(PREFIX##_gather_plain_col, TYPE,   \
+                                          GOP)                               \
+        A2SPECIAL_DEFINE_GATHER_PLAIN_CO(PREFIX##_gather_plain_co, TYPE,     \
+                                         GOP)                                \
+        A2SPECIAL_DEFINE_GATHER_BLOCKED(PREFIX##_gather_blocked, TYPE, GOP)
+
+/* all four specializations of one operation, named PREFIX_plain_row,
+   PREFIX_plain_col, PREFIX_plain_co and PREFIX_blocked */
+#define A2SPECIAL_DEFINE_ALL(PREFIX, TYPE, OP)                               \
+        A2SPECIAL_DEFINE_PLAIN_ROW(PREFIX##_plain_row, TYPE, OP)             \
+        A2SPECIAL_DEFINE_PLAIN_COL(PREFIX##_plain_col, TYPE, OP)             \
+        A2SPECIAL_DEFINE_PLAIN_CO(PREFIX##_plain_co, TYPE, OP)               \
+        A2SPECIAL_DEFINE_BLOCKED(PREFIX##_blocked, TYPE, OP)
+
+#endif
@@ -1,9 +1,12 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2cursor.h"
+#include "uarray2.h"
 
 
 #define W 13
@@ -120,6 +123,341 @@ static inline void copy_unsigned(A2Methods_T methods, A2 a,
         *p = n;
 }
 
+/*
+ * one traversal being checked: the order it must visit the elements of a
+ * width-wide array in, as indices j * width + i, and how far it has got.
+ * Element (i, j) must hold 1000 * (i + col) + (j + row), which is what
+ * test_methods stores, seen from (col, row) when the array is a view
+ */
+struct walk {
+        int width;
+        int col, row;
+        int *order;
+        int length, count;
+};
+
+/* a walk of a width x height array whose (0, 0) holds the value of
+   (col, row), in the order order, which the walk frees */
+static struct walk walk_new(int width, int height, int col, int row,
+                            int *order)
+{
+        struct walk walk = { width, col, row, order, width * height, 0 };
+        return walk;
+}
+
+static void visit(struct walk *walk, int i, int j, void *elem)
+{
+        assert(walk->count < walk->length);
+        assert(walk->order[walk->count] == j * walk->width + i);
+        assert(*(unsigned *)elem ==
+               1000 * (unsigned)(i + walk->col) + (unsigned)(j + walk->row));
+        walk->count++;
+}
+
+/* every element was visited: with the checks in visit, exactly once and
+   in order */
+static void walk_finish(struct walk *walk)
+{
+        assert(walk->count == walk->length);
+        free(walk->order);
+}
+
+/* the indices of a width x height array in row-major order */
+static int *row_major_order(int width, int height)
+{
+        int *order = malloc((width * height + 1) * sizeof(*order));
+        assert(order != NULL);
+        for (int k = 0; k < width * height; k++) {
+                order[k] = k;
+        }
+        return order;
+}
+
+/* the indices of a width x height array in block-major order: blocks row
+   by row, the cells of each block row by row */
+static int *block_major_order(int width, int height, int blocksize)
+{
+        int *order = malloc((width * height + 1) * sizeof(*order));
+        assert(order != NULL);
+        int n = 0;
+        for (int by = 0; by < height; by += blocksize) {
+                for (int bx = 0; bx < width; bx += blocksize) {
+                        for (int j = by; j < by + blocksize && j < height;
+                             j++) {
+                                for (int i = bx;
+                                     i < bx + blocksize && i < width; i++) {
+                                        order[n++] = j * width + i;
+                                }
+                        }
+                }
+        }
+        return order;
+}
+
+/* appends the indices of the cols x rows region at (i0, j0) of a
+   width-wide array to order, as UArray2_map_cache_oblivious documents
+   them: the longer side (columns on a tie) halved until the region is a
+   leaf, first half first, and a leaf row by row */
+static int co_order(int *order, int n, int width, int i0, int j0, int cols,
+                    int rows)
+{
+        if (cols > UARRAY2_CO_LEAF && cols >= rows) {
+                n = co_order(order, n, width, i0, j0, cols / 2, rows);
+                return co_order(order, n, width, i0 + cols / 2, j0,
+                                cols - cols / 2, rows);
+        }
+        if (rows > UARRAY2_CO_LEAF) {
+                n = co_order(order, n, width, i0, j0, cols, rows / 2);
+                return co_order(order, n, width, i0, j0 + rows / 2, cols,
+                                rows - rows / 2);
+        }
+        for (int j = j0; j < j0 + rows; j++) {
+                for (int i = i0; i < i0 + cols; i++) {
+                        order[n++] = j * width + i;
+                }
+        }
+        return n;
+}
+
+static void visit_element(int i, int j, A2 array2, void *elem, void *cl)
+{
+        (void)array2;
+        visit(cl, i, j, elem);
+}
+
+/* A2Plain_map_cache_oblivious on plain arrays of shapes that split down
+   both sides, unevenly, and that are a single leaf */
+static void check_map_cache_oblivious(void)
+{
+        static const int shapes[][2] = {
+                { W, H }, { 16, 16 }, { 17, 16 }, { 37, 70 }, { 70, 37 },
+                { 33, 33 }, { 100, 3 }, { 1, 50 }
+        };
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+                int width = shapes[s][0], height = shapes[s][1];
+                A2 array = methods->new(width, height, sizeof(unsigned));
+                for (int j = 0; j < height; j++) {
+                        for (int i = 0; i < width; i++) {
+                                copy_unsigned(methods, array, i, j,
+                                              1000 * i + j);
+                        }
+                }
+                int *order = malloc(width * height * sizeof(*order));
+                assert(order != NULL);
+                assert(co_order(order, 0, width, 0, 0, width, height) ==
+                       width * height);
+                struct walk walk = walk_new(width, height, 0, 0, order);
+                A2Plain_map_cache_oblivious(array, visit_element, &walk);
+                walk_finish(&walk);
+                methods->free(&array);
+        }
+}
+
+/* one row of a plain array, walked left to right */
+static void visit_span(int j, int width, A2 array2, A2Methods_Object *row,
+                       void *cl)
+{
+        for (int i = 0; i < width; i++) {
+                visit(cl, i, j, (char *)row + (size_t)i *
+                                             methods->size(array2));
+        }
+}
+
+/* A2Plain_map_row_spans hands over every row once, top to bottom, with
+   the whole row contiguous */
+static void check_map_row_spans(A2 array)
+{
+        int width = methods->width(array), height = methods->height(array);
+        struct walk walk = walk_new(width, height, 0, 0,
+                                    row_major_order(width, height));
+        A2Plain_map_row_spans(array, visit_span, &walk);
+        walk_finish(&walk);
+}
+
+/*
+ * A2Cursor walks the array in its native order, row-major or block-major,
+ * and keeps col and row up to date; A2Cursor_next_block goes from the
+ * first element of each block (a row, for a plain array) to the first of
+ * the next
+ */
+static void check_cursor(A2 array, int *native_order)
+{
+        int width = methods->width(array), height = methods->height(array);
+        struct walk walk = walk_new(width, height, 0, 0, native_order);
+        struct A2Cursor cursor;
+        A2Cursor_start(&cursor, methods, array);
+        for (bool more = !cursor.done; more; more = A2Cursor_advance(&cursor)) {
+                visit(&walk, cursor.col, cursor.row, A2Cursor_deref(&cursor));
+        }
+        assert(cursor.done);
+        walk_finish(&walk);
+
+        bool blocked = methods == uarray2_methods_blocked;
+        int block_width = blocked ? methods->blocksize(array) : width;
+        int block_height = blocked ? block_width : 1;
+        int across = (width + block_width - 1) / block_width;
+        int blocks = across * ((height + block_height - 1) / block_height);
+        int *firsts = malloc(blocks * sizeof(*firsts));
+        assert(firsts != NULL);
+        for (int b = 0; b < blocks; b++) {
+                firsts[b] = b / across * block_height * width +
+                            b % across * block_width;
+        }
+        walk = walk_new(width, height, 0, 0, firsts);
+        walk.length = blocks;
+        A2Cursor_start(&cursor, methods, array);
+        for (bool more = !cursor.done; more;
+             more = A2Cursor_next_block(&cursor)) {
+                visit(&walk, cursor.col, cursor.row, A2Cursor_deref(&cursor));
+        }
+        walk_finish(&walk);
+}
+
+/* a block (or part of one) of a blocked array, walked row by row; its
+   rows are blocksize elements apart */
+static void visit_block(int col, int row, int width, int height, A2 array2,
+                        A2Methods_Object *block, void *cl)
+{
+        int blocksize = methods->blocksize(array2);
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        visit(cl, col + i, row + j,
+                              (char *)block + ((size_t)j * blocksize + i) *
+                                              methods->size(array2));
+                }
+        }
+}
+
+/* the indices of the width x height region at (col, row) of a
+   blocksize-blocked array as A2Blocked_map_region hands them over: the
+   parts of the blocks it overlaps in block-major order, each part row by
+   row */
+static int *region_order(int array_width, int col, int row, int width,
+                         int height, int blocksize)
+{
+        int *order = malloc((width * height + 1) * sizeof(*order));
+        assert(order != NULL);
+        int n = 0;
+        int by0 = row / blocksize * blocksize;
+        int bx0 = col / blocksize * blocksize;
+        for (int by = by0; by < row + height; by += blocksize) {
+                for (int bx = bx0; bx < col + width; bx += blocksize) {
+                        for (int j = by; j < by + blocksize; j++) {
+                                for (int i = bx; i < bx + blocksize; i++) {
+                                        if (i >= col && i < col + width &&
+                                            j >= row && j < row + height) {
+                                                order[n++] =
+                                                        j * array_width + i;
+                                        }
+                                }
+                        }
+                }
+        }
+        assert(n == width * height);
+        return order;
+}
+
+/* regions at every origin in the first two blocks, some inside a block,
+   some cut by block edges on every side, and the whole array */
+static void check_map_region(A2 array)
+{
+        int width = methods->width(array), height = methods->height(array);
+        int blocksize = methods->blocksize(array);
+        static const int sizes[][2] = {
+                { 1, 1 }, { 2, 3 }, { 5, 5 }, { 6, 5 }, { 4, 4 }
+        };
+        for (int row = 0; row < 2 * blocksize; row++) {
+                for (int col = 0; col < 2 * blocksize; col++) {
+                        for (int s = 0; s < 5; s++) {
+                                int w = sizes[s][0], h = sizes[s][1];
+                                assert(col + w <= width &&
+                                       row + h <= height);
+                                struct walk walk = walk_new(width, height, 0,
+                                        0, region_order(width, col, row, w,
+                                                        h, blocksize));
+                                walk.length = w * h;
+                                A2Blocked_map_region(array, col, row, w, h,
+                                                     visit_block, &walk);
+                                walk_finish(&walk);
+                        }
+                }
+        }
+        struct walk walk = walk_new(width, height, 0, 0,
+                                    region_order(width, 0, 0, width, height,
+                                                 blocksize));
+        A2Blocked_map_region(array, 0, 0, width, height, visit_block, &walk);
+        walk_finish(&walk);
+}
+
+/*
+ * views of a plain array at non-zero origins, and a view of a view: the
+ * same elements, seen from the origin, through at(), map_default, row
+ * spans and a cursor
+ */
+static void check_views(A2 array)
+{
+        static const int regions[][4] = {
+                { 0, 0, W, H }, { 1, 2, 5, 7 }, { 12, 14, 1, 1 },
+                { 3, 0, 10, 1 }, { 0, 9, 1, 6 }, { 4, 5, 9, 10 }
+        };
+        for (int r = 0; r < 6; r++) {
+                int col = regions[r][0], row = regions[r][1];
+                int width = regions[r][2], height = regions[r][3];
+                A2 view = A2Plain_view(array, col, row, width, height);
+                assert(methods->width(view) == width);
+                assert(methods->height(view) == height);
+                for (int j = 0; j < height; j++) {
+                        for (int i = 0; i < width; i++) {
+                                assert(methods->at(view, i, j) ==
+                                       methods->at(array, col + i, row + j));
+                        }
+                }
+
+                struct walk walk = walk_new(width, height, col, row,
+                                            row_major_order(width, height));
+                methods->map_default(view, visit_element, &walk);
+                walk_finish(&walk);
+                walk = walk_new(width, height, col, row,
+                                row_major_order(width, height));
+                A2Plain_map_row_spans(view, visit_span, &walk);
+                walk_finish(&walk);
+                walk = walk_new(width, height, col, row,
+                                row_major_order(width, height));
+                struct A2Cursor cursor;
+                A2Cursor_start(&cursor, methods, view);
+                for (bool more = !cursor.done; more;
+                     more = A2Cursor_advance(&cursor)) {
+                        visit(&walk, cursor.col, cursor.row,
+                              A2Cursor_deref(&cursor));
+                }
+                walk_finish(&walk);
+
+                if (width > 2 && height > 2) {
+                        A2 inner = A2Plain_view(view, 1, 1, width - 2,
+                                                height - 2);
+                        walk = walk_new(width - 2, height - 2, col + 1,
+                                        row + 1, row_major_order(width - 2,
+                                                             height - 2));
+                        methods->map_default(inner, visit_element, &walk);
+                        walk_finish(&walk);
+                        methods->free(&inner);
+                }
+                methods->free(&view);
+        }
+}
+
+/* A2Blocked_map_blocks hands over every block once, in block-major
+   order, including the blocks cut short by the edges */
+static void check_map_blocks(A2 array)
+{
+        int width = methods->width(array), height = methods->height(array);
+        struct walk walk = walk_new(width, height, 0, 0,
+                                    block_major_order(width, height,
+                                                methods->blocksize(array)));
+        A2Blocked_map_blocks(array, visit_block, &walk);
+        walk_finish(&walk);
+}
+
 static void test_methods(A2Methods_T methods_under_test) 
 {
         methods = methods_under_test;
@@ -157,6 +495,17 @@ static void test_methods(A2Methods_T methods_under_test)
                         assert(*p == n);
                 }
         }
+        if (methods == uarray2_methods_plain) {
+                check_map_row_spans(array);
+                check_cursor(array, row_major_order(W, H));
+                check_map_cache_oblivious();
+                check_views(array);
+        }
+        if (methods == uarray2_methods_blocked) {
+                check_map_blocks(array);
+                check_cursor(array, block_major_order(W, H, BS));
+                check_map_region(array);
+        }
         double_row_major_plus();
         methods->free(&array);
 }
@@ -166,7 +515,7 @@ int main(int argc, char *argv[])
         assert(argc == 1);
         (void)argv;
         test_methods(uarray2_methods_plain);
-        /*  test_methods(uarray2_methods_blocked); */
+        test_methods(uarray2_methods_blocked);
         printf("Passed.\n");  /* only if we reach this point without
                                * assertion failure
                                */
@@ -0,0 +1,492 @@
+/*
+ *     bench.c
+ *     Locality
+ *
+ *     Benchmark driver for the ppmtrans operations. Times every mapping
+ *     against every operation in Transform_table, under each requested
+ *     traversal, on synthetic images of several sizes. Each configuration
+ *     gets warmup runs and then timed trials, and the min/median/p95 time
+ *     per pixel is written as CSV or JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "assert.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "uarray2b.h"
+#include "cputiming.h"
+#include "pnm.h"
+#include "transform.h"
+#include "imagegen.h"
+#include "hugemem.h"
+
+#define MAX_CONFIGS 64
+
+/* default sweep: cache-resident up to larger than most LLCs, plus the
+   shape of the photo we used to time by hand, a size that is not a
+   multiple of any blocksize, and some degenerate shapes */
+static const char *default_sizes = "64x64,512x512,1001x999,2048x2048,"
+                                   "2867x1603,4096x256,256x4096,1x4096,"
+                                   "4096x1";
+static const char *default_traversals = "scatter,gather";
+/* 0 stands for the default blocksize picked by UArray2b_new_64K_block */
+static const char *default_blocksizes = "8,16,32,0";
+
+/* one mapping under test: a methods suite, one of its maps and a blocksize */
+struct mapping {
+        const char *name;
+        A2Methods_T methods;
+        A2Methods_mapfun *map;
+        int blocksize;
+};
+
+/* summary of the trials of one configuration, in nanoseconds per pixel */
+struct stats {
+        double min, median, p95;
+};
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-format {csv,json}] [-trials n] "
+                        "[-warmup n] [-sizes WxH,...] [-blocksizes n,...] "
+                        "[-ops name,...] [-pattern {gradient,noise,tiles}] "
+                        "[-specialized] [-stream] "
+                        "[-hugepages {off,thp,hugetlb}] [-tile-bytes n] "
+                        "[-traversals {scatter,gather,auto},...] "
+                        "[-o output_file]\n",
+                        progname);
+        exit(1);
+}
+
+static int parse_count(const char *progname, const char *arg, int minimum)
+{
+        char *endptr;
+        long n = strtol(arg, &endptr, 10);
+        if (*endptr != '\0' || n < minimum) {
+                usage(progname);
+        }
+        return (int)n;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+        double x = *(const double *)a;
+        double y = *(const double *)b;
+        return (x > y) - (x < y);
+}
+
+/*
+ * Name: summarize
+ *
+ * Description: sorts the per-trial samples and computes the minimum, the
+ * median and the 95th percentile (nearest rank)
+ *
+ * Parameters:
+ *           double *samples: the per-pixel times of each trial
+ *           int n: the number of samples
+ *
+ * Returns: the summary of the samples
+ *
+ * Expects: n > 0
+ *
+ * Notes: the samples are sorted in place
+ */
+static struct stats summarize(double *samples, int n)
+{
+        assert(n > 0);
+        qsort(samples, n, sizeof(*samples), compare_doubles);
+
+        struct stats s;
+        s.min = samples[0];
+        if (n % 2 == 1) {
+                s.median = samples[n / 2];
+        } else {
+                s.median = (samples[n / 2 - 1] + samples[n / 2]) / 2;
+        }
+        int rank = (95 * n + 99) / 100;  /* ceil(0.95 * n) */
+        s.p95 = samples[rank - 1];
+        return s;
+}
+
+/*
+ * Name: run_config
+ *
+ * Description: times one (mapping, operation, size) configuration. The
+ * source image is created once, then the operation is run warmup times
+ * untimed and trials times timed. As in ppmtrans -time, the timed region
+ * covers allocating the new image and mapping the operation into it
+ *
+ * Parameters:
+ *           struct mapping *m: the mapping under test
+ *           const Transform *transform: the operation under test
+ *           Transform_Traversal traversal: which image the map walks
+ *           int width, int height: the dimensions of the source image
+ *           int warmup, int trials: the number of untimed and timed runs
+ *           ImageGen_Pattern pattern: the synthetic image to transform
+ *           Transform_kernel *kernel: specialized loop to run in place of
+ *                                     the map, or NULL
+ *
+ * Returns: the summary of the timed trials
+ *
+ * Expects: trials > 0 and positive dimensions
+ *
+ * Notes: results in a checked runtime error if the allocation fails
+ */
+static struct stats run_config(struct mapping *m, const Transform *transform,
+                               Transform_Traversal traversal, int width,
+                               int height, int warmup, int trials,
+                               ImageGen_Pattern pattern,
+                               Transform_kernel *kernel)
+{
+        A2Methods_T methods = m->methods;
+        A2Methods_UArray2 source;
+        if (m->blocksize > 0) {
+                source = methods->new_with_blocksize(width, height,
+                                                     sizeof(struct Pnm_rgb),
+                                                     m->blocksize);
+        } else {
+                source = methods->new(width, height, sizeof(struct Pnm_rgb));
+        }
+        ImageGen_Params params = { width, height, 255, pattern, 0, 32 };
+        ImageGen_fill(&params, methods, source);
+
+        double *samples = malloc(trials * sizeof(*samples));
+        assert(samples != NULL);
+        CPUTime_T timer = CPUTime_New();
+        double pixels = (double)width * height;
+
+        for (int run = 0; run < warmup + trials; run++) {
+                CPUTime_Start(timer);
+                A2Methods_UArray2 result;
+                if (kernel != NULL) {
+                        result = Transform_new_image(transform, methods,
+                                                     source);
+                        kernel(source, result);
+                } else {
+                        result = Transform_apply(transform, methods, m->map,
+                                                 traversal, source);
+                }
+                double time_used = CPUTime_Stop(timer);
+                methods->free(&result);
+                if (run >= warmup) {
+                        samples[run - warmup] = time_used / pixels;
+                }
+        }
+
+        struct stats s = summarize(samples, trials);
+        CPUTime_Free(&timer);
+        free(samples);
+        methods->free(&source);
+        return s;
+}
+
+/* build the list of mappings: plain row major, column major and
+   cache-oblivious, then one blocked mapping per requested blocksize */
+static int make_mappings(struct mapping *mappings, char *blocksizes,
+                         const char *progname)
+{
+        int n = 0;
+        mappings[n++] = (struct mapping){ "row-major", uarray2_methods_plain,
+                                  uarray2_methods_plain->map_row_major, 1 };
+        mappings[n++] = (struct mapping){ "col-major", uarray2_methods_plain,
+                                  uarray2_methods_plain->map_col_major, 1 };
+        mappings[n++] = (struct mapping){ "cache-oblivious",
+                                          uarray2_methods_plain,
+                                          A2Plain_map_cache_oblivious, 1 };
+
+        for (char *tok = strtok(blocksizes, ","); tok != NULL;
+             tok = strtok(NULL, ",")) {
+                if (n == MAX_CONFIGS) {
+                        fprintf(stderr, "%s: too many blocksizes\n", progname);
+                        exit(1);
+                }
+                mappings[n++] = (struct mapping){ "block-major",
+                                uarray2_methods_blocked,
+                                uarray2_methods_blocked->map_block_major,
+                                parse_count(progname, tok, 0) };
+        }
+        return n;
+}
+
+static bool op_selected(const char *ops, const char *name)
+{
+        if (ops == NULL) {
+                return true;
+        }
+        size_t len = strlen(name);
+        for (const char *p = ops; (p = strstr(p, name)) != NULL; p += len) {
+                bool starts = (p == ops || p[-1] == ',');
+                bool ends   = (p[len] == '\0' || p[len] == ',');
+                if (starts && ends) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+/* the -ops list must name at least one operation, all of them in
+   Transform_table */
+static void check_ops(const char *ops, const char *progname)
+{
+        if (ops == NULL) {
+                return;
+        }
+        char *op_list = strdup(ops);
+        assert(op_list != NULL);
+        int count = 0;
+        for (char *tok = strtok(op_list, ","); tok != NULL;
+             tok = strtok(NULL, ",")) {
+                if (Transform_find(tok) == NULL) {
+                        fprintf(stderr, "%s: unknown operation '%s'\n",
+                                progname, tok);
+                        usage(progname);
+                }
+                count++;
+        }
+        if (count == 0) {
+                usage(progname);
+        }
+        free(op_list);
+}
+
+static void print_header(FILE *out, bool json)
+{
+        if (json) {
+                fprintf(out, "[\n");
+        } else {
+                fprintf(out, "mapping,blocksize,operation,kernel,"
+                             "traversal,width,height,trials,"
+                             "min_ns_per_pixel,median_ns_per_pixel,"
+                             "p95_ns_per_pixel\n");
+        }
+}
+
+static void print_result(FILE *out, bool json, bool first, struct mapping *m,
+                         int blocksize, const Transform *transform,
+                         const char *kernel, const char *traversal,
+                         int width, int height, int trials, struct stats s)
+{
+        if (json) {
+                fprintf(out, "%s  {\"mapping\": \"%s\", \"blocksize\": %d, "
+                             "\"operation\": \"%s\", \"kernel\": \"%s\", "
+                             "\"traversal\": \"%s\", \"width\": %d, "
+                             "\"height\": %d, \"trials\": %d, "
+                             "\"min_ns_per_pixel\": %.3f, "
+                             "\"median_ns_per_pixel\": %.3f, "
+                             "\"p95_ns_per_pixel\": %.3f}",
+                        first ? "" : ",\n", m->name, blocksize,
+                        transform->name, kernel, traversal, width, height,
+                        trials,
+                        s.min, s.median, s.p95);
+        } else {
+                fprintf(out, "%s,%d,%s,%s,%s,%d,%d,%d,%.3f,%.3f,%.3f\n",
+                        m->name, blocksize, transform->name, kernel,
+                        traversal, width, height, trials, s.min, s.median,
+                        s.p95);
+        }
+        fflush(out);
+}
+
+/* time and report one configuration under one traversal; a NULL name
+   stands for the traversal ppmtrans would choose */
+static void run_traversal(FILE *out, bool json, bool *first, struct mapping *m,
+                          int blocksize, const Transform *transform,
+                          const char *name, bool specialized, bool stream,
+                          int width,
+                          int height, int warmup, int trials,
+                          ImageGen_Pattern pattern)
+{
+        Transform_Traversal traversal;
+        if (name == NULL) {
+                traversal = Transform_choose_traversal(transform, m->methods,
+                                                       m->map);
+        } else {
+                Transform_traversal(name, &traversal);
+        }
+
+        Transform_kernel *kernel = NULL;
+        const char *kernel_name = "generic";
+        if (stream && traversal == Transform_GATHER) {
+                kernel = Transform_find_stream_kernel(transform, m->methods,
+                                                      m->map);
+                kernel_name = "streaming";
+        }
+        if (specialized && kernel == NULL) {
+                kernel = Transform_find_kernel(transform, m->methods, m->map,
+                                               traversal);
+                kernel_name = "specialized";
+        }
+        if (kernel == NULL) {
+                kernel_name = "generic";
+        }
+        struct stats s = run_config(m, transform, traversal, width, height,
+                                    warmup, trials, pattern, kernel);
+        print_result(out, json, *first, m, blocksize, transform, kernel_name,
+                     Transform_traversal_name(traversal), width, height,
+                     trials, s);
+        *first = false;
+}
+
+/* the blocksize actually used by a mapping, for reporting */
+static int actual_blocksize(struct mapping *m)
+{
+        if (m->blocksize > 0) {
+                return m->blocksize;
+        }
+        A2Methods_UArray2 probe = m->methods->new(1, 1,
+                                                  sizeof(struct Pnm_rgb));
+        int blocksize = m->methods->blocksize(probe);
+        m->methods->free(&probe);
+        return blocksize;
+}
+
+int main(int argc, char *argv[])
+{
+        bool  json        = false;
+        bool  specialized = false;
+        bool  stream      = false;
+        int   trials      = 5;
+        int   warmup      = 1;
+        char *sizes       = NULL;
+        char *blocksizes  = NULL;
+        char *ops         = NULL;
+        char *traversals  = NULL;
+        FILE *out         = stdout;
+        ImageGen_Pattern pattern = ImageGen_GRADIENT;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-specialized") == 0) {
+                        specialized = true;
+                        continue;
+                }
+                if (strcmp(argv[i], "-stream") == 0) {
+                        stream = true;
+                        continue;
+                }
+                if (i + 1 >= argc) {
+                        usage(argv[0]);
+                }
+                if (strcmp(argv[i], "-format") == 0) {
+                        i++;
+                        if (strcmp(argv[i], "json") == 0) {
+                                json = true;
+                        } else if (strcmp(argv[i], "csv") != 0) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-trials") == 0) {
+                        trials = parse_count(argv[0], argv[++i], 1);
+                } else if (strcmp(argv[i], "-warmup") == 0) {
+                        warmup = parse_count(argv[0], argv[++i], 0);
+                } else if (strcmp(argv[i], "-sizes") == 0) {
+                        sizes = argv[++i];
+                } else if (strcmp(argv[i], "-blocksizes") == 0) {
+                        blocksizes = argv[++i];
+                } else if (strcmp(argv[i], "-traversals") == 0) {
+                        traversals = argv[++i];
+                } else if (strcmp(argv[i], "-ops") == 0) {
+                        ops = argv[++i];
+                } else if (strcmp(argv[i], "-pattern") == 0) {
+                        if (!ImageGen_pattern(argv[++i], &pattern)) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-hugepages") == 0) {
+                        HugeMem_Policy policy;
+                        if (!HugeMem_parse(argv[++i], &policy)) {
+                                usage(argv[0]);
+                        }
+                        HugeMem_set_policy(policy);
+                } else if (strcmp(argv[i], "-tile-bytes") == 0) {
+                        UArray2b_set_tile_bytes(parse_count(argv[0],
+                                                            argv[++i], 0));
+                } else if (strcmp(argv[i], "-o") == 0) {
+                        out = fopen(argv[++i], "w");
+                        if (out == NULL) {
+                                fprintf(stderr, "Error opening file: %s\n",
+                                        argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                } else {
+                        fprintf(stderr, "%s: unknown option '%s'\n", argv[0],
+                                argv[i]);
+                        usage(argv[0]);
+                }
+        }
+
+        /* strtok needs writable copies of the lists */
+        char *size_list  = strdup(sizes != NULL ? sizes : default_sizes);
+        char *block_list = strdup(blocksizes != NULL ? blocksizes
+                                                     : default_blocksizes);
+        assert(size_list != NULL && block_list != NULL);
+
+        /* "auto" is kept as NULL and resolved per configuration */
+        const char *traversal_names[3];
+        int ntraversals = 0;
+        char *traversal_list = strdup(traversals != NULL ? traversals
+                                                         : default_traversals);
+        assert(traversal_list != NULL);
+        for (char *tok = strtok(traversal_list, ","); tok != NULL;
+             tok = strtok(NULL, ",")) {
+                Transform_Traversal unused;
+                if (ntraversals == 3 || (strcmp(tok, "auto") != 0 &&
+                                         !Transform_traversal(tok, &unused))) {
+                        fprintf(stderr, "%s: bad traversal '%s'\n", argv[0],
+                                tok);
+                        usage(argv[0]);
+                }
+                traversal_names[ntraversals++] =
+                        strcmp(tok, "auto") == 0 ? NULL : tok;
+        }
+
+        check_ops(ops, argv[0]);
+
+        struct mapping mappings[MAX_CONFIGS];
+        int nmappings = make_mappings(mappings, block_list, argv[0]);
+
+        print_header(out, json);
+        bool first = true;
+        char *save;
+        for (char *tok = strtok_r(size_list, ",", &save); tok != NULL;
+             tok = strtok_r(NULL, ",", &save)) {
+                int width, height;
+                char extra;
+                if (sscanf(tok, "%dx%d%c", &width, &height, &extra) != 2 ||
+                    width <= 0 || height <= 0) {
+                        fprintf(stderr, "%s: bad size '%s'\n", argv[0], tok);
+                        usage(argv[0]);
+                }
+                for (int m = 0; m < nmappings; m++) {
+                        int blocksize = actual_blocksize(&mappings[m]);
+                        for (int t = 0; t < Transform_count; t++) {
+                                const Transform *transform =
+                                        &Transform_table[t];
+                                if (!op_selected(ops, transform->name)) {
+                                        continue;
+                                }
+                                for (int v = 0; v < ntraversals; v++) {
+                                        run_traversal(out, json, &first,
+                                                      &mappings[m], blocksize,
+                                                      transform,
+                                                      traversal_names[v],
+                                                      specialized, stream,
+                                                      width, height, warmup,
+                                                      trials, pattern);
+                                }
+                        }
+                }
+        }
+        if (json) {
+                fprintf(out, "\n]\n");
+        }
+
+        free(size_list);
+        free(block_list);
+        free(traversal_list);
+        if (out != stdout) {
+                fclose(out);
+        }
+        return EXIT_SUCCESS;
+}
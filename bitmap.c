@@ -0,0 +1,405 @@
+/*
+ *     bitmap.c
+ *     Locality
+ *
+ *     Implementation of Bitmap_T (see bitmap.h): PBM reading and writing
+ *     a row at a time, and the exact operations on whole 64-bit words.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "trace.h"
+#include "pnm.h"
+#include "pnmio.h"
+#include "transform.h"
+#include "bitmap.h"
+
+#define T Bitmap_T
+
+/* rows per band of the row-by-row operations */
+#define BAND 64
+
+struct Bitmap {
+        int width, height;
+        int words;                      /* per row */
+        uint64_t *bits;                 /* row by row */
+};
+
+typedef enum {
+        COPY, HORIZONTAL, VERTICAL, ROTATE180, TRANSPOSE, ROTATE90, ROTATE270
+} Operation;
+
+/* one operation in progress, shared by every band or column of blocks */
+struct job {
+        T source, dest;
+        Operation operation;
+};
+
+static inline uint64_t *row_of(T bitmap, int j)
+{
+        return bitmap->bits + (long)j * bitmap->words;
+}
+
+/* the bits of the last word of a row that are pixels */
+static inline uint64_t last_mask(int width)
+{
+        return width % 64 == 0 ? ~0ULL : ~0ULL << (64 - width % 64);
+}
+
+T Bitmap_new(int width, int height)
+{
+        assert(width > 0 && height > 0);
+        T bitmap;
+        NEW(bitmap);
+        bitmap->width  = width;
+        bitmap->height = height;
+        bitmap->words  = (width + 63) / 64;
+        bitmap->bits   = CALLOC((long)bitmap->words * height,
+                                sizeof(*bitmap->bits));
+        return bitmap;
+}
+
+void Bitmap_free(T *bitmap)
+{
+        assert(bitmap != NULL && *bitmap != NULL);
+        FREE((*bitmap)->bits);
+        FREE(*bitmap);
+}
+
+int Bitmap_width(T bitmap)
+{
+        assert(bitmap != NULL);
+        return bitmap->width;
+}
+
+int Bitmap_height(T bitmap)
+{
+        assert(bitmap != NULL);
+        return bitmap->height;
+}
+
+/* pixel (i, j): 1 black, 0 white */
+int Bitmap_get(T bitmap, int i, int j)
+{
+        assert(bitmap != NULL);
+        assert(i >= 0 && i < bitmap->width && j >= 0 && j < bitmap->height);
+        return (int)(row_of(bitmap, j)[i / 64] >> (63 - i % 64)) & 1;
+}
+
+/* sets pixel (i, j) to bit, 1 for black; threads may set pixels of
+   different rows at once */
+void Bitmap_put(T bitmap, int i, int j, int bit)
+{
+        assert(bitmap != NULL);
+        assert(i >= 0 && i < bitmap->width && j >= 0 && j < bitmap->height);
+        uint64_t mask = (uint64_t)1 << (63 - i % 64);
+        uint64_t *word = &row_of(bitmap, j)[i / 64];
+        *word = bit ? *word | mask : *word & ~mask;
+}
+
+static void truncated(void)
+{
+        fprintf(stderr, "Error: PBM image is truncated\n");
+        exit(EXIT_FAILURE);
+}
+
+/*
+ * Name: Bitmap_read
+ *
+ * Description: reads a PBM image whose magic number has been read
+ *
+ * Parameters:
+ *           FILE *fp: the open stream, just after the magic number
+ *           int magic: the digit of the magic number, '1' (plain) or '4'
+ *           (raw)
+ *
+ * Returns: the image, to be freed with Bitmap_free
+ *
+ * Expects: fp is not NULL
+ *
+ * Notes: exits with an error message if the header is not valid or the
+ * image ends early; a raw image is read a row at a time
+ */
+T Bitmap_read(FILE *fp, int magic)
+{
+        assert(fp != NULL && (magic == '1' || magic == '4'));
+        int width = PnmIO_number(fp);
+        int height = PnmIO_number(fp);
+        if (width <= 0 || height <= 0) {
+                fprintf(stderr, "Error: empty PBM image\n");
+                exit(EXIT_FAILURE);
+        }
+        T bitmap = Bitmap_new(width, height);
+
+        if (magic == '1') {
+                for (int j = 0; j < height; j++) {
+                        uint64_t *row = row_of(bitmap, j);
+                        for (int i = 0; i < width; i++) {
+                                int c = getc(fp);
+                                while (isspace(c)) {
+                                        c = getc(fp);
+                                }
+                                if (c != '0' && c != '1') {
+                                        truncated();
+                                }
+                                if (c == '1') {
+                                        row[i / 64] |= 1ULL << (63 - i % 64);
+                                }
+                        }
+                }
+                return bitmap;
+        }
+
+        size_t row_bytes = ((size_t)width + 7) / 8;
+        unsigned char *bytes = ALLOC((long)bitmap->words * 8);
+        for (int j = 0; j < height; j++) {
+                memset(bytes + row_bytes, 0, bitmap->words * 8 - row_bytes);
+                if (fread(bytes, 1, row_bytes, fp) != row_bytes) {
+                        truncated();
+                }
+                uint64_t *row = row_of(bitmap, j);
+                for (int k = 0; k < bitmap->words; k++) {
+                        uint64_t word = 0;
+                        for (int b = 0; b < 8; b++) {
+                                word = word << 8 | bytes[8 * k + b];
+                        }
+                        row[k] = word;
+                }
+                /* the file's padding bits are not pixels */
+                row[bitmap->words - 1] &= last_mask(width);
+        }
+        FREE(bytes);
+        return bitmap;
+}
+
+/* writes bitmap as a raw (P4) PBM */
+void Bitmap_write(FILE *fp, T bitmap)
+{
+        assert(fp != NULL && bitmap != NULL);
+        size_t row_bytes = ((size_t)bitmap->width + 7) / 8;
+        unsigned char *bytes = ALLOC((long)bitmap->words * 8);
+        fprintf(fp, "P4\n%d %d\n", bitmap->width, bitmap->height);
+        for (int j = 0; j < bitmap->height; j++) {
+                const uint64_t *row = row_of(bitmap, j);
+                for (int k = 0; k < bitmap->words; k++) {
+                        for (int b = 0; b < 8; b++) {
+                                bytes[8 * k + b] = row[k] >> (56 - 8 * b);
+                        }
+                }
+                if (fwrite(bytes, 1, row_bytes, fp) != row_bytes) {
+                        fprintf(stderr, "Error: cannot write image\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        FREE(bytes);
+}
+
+/* the 64 bits of x in the opposite order */
+static inline uint64_t reverse(uint64_t x)
+{
+        x = (x >> 1 & 0x5555555555555555ULL) |
+            (x & 0x5555555555555555ULL) << 1;
+        x = (x >> 2 & 0x3333333333333333ULL) |
+            (x & 0x3333333333333333ULL) << 2;
+        x = (x >> 4 & 0x0f0f0f0f0f0f0f0fULL) |
+            (x & 0x0f0f0f0f0f0f0f0fULL) << 4;
+        return __builtin_bswap64(x);
+}
+
+/*
+ * Name: transpose64
+ *
+ * Description: transposes the 64x64 bit matrix whose row k is a[k], bit
+ * 63 first, in place
+ *
+ * Parameters:
+ *           uint64_t a[64]: the matrix
+ *
+ * Returns: nothing
+ *
+ * Expects: nothing
+ *
+ * Notes: Hacker's Delight 7-3: six rounds, each swapping the off-diagonal
+ * quadrants of every 2j x 2j submatrix with masked shifts
+ */
+static void transpose64(uint64_t a[64])
+{
+        uint64_t m = 0x00000000ffffffffULL;
+        for (int j = 32; j != 0; j >>= 1, m ^= m << j) {
+                for (int k = 0; k < 64; k = (k + j + 1) & ~j) {
+                        uint64_t t = (a[k] ^ (a[k + j] >> j)) & m;
+                        a[k] ^= t;
+                        a[k + j] ^= t << j;
+                }
+        }
+}
+
+/* row j of source, mirrored, into to; the reversed row ends in the
+   padding bits, so it is shifted back to start at bit 63 */
+static void mirror_row(T source, int j, uint64_t *to)
+{
+        const uint64_t *from = row_of(source, j);
+        int words = source->words;
+        int pad = words * 64 - source->width;
+        for (int k = 0; k < words; k++) {
+                to[k] = reverse(from[words - 1 - k]);
+        }
+        if (pad == 0) {
+                return;
+        }
+        for (int k = 0; k < words; k++) {
+                uint64_t next = k + 1 < words ? to[k + 1] : 0;
+                to[k] = to[k] << pad | next >> (64 - pad);
+        }
+}
+
+static void rows_band(int band, void *cl)
+{
+        const struct job *job = cl;
+        T source = job->source, dest = job->dest;
+        int y0 = band * BAND;
+        int y1 = y0 + BAND < source->height ? y0 + BAND : source->height;
+        size_t row_bytes = (size_t)source->words * sizeof(uint64_t);
+
+        TRACE_BEGIN_XY("band", "bitmap", 0, y0);
+        for (int j = y0; j < y1; j++) {
+                int flipped = source->height - 1 - j;
+                switch (job->operation) {
+                case COPY:
+                        memcpy(row_of(dest, j), row_of(source, j), row_bytes);
+                        break;
+                case VERTICAL:
+                        memcpy(row_of(dest, flipped), row_of(source, j),
+                               row_bytes);
+                        break;
+                case HORIZONTAL:
+                        mirror_row(source, j, row_of(dest, j));
+                        break;
+                case ROTATE180:
+                        mirror_row(source, j, row_of(dest, flipped));
+                        break;
+                default:
+                        assert(0);
+                }
+        }
+        TRACE_END("band", "bitmap");
+}
+
+/* the 64 new rows from column of words bx of the source, one block of 64
+   source rows at a time */
+static void transpose_column(int bx, void *cl)
+{
+        const struct job *job = cl;
+        T source = job->source, dest = job->dest;
+        uint64_t a[64];
+
+        TRACE_BEGIN_XY("column", "bitmap", bx * 64, 0);
+        for (int by = 0; by < dest->words; by++) {
+                for (int k = 0; k < 64; k++) {
+                        int r = by * 64 + k;
+                        if (r >= source->height) {
+                                a[k] = 0;
+                        } else if (job->operation == ROTATE90) {
+                                /* rows bottom up: new (x, y) is old
+                                   (y, height - 1 - x) */
+                                a[k] = row_of(source, source->height - 1 -
+                                                      r)[bx];
+                        } else {
+                                a[k] = row_of(source, r)[bx];
+                        }
+                }
+                transpose64(a);
+                for (int k = 0; k < 64; k++) {
+                        int y = bx * 64 + k;
+                        if (y >= dest->height) {
+                                break;
+                        }
+                        /* rotating by 270 writes the rows bottom up */
+                        if (job->operation == ROTATE270) {
+                                y = dest->height - 1 - y;
+                        }
+                        row_of(dest, y)[by] = a[k];
+                }
+        }
+        TRACE_END("column", "bitmap");
+}
+
+/*
+ * Name: Bitmap_transform
+ *
+ * Description: makes the image that the exact operation transform turns
+ * bitmap into
+ *
+ * Parameters:
+ *           T bitmap: the original
+ *           const Transform *transform: one of Transform_table
+ *
+ * Returns: the new image, to be freed with Bitmap_free
+ *
+ * Expects: neither argument is NULL
+ *
+ * Notes: the work is spread over Parallel_threads() threads, by bands of
+ * rows or, when transposing, by columns of 64x64 blocks
+ */
+T Bitmap_transform(T bitmap, const Transform *transform)
+{
+        assert(bitmap != NULL && transform != NULL);
+        static const struct {
+                const char *name;
+                Operation operation;
+        } operations[] = {
+                { "rotate0", COPY }, { "horizontal", HORIZONTAL },
+                { "vertical", VERTICAL }, { "rotate180", ROTATE180 },
+                { "transpose", TRANSPOSE }, { "rotate90", ROTATE90 },
+                { "rotate270", ROTATE270 }
+        };
+        struct job job;
+        job.operation = COPY;
+        bool found = false;
+        for (size_t k = 0; k < sizeof(operations) / sizeof(operations[0]);
+             k++) {
+                if (strcmp(transform->name, operations[k].name) == 0) {
+                        job.operation = operations[k].operation;
+                        found = true;
+                }
+        }
+        assert(found);
+
+        job.source = bitmap;
+        if (transform->swaps_dimensions) {
+                job.dest = Bitmap_new(bitmap->height, bitmap->width);
+                Parallel_for(bitmap->words, transpose_column, &job);
+        } else {
+                job.dest = Bitmap_new(bitmap->width, bitmap->height);
+                Parallel_for((bitmap->height + BAND - 1) / BAND, rows_band,
+                             &job);
+        }
+        return job.dest;
+}
+
+/* bitmap as Pnm_rgb pixels of maxval 1 for every other operation: black
+   is 0, white 1 */
+A2Methods_UArray2 Bitmap_pixels(T bitmap, A2Methods_T methods)
+{
+        assert(bitmap != NULL && methods != NULL);
+        A2Methods_UArray2 array2 = methods->new(bitmap->width, bitmap->height,
+                                                sizeof(struct Pnm_rgb));
+        struct A2Pixels pixels;
+        A2Pixels_open(&pixels, methods, array2);
+        for (int j = 0; j < bitmap->height; j++) {
+                for (int i = 0; i < bitmap->width; i++) {
+                        struct Pnm_rgb *p = A2Pixels_at(&pixels, i, j);
+                        p->red = p->green = p->blue =
+                                1 - Bitmap_get(bitmap, i, j);
+                }
+        }
+        A2Pixels_close(&pixels);
+        return array2;
+}
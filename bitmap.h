@@ -0,0 +1,53 @@
+#ifndef BITMAP_INCLUDED
+#define BITMAP_INCLUDED
+/****************************************************************
+ *
+ *                         bitmap.h
+ *
+ *       Interface to type Bitmap_T, a bilevel (PBM) image stored one
+ *       bit per pixel, 1 for black as in the file. Each row is a run
+ *       of 64-bit words, the leftmost pixel of a word in its most
+ *       significant bit, so a raw PBM row is the same bits read as
+ *       big-endian words. Bits past the width are kept 0.
+ *
+ *       Usage:
+ *
+ *       PnmIO_magic(fp) read, then:
+ *       Bitmap_T bitmap = Bitmap_read(fp, magic);
+ *       Bitmap_T rotated = Bitmap_transform(bitmap, transform);
+ *       Bitmap_write(stdout, rotated);
+ *
+ *       A page of 2550x3300 takes 1 MB instead of the 100 MB of
+ *       Pnm_rgb pixels. The exact operations of transform.h work on
+ *       whole words: flips reverse the bits of each word, and
+ *       transposing, like rotating by 90 or 270, transposes 64x64 bit
+ *       blocks in registers with six rounds of masked shifts. The two
+ *       rotations are a transpose that reads the rows of its blocks
+ *       bottom up (90) or writes them bottom up (270), so they cost no
+ *       more than the transpose. Rows of blocks are spread over
+ *       threads (see parallel.h).
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "a2methods.h"
+#include "transform.h"
+
+typedef struct Bitmap *Bitmap_T;
+
+extern Bitmap_T Bitmap_new(int width, int height);
+extern Bitmap_T Bitmap_read(FILE *fp, int magic);
+extern void     Bitmap_write(FILE *fp, Bitmap_T bitmap);
+extern void     Bitmap_free(Bitmap_T *bitmap);
+
+extern int  Bitmap_width(Bitmap_T bitmap);
+extern int  Bitmap_height(Bitmap_T bitmap);
+extern int  Bitmap_get(Bitmap_T bitmap, int i, int j);
+extern void Bitmap_put(Bitmap_T bitmap, int i, int j, int bit);
+
+extern Bitmap_T Bitmap_transform(Bitmap_T bitmap,
+                                 const Transform *transform);
+extern A2Methods_UArray2 Bitmap_pixels(Bitmap_T bitmap, A2Methods_T methods);
+
+#endif
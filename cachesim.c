@@ -0,0 +1,259 @@
+/*
+ *     cachesim.c
+ *     Locality
+ *
+ *     This file implements the cache and TLB simulator. Each level (and
+ *     the TLB, which is just a cache of page numbers) is an array of sets,
+ *     each holding associativity tags with a last-use stamp for LRU. The
+ *     accesses and misses counted for a level are the lookups that reached
+ *     it, so a level's miss rate is local to that level.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "assert.h"
+#include "mem.h"
+#include "cachesim.h"
+
+#define T CacheSim_T
+
+#define INVALID UINT64_MAX
+
+/* one set-associative cache of blocks of block_size bytes */
+struct level {
+        const char        *name;
+        long               block_size;     /* line size, or page size */
+        long               sets;
+        int                ways;
+        uint64_t          *tags;           /* sets * ways block numbers */
+        uint64_t          *stamps;         /* last use of each way */
+        unsigned long long accesses, misses;
+};
+
+struct T {
+        int          nlevels;
+        struct level levels[CACHESIM_MAX_LEVELS];
+        int          has_tlb;
+        struct level tlb;
+        uint64_t     clock;               /* stamp for LRU */
+};
+
+static void init_level(struct level *l, const char *name, long size,
+                       long block_size, int ways)
+{
+        assert(size > 0 && block_size > 0 && ways > 0);
+        assert(size % (block_size * ways) == 0);
+        l->name       = name;
+        l->block_size = block_size;
+        l->ways       = ways;
+        l->sets       = size / (block_size * ways);
+        l->tags       = ALLOC(l->sets * ways * (long)sizeof(uint64_t));
+        l->stamps     = CALLOC(l->sets * ways, sizeof(uint64_t));
+        for (long i = 0; i < l->sets * ways; i++) {
+                l->tags[i] = INVALID;
+        }
+        l->accesses = l->misses = 0;
+}
+
+/*
+ * Looks up block number block in l, filling it on a miss by evicting the
+ * least recently used way of its set. Returns 1 on a hit.
+ */
+static int lookup(struct level *l, uint64_t block, uint64_t now)
+{
+        uint64_t *tags   = &l->tags[(block % l->sets) * l->ways];
+        uint64_t *stamps = &l->stamps[(block % l->sets) * l->ways];
+        int victim = 0;
+
+        l->accesses++;
+        for (int w = 0; w < l->ways; w++) {
+                if (tags[w] == block) {
+                        stamps[w] = now;
+                        return 1;
+                }
+                if (stamps[w] < stamps[victim]) {
+                        victim = w;
+                }
+        }
+        l->misses++;
+        tags[victim]   = block;
+        stamps[victim] = now;
+        return 0;
+}
+
+
+/*
+ * Name: CacheSim_new
+ * 
+ * Description: creates a simulator with no cache levels and no TLB
+ *
+ * Returns: the new simulator, owned by the caller
+ */
+T CacheSim_new(void)
+{
+        T sim;
+        NEW(sim);
+        sim->nlevels = 0;
+        sim->has_tlb = 0;
+        sim->clock   = 0;
+        return sim;
+}
+
+
+void CacheSim_free(T *sim)
+{
+        assert(sim != NULL && *sim != NULL);
+        for (int i = 0; i < (*sim)->nlevels; i++) {
+                FREE((*sim)->levels[i].tags);
+                FREE((*sim)->levels[i].stamps);
+        }
+        if ((*sim)->has_tlb) {
+                FREE((*sim)->tlb.tags);
+                FREE((*sim)->tlb.stamps);
+        }
+        FREE(*sim);
+}
+
+
+/*
+ * Name: CacheSim_add_level
+ * 
+ * Description: adds the next cache level below the ones already added
+ *
+ * Parameters:
+ *           T sim: the simulator
+ *           const char *name: a name for reports, e.g. "L1"
+ *           long size: the capacity in bytes
+ *           int line_size: the line size in bytes
+ *           int associativity: the number of ways per set
+ *        
+ * Returns: nothing
+ * 
+ * Expects: size is a multiple of line_size * associativity
+ * 
+ * Notes: results in a checked runtime error for more than
+ * CACHESIM_MAX_LEVELS levels or inconsistent sizes. The name is not copied
+ */
+void CacheSim_add_level(T sim, const char *name, long size, int line_size,
+                        int associativity)
+{
+        assert(sim != NULL && name != NULL);
+        assert(sim->nlevels < CACHESIM_MAX_LEVELS);
+        init_level(&sim->levels[sim->nlevels++], name, size, line_size,
+                   associativity);
+}
+
+
+/*
+ * Name: CacheSim_set_tlb
+ * 
+ * Description: gives the simulator a data TLB of the given number of
+ * entries and associativity, translating pages of page_size bytes
+ *
+ * Notes: results in a checked runtime error if a TLB was already set or
+ * entries is not a multiple of associativity
+ */
+void CacheSim_set_tlb(T sim, int entries, int associativity, long page_size)
+{
+        assert(sim != NULL && !sim->has_tlb);
+        init_level(&sim->tlb, "TLB", (long)entries * page_size, page_size,
+                   associativity);
+        sim->has_tlb = 1;
+}
+
+
+/*
+ * Name: CacheSim_access
+ * 
+ * Description: simulates one access of nbytes bytes at address. Every line
+ * (and page) the access touches is looked up separately
+ *
+ * Parameters:
+ *           T sim: the simulator
+ *           const void *address: the first byte accessed
+ *           int nbytes: the size of the access
+ *        
+ * Returns: nothing
+ * 
+ * Expects: nbytes > 0
+ */
+void CacheSim_access(T sim, const void *address, int nbytes)
+{
+        assert(sim != NULL && nbytes > 0);
+        uint64_t first = (uint64_t)(uintptr_t)address;
+        uint64_t last  = first + nbytes - 1;
+
+        if (sim->has_tlb) {
+                long page = sim->tlb.block_size;
+                for (uint64_t p = first / page; p <= last / page; p++) {
+                        lookup(&sim->tlb, p, ++sim->clock);
+                }
+        }
+        if (sim->nlevels == 0) {
+                return;
+        }
+        /* levels may differ in line size, so walk the smallest lines */
+        long line = sim->levels[0].block_size;
+        for (uint64_t a = first - first % line; a <= last; a += line) {
+                uint64_t now = ++sim->clock;
+                for (int i = 0; i < sim->nlevels; i++) {
+                        struct level *l = &sim->levels[i];
+                        if (lookup(l, a / l->block_size, now)) {
+                                break;
+                        }
+                }
+        }
+}
+
+
+/* clears the counts, but not the contents, of every level and the TLB */
+void CacheSim_reset(T sim)
+{
+        assert(sim != NULL);
+        for (int i = 0; i < sim->nlevels; i++) {
+                sim->levels[i].accesses = sim->levels[i].misses = 0;
+        }
+        sim->tlb.accesses = sim->tlb.misses = 0;
+}
+
+
+int CacheSim_levels(T sim)
+{
+        assert(sim != NULL);
+        return sim->nlevels;
+}
+
+
+const char *CacheSim_name(T sim, int level)
+{
+        assert(sim != NULL && level >= 0 && level < sim->nlevels);
+        return sim->levels[level].name;
+}
+
+
+unsigned long long CacheSim_accesses(T sim, int level)
+{
+        assert(sim != NULL && level >= 0 && level < sim->nlevels);
+        return sim->levels[level].accesses;
+}
+
+
+unsigned long long CacheSim_misses(T sim, int level)
+{
+        assert(sim != NULL && level >= 0 && level < sim->nlevels);
+        return sim->levels[level].misses;
+}
+
+
+unsigned long long CacheSim_tlb_accesses(T sim)
+{
+        assert(sim != NULL);
+        return sim->has_tlb ? sim->tlb.accesses : 0;
+}
+
+
+unsigned long long CacheSim_tlb_misses(T sim)
+{
+        assert(sim != NULL);
+        return sim->has_tlb ? sim->tlb.misses : 0;
+}
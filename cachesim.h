@@ -0,0 +1,37 @@
+/*
+ *     cachesim.h
+ *     Locality
+ *
+ *     Interface to a simple set-associative cache and TLB simulator. A
+ *     CacheSim_T is a hierarchy of cache levels (L1 first) plus one data
+ *     TLB. Every access is looked up level by level until it hits, and is
+ *     filled into every level it missed, with LRU replacement within a
+ *     set. Reads and writes are treated alike (write-allocate).
+ */
+
+#ifndef CACHESIM_INCLUDED
+#define CACHESIM_INCLUDED
+
+#define CACHESIM_MAX_LEVELS 4
+
+#define T CacheSim_T
+typedef struct T *T;
+
+extern T    CacheSim_new      (void);
+extern void CacheSim_free     (T *sim);
+extern void CacheSim_add_level(T sim, const char *name, long size,
+                               int line_size, int associativity);
+extern void CacheSim_set_tlb  (T sim, int entries, int associativity,
+                               long page_size);
+extern void CacheSim_access   (T sim, const void *address, int nbytes);
+extern void CacheSim_reset    (T sim);
+
+extern int                CacheSim_levels  (T sim);
+extern const char        *CacheSim_name    (T sim, int level);
+extern unsigned long long CacheSim_accesses(T sim, int level);
+extern unsigned long long CacheSim_misses  (T sim, int level);
+extern unsigned long long CacheSim_tlb_accesses(T sim);
+extern unsigned long long CacheSim_tlb_misses  (T sim);
+
+#undef T
+#endif
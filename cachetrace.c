@@ -0,0 +1,324 @@
+/*
+ *     cachetrace.c
+ *     Locality
+ *
+ *     This program predicts the cache behavior of a ppmtrans operation
+ *     without timing it. The source and destination images are accessed
+ *     through the instrumented methods in a2sim.c, which replay every
+ *     element address issued during the map through a simulated cache
+ *     hierarchy and data TLB. One CSV line is printed per (mapping,
+ *     blocksize, operation) with the misses and local miss rate of every
+ *     level, so blocksizes and traversals can be compared for a target CPU
+ *     offline. -traversal picks whether the map walks the original image
+ *     (scatter) or the new one (gather).
+ *
+ *     Only element accesses are simulated: the lookups the arrays make
+ *     into their own row and block tables are not.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "uarray2b.h"
+#include "pnm.h"
+#include "transform.h"
+#include "imagegen.h"
+#include "cachesim.h"
+#include "a2sim.h"
+
+#define MAX_BLOCKSIZES 32
+
+/* geometry of one cache level or of the TLB */
+struct geometry {
+        long size;       /* bytes, or entries for the TLB */
+        long line;       /* line size, or page size for the TLB */
+        int  ways;
+};
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-{row,col,block}-major] "
+                        "[-cache-oblivious] [-blocksizes n,...] "
+                        "[-tile-bytes n] [-ops name,...] [-size WxH] "
+                        "[-traversal {scatter,gather,auto}] "
+                        "[-l1 size:line:ways] [-l2 size:line:ways] "
+                        "[-l3 size:line:ways] [-tlb entries:page:ways]\n"
+                        "Sizes take an optional K, M or G suffix; "
+                        "a size of 0 drops the level.\n",
+                        progname);
+        exit(1);
+}
+
+/* parse a number with an optional K/M/G (binary) suffix */
+static long parse_size(const char *s, char **endptr)
+{
+        long n = strtol(s, endptr, 10);
+        switch (**endptr) {
+        case 'K': n <<= 10; (*endptr)++; break;
+        case 'M': n <<= 20; (*endptr)++; break;
+        case 'G': n <<= 30; (*endptr)++; break;
+        }
+        return n;
+}
+
+static struct geometry parse_geometry(const char *progname, const char *arg)
+{
+        struct geometry g;
+        char *end;
+        g.size = parse_size(arg, &end);
+        if (*end != ':') {
+                usage(progname);
+        }
+        g.line = parse_size(end + 1, &end);
+        if (*end != ':') {
+                usage(progname);
+        }
+        g.ways = (int)strtol(end + 1, &end, 10);
+        if (*end != '\0' || g.size < 0 || g.line <= 0 || g.ways <= 0) {
+                usage(progname);
+        }
+        return g;
+}
+
+/* a fresh (cold) simulator with the requested hierarchy */
+static CacheSim_T make_sim(struct geometry *levels, const char **names,
+                           int nlevels, struct geometry tlb)
+{
+        CacheSim_T sim = CacheSim_new();
+        for (int i = 0; i < nlevels; i++) {
+                if (levels[i].size > 0) {
+                        CacheSim_add_level(sim, names[i], levels[i].size,
+                                           levels[i].line, levels[i].ways);
+                }
+        }
+        if (tlb.size > 0) {
+                CacheSim_set_tlb(sim, tlb.size, tlb.ways, tlb.line);
+        }
+        return sim;
+}
+
+static int op_selected(const char *ops, const char *name)
+{
+        if (ops == NULL) {
+                return 1;
+        }
+        size_t len = strlen(name);
+        for (const char *p = ops; (p = strstr(p, name)) != NULL; p += len) {
+                if ((p == ops || p[-1] == ',') &&
+                    (p[len] == '\0' || p[len] == ',')) {
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+static void print_rate(unsigned long long misses, unsigned long long accesses)
+{
+        printf(",%llu,%.6f", misses,
+               accesses == 0 ? 0.0 : (double)misses / accesses);
+}
+
+/*
+ * Name: simulate
+ * 
+ * Description: runs one operation over a synthetic image through the
+ * instrumented methods and prints its CSV line. The source image is filled
+ * before the simulator starts counting, so only the map itself is measured
+ *
+ * Parameters:
+ *           A2Methods_T methods: the real methods suite
+ *           const char *mapping: row-major, col-major, cache-oblivious or
+ *                                block-major
+ *           int blocksize: the blocksize for blocked arrays, 0 for default
+ *           const Transform *transform: the operation to simulate
+ *           int width, int height: the size of the source image
+ *           CacheSim_T sim: a cold simulator
+ *        
+ * Returns: nothing
+ * 
+ * Expects: mapping names a map that methods supports
+ */
+static void simulate(A2Methods_T methods, const char *mapping, int blocksize,
+                     const Transform *transform, const char *traversal_name,
+                     int width, int height, CacheSim_T sim)
+{
+        A2Methods_UArray2 source;
+        if (blocksize > 0) {
+                source = methods->new_with_blocksize(width, height,
+                                                     sizeof(struct Pnm_rgb),
+                                                     blocksize);
+        } else {
+                source = methods->new(width, height, sizeof(struct Pnm_rgb));
+        }
+        ImageGen_Params params = { width, height, 255, ImageGen_GRADIENT,
+                                   0, 32 };
+        ImageGen_fill(&params, methods, source);
+
+        A2Methods_T simmed = A2Sim_wrap(methods, sim);
+        A2Methods_mapfun *map;
+        if (strcmp(mapping, "row-major") == 0) {
+                map = simmed->map_row_major;
+        } else if (strcmp(mapping, "col-major") == 0) {
+                map = simmed->map_col_major;
+        } else if (strcmp(mapping, "cache-oblivious") == 0) {
+                map = A2Sim_map(A2Plain_map_cache_oblivious);
+        } else {
+                map = simmed->map_block_major;
+        }
+        assert(map != NULL);
+
+        A2Methods_UArray2 dest = Transform_new_image(transform, simmed,
+                                                     source);
+        /* choose with the unwrapped methods, whose maps are recognized */
+        Transform_Traversal traversal;
+        if (traversal_name == NULL) {
+                A2Methods_mapfun *plain_map = methods->map_block_major;
+                if (strcmp(mapping, "row-major") == 0) {
+                        plain_map = methods->map_row_major;
+                } else if (strcmp(mapping, "col-major") == 0) {
+                        plain_map = methods->map_col_major;
+                } else if (strcmp(mapping, "cache-oblivious") == 0) {
+                        plain_map = A2Plain_map_cache_oblivious;
+                }
+                traversal = Transform_choose_traversal(transform, methods,
+                                                       plain_map);
+        } else {
+                Transform_traversal(traversal_name, &traversal);
+        }
+
+        CacheSim_reset(sim);
+        Transform_map(transform, simmed, map, traversal, source, dest);
+
+        printf("%s,%d,%s,%s,%d,%d,%llu", mapping, methods->blocksize(source),
+               transform->name, Transform_traversal_name(traversal), width,
+               height,
+               CacheSim_levels(sim) > 0 ? CacheSim_accesses(sim, 0) : 0ULL);
+        for (int i = 0; i < CacheSim_levels(sim); i++) {
+                print_rate(CacheSim_misses(sim, i), CacheSim_accesses(sim, i));
+        }
+        print_rate(CacheSim_tlb_misses(sim), CacheSim_tlb_accesses(sim));
+        printf("\n");
+
+        methods->free(&dest);
+        methods->free(&source);
+}
+
+int main(int argc, char *argv[])
+{
+        const char *mapping = "row-major";
+        A2Methods_T methods = uarray2_methods_plain;
+        char *blocksizes    = NULL;
+        char *ops           = NULL;
+        const char *traversal = "scatter";     /* NULL for auto */
+        int width = 1024, height = 1024;
+
+        /* a typical desktop core: 32K L1d, 1M L2, 16M LLC, 64-entry dTLB */
+        const char *names[3] = { "l1", "l2", "l3" };
+        struct geometry levels[3] = {
+                { 32L << 10, 64, 8 }, { 1L << 20, 64, 16 },
+                { 16L << 20, 64, 16 }
+        };
+        struct geometry tlb = { 64, 4096, 4 };
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-row-major") == 0) {
+                        mapping = "row-major";
+                        methods = uarray2_methods_plain;
+                } else if (strcmp(argv[i], "-col-major") == 0) {
+                        mapping = "col-major";
+                        methods = uarray2_methods_plain;
+                } else if (strcmp(argv[i], "-cache-oblivious") == 0) {
+                        mapping = "cache-oblivious";
+                        methods = uarray2_methods_plain;
+                } else if (strcmp(argv[i], "-block-major") == 0) {
+                        mapping = "block-major";
+                        methods = uarray2_methods_blocked;
+                } else if (i + 1 >= argc) {
+                        usage(argv[0]);
+                } else if (strcmp(argv[i], "-blocksizes") == 0) {
+                        blocksizes = argv[++i];
+                } else if (strcmp(argv[i], "-tile-bytes") == 0) {
+                        char *end;
+                        long n = parse_size(argv[++i], &end);
+                        if (*end != '\0' || n < 0 || n > 0x7fffffffL) {
+                                usage(argv[0]);
+                        }
+                        UArray2b_set_tile_bytes((int)n);
+                } else if (strcmp(argv[i], "-traversal") == 0) {
+                        Transform_Traversal unused;
+                        traversal = argv[++i];
+                        if (strcmp(traversal, "auto") == 0) {
+                                traversal = NULL;
+                        } else if (!Transform_traversal(traversal, &unused)) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-ops") == 0) {
+                        ops = argv[++i];
+                } else if (strcmp(argv[i], "-size") == 0) {
+                        char extra;
+                        if (sscanf(argv[++i], "%dx%d%c", &width, &height,
+                                   &extra) != 2 || width <= 0 || height <= 0) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-l1") == 0) {
+                        levels[0] = parse_geometry(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "-l2") == 0) {
+                        levels[1] = parse_geometry(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "-l3") == 0) {
+                        levels[2] = parse_geometry(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "-tlb") == 0) {
+                        tlb = parse_geometry(argv[0], argv[++i]);
+                } else {
+                        fprintf(stderr, "%s: unknown option '%s'\n", argv[0],
+                                argv[i]);
+                        usage(argv[0]);
+                }
+        }
+
+        /* blocksizes only matter for blocked arrays; 0 means the default */
+        int bs[MAX_BLOCKSIZES];
+        int nbs = 0;
+        if (blocksizes != NULL && methods == uarray2_methods_blocked) {
+                for (char *tok = strtok(blocksizes, ","); tok != NULL;
+                     tok = strtok(NULL, ",")) {
+                        if (nbs == MAX_BLOCKSIZES) {
+                                usage(argv[0]);
+                        }
+                        char *end;
+                        long b = strtol(tok, &end, 10);
+                        if (*end != '\0' || b < 0 || b > INT_MAX) {
+                                usage(argv[0]);
+                        }
+                        bs[nbs++] = (int)b;
+                }
+        } else {
+                bs[nbs++] = 0;
+        }
+
+        printf("mapping,blocksize,operation,traversal,width,height,"
+               "accesses");
+        for (int i = 0; i < 3; i++) {
+                if (levels[i].size > 0) {
+                        printf(",%s_misses,%s_miss_rate", names[i], names[i]);
+                }
+        }
+        printf(",tlb_misses,tlb_miss_rate\n");
+
+        for (int b = 0; b < nbs; b++) {
+                for (int t = 0; t < Transform_count; t++) {
+                        if (!op_selected(ops, Transform_table[t].name)) {
+                                continue;
+                        }
+                        CacheSim_T sim = make_sim(levels, names, 3, tlb);
+                        simulate(methods, mapping, bs[b], &Transform_table[t],
+                                 traversal, width, height, sim);
+                        CacheSim_free(&sim);
+                }
+        }
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,359 @@
+/*
+ *     convolve.c
+ *     Locality
+ *
+ *     Implementation of Convolve_T (see convolve.h). A kernel keeps its
+ *     full grid of weights and, when the grid is the product of a column
+ *     and a row, those two vectors as well. Applying it works on one
+ *     tile of the new image at a time, from a float copy of the old
+ *     pixels around the tile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "pixelf.h"
+#include "trace.h"
+#include "pnm.h"
+#include "convolve.h"
+
+#define T Convolve_T
+
+/* tile side when the new image is plain */
+#define TILE 64
+
+/* relative error below which a grid counts as a column times a row */
+#define SEPARABLE_TOLERANCE 1e-5
+
+struct Convolve {
+        int width, height;
+        float *weights;         /* row by row */
+        bool separable;
+        float *column, *row;    /* weights[r][c] = column[r] * row[c] */
+};
+
+/* the application in progress, shared by every tile */
+struct job {
+        T kernel;
+        struct A2Pixels src, dst;
+        int tile;
+        int tiles_across, tiles_down;
+        float maxval;
+};
+
+/* finds column and row vectors whose product is the grid, if any: the
+   largest weight fixes a row and a column of the grid, and every other
+   weight must be their product */
+static void factor(T kernel)
+{
+        int w = kernel->width, h = kernel->height;
+        int pivot = 0;
+        for (int k = 1; k < w * h; k++) {
+                if (fabsf(kernel->weights[k]) >
+                    fabsf(kernel->weights[pivot])) {
+                        pivot = k;
+                }
+        }
+        float largest = kernel->weights[pivot];
+        int r0 = pivot / w, c0 = pivot % w;
+
+        kernel->column = ALLOC((long)h * sizeof(*kernel->column));
+        kernel->row    = ALLOC((long)w * sizeof(*kernel->row));
+        for (int r = 0; r < h; r++) {
+                kernel->column[r] = kernel->weights[r * w + c0];
+        }
+        for (int c = 0; c < w; c++) {
+                kernel->row[c] = largest == 0 ? 0 :
+                                 kernel->weights[r0 * w + c] / largest;
+        }
+
+        kernel->separable = true;
+        for (int r = 0; r < h && kernel->separable; r++) {
+                for (int c = 0; c < w; c++) {
+                        float product = kernel->column[r] * kernel->row[c];
+                        if (fabsf(kernel->weights[r * w + c] - product) >
+                            SEPARABLE_TOLERANCE * fabsf(largest)) {
+                                kernel->separable = false;
+                                break;
+                        }
+                }
+        }
+        if (!kernel->separable) {
+                FREE(kernel->column);
+                FREE(kernel->row);
+        }
+}
+
+/*
+ * Name: Convolve_new
+ *
+ * Description: makes a kernel from a grid of weights
+ *
+ * Parameters:
+ *           int width, height: the size of the grid
+ *           const float *weights: width * height weights, row by row
+ *
+ * Returns: the kernel, to be freed with Convolve_free
+ *
+ * Expects: width and height odd and at most CONVOLVE_MAX_SIDE, weights not
+ * NULL
+ *
+ * Notes: the weights are copied, and checked for separability
+ */
+T Convolve_new(int width, int height, const float *weights)
+{
+        assert(width > 0 && width <= CONVOLVE_MAX_SIDE && width % 2 == 1);
+        assert(height > 0 && height <= CONVOLVE_MAX_SIDE && height % 2 == 1);
+        assert(weights != NULL);
+        T kernel;
+        NEW(kernel);
+        kernel->width   = width;
+        kernel->height  = height;
+        kernel->weights = ALLOC((long)width * height *
+                                sizeof(*kernel->weights));
+        for (int k = 0; k < width * height; k++) {
+                kernel->weights[k] = weights[k];
+        }
+        factor(kernel);
+        return kernel;
+}
+
+/* a Gaussian blur reaching 3 sigma each way, weights summing to 1 */
+T Convolve_gaussian(double sigma)
+{
+        assert(sigma > 0);
+        int radius = (int)ceil(3 * sigma);
+        if (radius > CONVOLVE_MAX_SIDE / 2) {
+                radius = CONVOLVE_MAX_SIDE / 2;
+        }
+        int side = 2 * radius + 1;
+        double *g = ALLOC((long)side * sizeof(*g));
+        double total = 0;
+        for (int k = 0; k < side; k++) {
+                double d = k - radius;
+                g[k] = exp(-d * d / (2 * sigma * sigma));
+                total += g[k];
+        }
+        float *weights = ALLOC((long)side * side * sizeof(*weights));
+        for (int r = 0; r < side; r++) {
+                for (int c = 0; c < side; c++) {
+                        weights[r * side + c] = (float)(g[r] * g[c] /
+                                                        (total * total));
+                }
+        }
+        T kernel = Convolve_new(side, side, weights);
+        FREE(weights);
+        FREE(g);
+        return kernel;
+}
+
+/* the 3x3 Laplacian sharpen: five times the pixel less its four
+   neighbors */
+T Convolve_sharpen(void)
+{
+        static const float weights[] = {  0, -1,  0,
+                                         -1,  5, -1,
+                                          0, -1,  0 };
+        return Convolve_new(3, 3, weights);
+}
+
+/*
+ * Name: Convolve_read
+ *
+ * Description: reads a kernel file (see convolve.h)
+ *
+ * Parameters:
+ *           FILE *fp: the open file
+ *
+ * Returns: the kernel, or NULL if the file is not a kernel, which
+ * includes one with an even width or height
+ *
+ * Expects: fp is not NULL
+ *
+ * Notes: the file is read up to the last weight and left open
+ */
+T Convolve_read(FILE *fp)
+{
+        assert(fp != NULL);
+        int width, height;
+        if (fscanf(fp, "%d %d", &width, &height) != 2 || width <= 0 ||
+            height <= 0 || width > CONVOLVE_MAX_SIDE ||
+            height > CONVOLVE_MAX_SIDE || width % 2 == 0 ||
+            height % 2 == 0) {
+                return NULL;
+        }
+        float *weights = ALLOC((long)width * height * sizeof(*weights));
+        for (int k = 0; k < width * height; k++) {
+                if (fscanf(fp, "%f", &weights[k]) != 1) {
+                        FREE(weights);
+                        return NULL;
+                }
+        }
+        T kernel = Convolve_new(width, height, weights);
+        FREE(weights);
+        return kernel;
+}
+
+void Convolve_free(T *kernel)
+{
+        assert(kernel != NULL && *kernel != NULL);
+        FREE((*kernel)->weights);
+        if ((*kernel)->separable) {
+                FREE((*kernel)->column);
+                FREE((*kernel)->row);
+        }
+        FREE(*kernel);
+}
+
+int Convolve_width(T kernel)
+{
+        assert(kernel != NULL);
+        return kernel->width;
+}
+
+int Convolve_height(T kernel)
+{
+        assert(kernel != NULL);
+        return kernel->height;
+}
+
+bool Convolve_separable(T kernel)
+{
+        assert(kernel != NULL);
+        return kernel->separable;
+}
+
+/* the kernel over one tile: halo holds the old pixels from (x0 - width
+   / 2, y0 - height / 2), tw + width - 1 across and th + height - 1 down */
+static void convolve_tile(const struct job *job, int x0, int y0, int tw,
+                          int th, const Pixelf *halo)
+{
+        T kernel = job->kernel;
+        int hw = tw + kernel->width - 1;
+
+        if (kernel->separable) {
+                /* across every halo row, then down */
+                int hh = th + kernel->height - 1;
+                Pixelf *across = ALLOC((long)hh * tw * sizeof(*across));
+                for (int r = 0; r < hh; r++) {
+                        for (int x = 0; x < tw; x++) {
+                                const Pixelf *p = halo + (long)r * hw + x;
+                                Pixelf v = Pixelf_zero();
+                                for (int c = 0; c < kernel->width; c++) {
+                                        v = Pixelf_madd(v, p[c],
+                                                        kernel->row[c]);
+                                }
+                                across[(long)r * tw + x] = v;
+                        }
+                }
+                for (int y = 0; y < th; y++) {
+                        for (int x = 0; x < tw; x++) {
+                                const Pixelf *p = across + (long)y * tw + x;
+                                Pixelf v = Pixelf_zero();
+                                for (int r = 0; r < kernel->height; r++) {
+                                        v = Pixelf_madd(v, p[(long)r * tw],
+                                                        kernel->column[r]);
+                                }
+                                Pixelf_store(A2Pixels_at(&job->dst, x0 + x,
+                                                         y0 + y),
+                                             v, job->maxval);
+                        }
+                }
+                FREE(across);
+                return;
+        }
+
+        for (int y = 0; y < th; y++) {
+                for (int x = 0; x < tw; x++) {
+                        Pixelf v = Pixelf_zero();
+                        const float *weight = kernel->weights;
+                        for (int r = 0; r < kernel->height; r++) {
+                                const Pixelf *p = halo +
+                                                  (long)(y + r) * hw + x;
+                                for (int c = 0; c < kernel->width; c++) {
+                                        v = Pixelf_madd(v, p[c], *weight++);
+                                }
+                        }
+                        Pixelf_store(A2Pixels_at(&job->dst, x0 + x, y0 + y),
+                                     v, job->maxval);
+                }
+        }
+}
+
+static void apply_tile(int index, void *cl)
+{
+        const struct job *job = cl;
+        T kernel = job->kernel;
+        const struct A2Pixels *src = &job->src;
+        int x0 = index % job->tiles_across * job->tile;
+        int y0 = index / job->tiles_across * job->tile;
+        int tw = x0 + job->tile < src->width ? job->tile : src->width - x0;
+        int th = y0 + job->tile < src->height ? job->tile
+                                               : src->height - y0;
+
+        TRACE_BEGIN_XY("tile", "convolve", x0, y0);
+        /* the tile and its halo, edges repeated */
+        int hw = tw + kernel->width - 1, hh = th + kernel->height - 1;
+        int left = x0 - kernel->width / 2, top = y0 - kernel->height / 2;
+        Pixelf *halo = ALLOC((long)hw * hh * sizeof(*halo));
+        for (int r = 0; r < hh; r++) {
+                int j = A2Pixels_clamp(top + r, src->height - 1);
+                for (int c = 0; c < hw; c++) {
+                        int i = A2Pixels_clamp(left + c, src->width - 1);
+                        halo[(long)r * hw + c] =
+                                Pixelf_load(A2Pixels_at(src, i, j));
+                }
+        }
+        convolve_tile(job, x0, y0, tw, th, halo);
+        FREE(halo);
+        TRACE_END("tile", "convolve");
+}
+
+/*
+ * Name: Convolve_apply
+ *
+ * Description: fills dest with source convolved with kernel
+ *
+ * Parameters:
+ *           T kernel: the kernel
+ *           A2Methods_T methods: the methods of both images
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           A2Methods_UArray2 dest: an image of the same size
+ *           unsigned maxval: the largest channel value of the images
+ *
+ * Returns: nothing
+ *
+ * Expects: no NULL argument, images of the same size, maxval > 0
+ *
+ * Notes: tiles are spread over Parallel_threads() threads
+ */
+void Convolve_apply(T kernel, A2Methods_T methods, A2Methods_UArray2 source,
+                    A2Methods_UArray2 dest, unsigned maxval)
+{
+        assert(kernel != NULL && methods != NULL);
+        assert(source != NULL && dest != NULL);
+        assert(maxval > 0);
+        struct job job;
+        job.kernel = kernel;
+        A2Pixels_open(&job.src, methods, source);
+        A2Pixels_open(&job.dst, methods, dest);
+        assert(job.src.width == job.dst.width &&
+               job.src.height == job.dst.height);
+
+        /* a blocked image is convolved one block at a time */
+        job.tile = methods->blocksize(dest) > 1 ? methods->blocksize(dest)
+                                                : TILE;
+        job.tiles_across = (job.src.width + job.tile - 1) / job.tile;
+        job.tiles_down   = (job.src.height + job.tile - 1) / job.tile;
+        job.maxval = (float)maxval;
+
+        Parallel_for(job.tiles_across * job.tiles_down, apply_tile, &job);
+
+        A2Pixels_close(&job.src);
+        A2Pixels_close(&job.dst);
+}
@@ -0,0 +1,69 @@
+#ifndef CONVOLVE_INCLUDED
+#define CONVOLVE_INCLUDED
+/****************************************************************
+ *
+ *                         convolve.h
+ *
+ *       Interface to type Convolve_T, a convolution kernel for
+ *       Pnm_rgb images: a width x height grid of weights, both sides
+ *       odd, whose middle weight (width / 2, height / 2) lies on the
+ *       pixel being computed. The kernel is applied as written, each new pixel
+ *       being the sum of weight times old pixel over the grid; pixels
+ *       past the edges repeat the nearest edge pixel, and results are
+ *       clamped to [0, maxval].
+ *
+ *       Usage:
+ *
+ *       Convolve_T blur = Convolve_gaussian(2.0);
+ *       Convolve_apply(blur, methods, source, dest, maxval);
+ *       Convolve_free(&blur);
+ *
+ *       A kernel that is the product of a column and a row of weights
+ *       (Gaussians are, sharpening is not) is found to be separable
+ *       when made, and applied as a pass across and a pass down:
+ *       width + height multiplies per pixel instead of width * height.
+ *
+ *       The new image is made one tile at a time, a block of a
+ *       blocked image or 64x64 pixels of a plain one. Each tile loads
+ *       the old pixels it reads, the tile and a halo of the kernel's
+ *       reach around it, into a float buffer that stays in cache for
+ *       both passes. Tiles are spread over threads (see parallel.h) and
+ *       the channels of a pixel are summed together (see pixelf.h).
+ *
+ *       Kernel files hold the width and height and then the weights,
+ *       row by row, as decimal numbers separated by white space:
+ *
+ *         3 3
+ *         0 -1  0
+ *        -1  5 -1
+ *         0 -1  0
+ *
+ *       Files whose width or height is even, so that no weight lies on
+ *       the pixel, are not kernel files.
+ *
+ *****************************************************************/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "a2methods.h"
+
+typedef struct Convolve *Convolve_T;
+
+/* widest or tallest kernel accepted */
+#define CONVOLVE_MAX_SIDE 255
+
+extern Convolve_T Convolve_new(int width, int height, const float *weights);
+extern Convolve_T Convolve_gaussian(double sigma);
+extern Convolve_T Convolve_sharpen(void);
+extern Convolve_T Convolve_read(FILE *fp);
+extern void       Convolve_free(Convolve_T *kernel);
+
+extern int  Convolve_width(Convolve_T kernel);
+extern int  Convolve_height(Convolve_T kernel);
+extern bool Convolve_separable(Convolve_T kernel);
+
+extern void Convolve_apply(Convolve_T kernel, A2Methods_T methods,
+                           A2Methods_UArray2 source, A2Methods_UArray2 dest,
+                           unsigned maxval);
+
+#endif
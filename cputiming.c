@@ -26,13 +26,32 @@
  *       Note that printf format %.0f is typically a reasonable way to
  *       print such integers.
  *
+ *       When CPUTime_EnableCounters has been called, Start and Stop also
+ *       reset, enable, disable and read a perf_event_open counter for
+ *       each event in CPUTime_CounterId. Counters are opened one by one
+ *       rather than as a group so that a machine which lacks, say, a dTLB
+ *       event still reports the others. If the kernel multiplexed a
+ *       counter, its count is scaled by time enabled over time running.
+ *       Counters are inherited, so threads started between Start and
+ *       Stop are counted once they have exited.
+ *
  *****************************************************************/
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <time.h>
 #include "assert.h"
 #include "cputiming_impl.h"
 
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#define HAVE_PERF_EVENTS 1
+#endif
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
  *              Forward declaration of functions/
  * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -43,6 +62,20 @@ static int timespec_subtract (struct timespec *result, struct timespec *x,
 
 static double timespec_to_double(struct timespec *x);
 
+#ifdef HAVE_PERF_EVENTS
+static int open_counter(CPUTime_CounterId counter);
+static double read_counter(int fd);
+#endif
+
+/* printable names, indexed by CPUTime_CounterId */
+static const char *counter_names[CPUTime_NUM_COUNTERS] = {
+        "cycles",
+        "instructions",
+        "L1d misses",
+        "LLC misses",
+        "dTLB misses",
+};
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
  *              Functions implementing the CPUTime interface
  * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -52,6 +85,11 @@ CPUTime_T CPUTime_New()
 {
         CPUTime_T startTimep = malloc(sizeof(*startTimep));
         assert (startTimep != NULL);
+        for (int c = 0; c < CPUTime_NUM_COUNTERS; c++) {
+                startTimep->counter_fd[c]    = -1;
+                startTimep->counter_start[c] = 0;
+                startTimep->counter_value[c] = 0;
+        }
         return startTimep;
 }
 
@@ -59,6 +97,13 @@ void CPUTime_Free(CPUTime_T *startTimepp)
 {
         assert(startTimepp != NULL);
         assert(*startTimepp != NULL);
+#ifdef HAVE_PERF_EVENTS
+        for (int c = 0; c < CPUTime_NUM_COUNTERS; c++) {
+                if ((*startTimepp)->counter_fd[c] >= 0) {
+                        close((*startTimepp)->counter_fd[c]);
+                }
+        }
+#endif
         free(*startTimepp);
         *startTimepp = NULL;
         return;
@@ -66,6 +111,17 @@ void CPUTime_Free(CPUTime_T *startTimepp)
 
 void CPUTime_Start(CPUTime_T startTimep)
 {
+#ifdef HAVE_PERF_EVENTS
+        for (int c = 0; c < CPUTime_NUM_COUNTERS; c++) {
+                int fd = startTimep->counter_fd[c];
+                if (fd >= 0) {
+                        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                        startTimep->counter_start[c] = read_counter(fd);
+                        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+        }
+#endif
+        /* read the clock last so counter setup is not timed */
         clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &(startTimep->time));
         return;
 }
@@ -74,14 +130,152 @@ double CPUTime_Stop(CPUTime_T startTimep)
 {
         struct timespec stop, time_used;
         clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+#ifdef HAVE_PERF_EVENTS
+        for (int c = 0; c < CPUTime_NUM_COUNTERS; c++) {
+                int fd = startTimep->counter_fd[c];
+                if (fd >= 0) {
+                        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                        startTimep->counter_value[c] =
+                                read_counter(fd) -
+                                startTimep->counter_start[c];
+                }
+        }
+#endif
         assert(timespec_subtract(&time_used, &stop, &(startTimep->time)) == 0);
         return timespec_to_double(&time_used);
 }
 
+/*
+ *  CPUTime_EnableCounters
+ *
+ *  Opens a hardware counter for each CPUTime_CounterId so that later
+ *  Start/Stop pairs also count events. Returns how many counters could
+ *  be opened; 0 means only CPU time will be measured.
+ */
+int CPUTime_EnableCounters(CPUTime_T timer)
+{
+        assert(timer != NULL);
+        int opened = 0;
+#ifdef HAVE_PERF_EVENTS
+        for (int c = 0; c < CPUTime_NUM_COUNTERS; c++) {
+                if (timer->counter_fd[c] < 0) {
+                        timer->counter_fd[c] = open_counter(c);
+                }
+                if (timer->counter_fd[c] >= 0) {
+                        opened++;
+                }
+        }
+#endif
+        return opened;
+}
+
+int CPUTime_CounterValid(CPUTime_T timer, CPUTime_CounterId counter)
+{
+        assert(timer != NULL);
+        assert(counter >= 0 && counter < CPUTime_NUM_COUNTERS);
+        return timer->counter_fd[counter] >= 0;
+}
+
+/*
+ *  CPUTime_Counter
+ *
+ *  The number of events counted between the most recent Start and Stop.
+ *  It is a checked runtime error to ask for a counter that is not valid.
+ */
+double CPUTime_Counter(CPUTime_T timer, CPUTime_CounterId counter)
+{
+        assert(CPUTime_CounterValid(timer, counter));
+        return timer->counter_value[counter];
+}
+
+const char *CPUTime_CounterName(CPUTime_CounterId counter)
+{
+        assert(counter >= 0 && counter < CPUTime_NUM_COUNTERS);
+        return counter_names[counter];
+}
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
  *     Utility functions called internally
  * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+#ifdef HAVE_PERF_EVENTS
+/*
+ *  open_counter
+ *
+ *  Opens a disabled, user-mode-only counter for the calling thread on
+ *  any CPU, inherited by every thread it creates from then on. Parallel
+ *  loops create their workers afresh (see parallel.h), so a count read
+ *  after the loop includes them. Returns the file descriptor, or -1 if
+ *  the event is not supported or perf_event_paranoid does not allow it.
+ */
+static int open_counter(CPUTime_CounterId counter)
+{
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.inherit        = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                              PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        /* cache events are encoded as id | op << 8 | result << 16 */
+        const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        switch (counter) {
+        case CPUTime_CYCLES:
+                attr.type   = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+        case CPUTime_INSTRUCTIONS:
+                attr.type   = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+        case CPUTime_L1D_MISSES:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+                break;
+        case CPUTime_LLC_MISSES:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | read_miss;
+                break;
+        case CPUTime_DTLB_MISSES:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+                break;
+        default:
+                return -1;
+        }
+
+        /* pid 0, cpu -1: this thread, and its new threads, anywhere */
+        long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        return fd < 0 ? -1 : (int)fd;
+}
+
+/*
+ *  read_counter
+ *
+ *  Reads a counter opened by open_counter, scaling the count up if the
+ *  kernel only had it scheduled on the PMU for part of the time.
+ */
+static double read_counter(int fd)
+{
+        uint64_t values[3];  /* count, time enabled, time running */
+        if (read(fd, values, sizeof(values)) != (ssize_t)sizeof(values)) {
+                return 0;
+        }
+        if (values[2] == 0) {
+                return 0;
+        }
+        double count = (double)values[0];
+        if (values[2] < values[1]) {
+                count *= (double)values[1] / (double)values[2];
+        }
+        return count;
+}
+#endif
+
 /*
  *  timespec_subtract
  * 
@@ -28,6 +28,22 @@
  *       Note that printf format %.0f is typically a reasonable way to
  *       print such integers.
  *
+ *       Hardware counters:
+ *
+ *       CPUTime_EnableCounters(timer);
+ *       CPUTime_Start(timer);
+ *         ... Do work to be timed here
+ *       double cputime = CPUTime_Stop(timer);
+ *       if (CPUTime_CounterValid(timer, CPUTime_CYCLES))
+ *               cycles = CPUTime_Counter(timer, CPUTime_CYCLES);
+ *
+ *       Counters are read with perf_event_open(2) and only cover user
+ *       mode. They count the thread that enabled them and the threads
+ *       it creates afterwards, once those have been joined. Any counter
+ *       the kernel or hardware will not provide (no permission, no PMU,
+ *       not Linux) is marked invalid and the timer falls back to
+ *       measuring CPU time alone.
+ *
  *****************************************************************/
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
@@ -36,6 +52,16 @@
 
 typedef struct CPU_Time *CPUTime_T;
 
+/* hardware events that can be collected for a timed region */
+typedef enum CPUTime_CounterId {
+        CPUTime_CYCLES = 0,
+        CPUTime_INSTRUCTIONS,
+        CPUTime_L1D_MISSES,
+        CPUTime_LLC_MISSES,
+        CPUTime_DTLB_MISSES,
+        CPUTime_NUM_COUNTERS
+} CPUTime_CounterId;
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
  *              Functions implementing the CPUTime interface
  * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -50,4 +76,12 @@ void CPUTime_Start(CPUTime_T StartTimep) ;
 
 double CPUTime_Stop(CPUTime_T startTimep) ;
 
+int CPUTime_EnableCounters(CPUTime_T timer);
+
+int CPUTime_CounterValid(CPUTime_T timer, CPUTime_CounterId counter);
+
+double CPUTime_Counter(CPUTime_T timer, CPUTime_CounterId counter);
+
+const char *CPUTime_CounterName(CPUTime_CounterId counter);
+
 #endif
@@ -33,4 +33,11 @@
 
 struct CPU_Time {
         struct timespec time;
+        /* perf_event_open descriptors, -1 when a counter is unavailable */
+        int counter_fd[CPUTime_NUM_COUNTERS];
+        /* readings at the most recent Start; a reset does not clear the
+           counts that exited threads have added to an inherited counter */
+        double counter_start[CPUTime_NUM_COUNTERS];
+        /* counts from the most recent Start/Stop pair */
+        double counter_value[CPUTime_NUM_COUNTERS];
 };
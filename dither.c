@@ -0,0 +1,197 @@
+/*
+ *     dither.c
+ *     Locality
+ *
+ *     Implementation of the error diffusion in dither.h. The errors
+ *     passed down live in two rows of floats used in turn; the wavefront
+ *     lag is what makes two enough (see dither_row).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sched.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "trace.h"
+#include "pnm.h"
+#include "bitmap.h"
+#include "dither.h"
+
+/* pixels in a segment, the unit rows wait for one another in */
+#define SEGMENT 128
+
+/* one image being dithered, shared by every row */
+struct job {
+        struct A2Pixels pixels;
+        int channels;                   /* 3, or 1 for the luma */
+        float levels;                   /* the new maxval */
+        float step;                     /* old maxval / levels */
+        Bitmap_T bitmap;                /* the luma's result, or NULL */
+        float *errors;                  /* 2 rows of width * channels */
+        int *done;                      /* segments finished, per row */
+        int segments;
+};
+
+/*
+ * Name: dither_row
+ *
+ * Description: dithers row j, a segment at a time, each segment once row
+ * j - 1 has finished the one after it
+ *
+ * Parameters:
+ *           int j: the row, an index of Parallel_for
+ *           void *cl: the struct job
+ *
+ * Returns: nothing
+ *
+ * Expects: Parallel_for hands rows out in increasing order, so the row
+ * waited on is always being done by some thread
+ *
+ * Notes: row j reads the errors in errors row j % 2 and writes those of
+ * row j + 1 in the other, which row j - 1 read. Writing pixel i's share
+ * reaches column i + 1, and it happens only after row j - 1 has done
+ * column i + 2 and so is past reading it. The first share to reach a
+ * column is stored rather than added, so no row needs clearing; the shares
+ * arrive from left to right, in the same order for any thread count
+ */
+static void dither_row(int j, void *cl)
+{
+        struct job *job = cl;
+        int width = job->pixels.width, channels = job->channels;
+        float *in = job->errors + (long)(j % 2) * width * channels;
+        float *next = job->errors + (long)((j + 1) % 2) * width * channels;
+        float carry[3] = { 0, 0, 0 };
+
+        TRACE_BEGIN_XY("row", "dither", 0, j);
+        for (int s = 0; s < job->segments; s++) {
+                if (j > 0) {
+                        int need = s + 2 < job->segments ? s + 2
+                                                         : job->segments;
+                        while (__atomic_load_n(&job->done[j - 1],
+                                               __ATOMIC_ACQUIRE) < need) {
+                                sched_yield();
+                        }
+                }
+                int end = (s + 1) * SEGMENT < width ? (s + 1) * SEGMENT
+                                                    : width;
+                for (int i = s * SEGMENT; i < end; i++) {
+                        struct Pnm_rgb *p = A2Pixels_at(&job->pixels, i, j);
+                        unsigned value[3] = { p->red, p->green, p->blue };
+                        if (channels == 1) {
+                                value[0] = (299 * p->red + 587 * p->green +
+                                            114 * p->blue + 500) / 1000;
+                        }
+                        unsigned level[3];
+                        for (int c = 0; c < channels; c++) {
+                                long k = (long)i * channels + c;
+                                float v = (float)value[c] + in[k] + carry[c];
+                                float q = floorf(v / job->step + 0.5f);
+                                q = q < 0 ? 0 : q > job->levels ? job->levels
+                                                                : q;
+                                float e = v - q * job->step;
+                                level[c] = (unsigned)q;
+                                carry[c] = e * (7.0f / 16);
+                                if (i > 0) {
+                                        next[k - channels] += e * (3.0f / 16);
+                                }
+                                if (i == 0) {
+                                        next[k] = e * (5.0f / 16);
+                                } else {
+                                        next[k] += e * (5.0f / 16);
+                                }
+                                if (i + 1 < width) {
+                                        next[k + channels] = e * (1.0f / 16);
+                                }
+                        }
+                        if (job->bitmap != NULL) {
+                                Bitmap_put(job->bitmap, i, j, level[0] == 0);
+                        } else {
+                                p->red   = level[0];
+                                p->green = level[1];
+                                p->blue  = level[2];
+                        }
+                }
+                __atomic_store_n(&job->done[j], s + 1, __ATOMIC_RELEASE);
+        }
+        TRACE_END("row", "dither");
+}
+
+/* runs the rows of job over the image's rows, in parallel */
+static void dither(struct job *job, A2Methods_T methods,
+                   A2Methods_UArray2 image, unsigned maxval, unsigned levels)
+{
+        A2Pixels_open(&job->pixels, methods, image);
+        int width = job->pixels.width, height = job->pixels.height;
+        job->levels   = (float)levels;
+        job->step     = (float)maxval / (float)levels;
+        job->errors   = CALLOC(2L * width * job->channels,
+                               sizeof(*job->errors));
+        job->done     = CALLOC(height, sizeof(*job->done));
+        job->segments = (width + SEGMENT - 1) / SEGMENT;
+        Parallel_for(height, dither_row, job);
+        FREE(job->errors);
+        FREE(job->done);
+        A2Pixels_close(&job->pixels);
+}
+
+/*
+ * Name: Dither_maxval
+ *
+ * Description: lowers the maxval of image from maxval to new_maxval,
+ * diffusing the rounding error of each channel
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of image
+ *           A2Methods_UArray2 image: Pnm_rgb pixels, changed in place
+ *           unsigned maxval: image's maxval
+ *           unsigned new_maxval: the maxval it is to have
+ *
+ * Returns: nothing
+ *
+ * Expects: image is not NULL and both maxvals are positive
+ *
+ * Notes: rows are spread over Parallel_threads() threads
+ */
+void Dither_maxval(A2Methods_T methods, A2Methods_UArray2 image,
+                   unsigned maxval, unsigned new_maxval)
+{
+        assert(methods != NULL && image != NULL);
+        assert(maxval > 0 && new_maxval > 0);
+        struct job job;
+        job.channels = 3;
+        job.bitmap = NULL;
+        dither(&job, methods, image, maxval, new_maxval);
+}
+
+/*
+ * Name: Dither_bitmap
+ *
+ * Description: dithers the luma of image down to black and white
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of image
+ *           A2Methods_UArray2 image: Pnm_rgb pixels, left as they are
+ *           unsigned maxval: image's maxval
+ *
+ * Returns: the bilevel image, to be freed with Bitmap_free
+ *
+ * Expects: image is not NULL and maxval is positive
+ *
+ * Notes: rows are spread over Parallel_threads() threads; each row's bits
+ * are only written by the thread doing it
+ */
+Bitmap_T Dither_bitmap(A2Methods_T methods, A2Methods_UArray2 image,
+                       unsigned maxval)
+{
+        assert(methods != NULL && image != NULL && maxval > 0);
+        struct job job;
+        job.channels = 1;
+        job.bitmap = Bitmap_new(methods->width(image),
+                                methods->height(image));
+        dither(&job, methods, image, maxval, 1);
+        return job.bitmap;
+}
@@ -0,0 +1,36 @@
+#ifndef DITHER_INCLUDED
+#define DITHER_INCLUDED
+/****************************************************************
+ *
+ *                         dither.h
+ *
+ *       Floyd-Steinberg error diffusion, to lower an image's maxval
+ *       (16-bit to 8-bit, say) or to turn it into a bilevel image,
+ *       without the banding of plain rounding. Each pixel is rounded
+ *       to the nearest level and its error is passed on: 7/16 to the
+ *       pixel on its right, and 3/16, 5/16 and 1/16 to the three
+ *       below it.
+ *
+ *       Dither_maxval   each channel, in place, to levels 0..new_maxval
+ *       Dither_bitmap   the luma (as PixelOps_grayscale) to a Bitmap_T,
+ *                       black where it rounds to 0
+ *
+ *       A row needs the errors of the row above, but only as far as
+ *       one pixel to the right of where it is. Rows are handed out to
+ *       threads in order (see parallel.h) and done left to right in
+ *       segments; a row starts a segment once the row above has
+ *       finished the next one, so successive rows run together two
+ *       segments apart, like a skewed wavefront. The result is the
+ *       same for any number of threads.
+ *
+ *****************************************************************/
+
+#include "a2methods.h"
+#include "bitmap.h"
+
+extern void     Dither_maxval(A2Methods_T methods, A2Methods_UArray2 image,
+                              unsigned maxval, unsigned new_maxval);
+extern Bitmap_T Dither_bitmap(A2Methods_T methods, A2Methods_UArray2 image,
+                              unsigned maxval);
+
+#endif
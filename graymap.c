@@ -0,0 +1,286 @@
+/*
+ *     graymap.c
+ *     Locality
+ *
+ *     Implementation of Graymap_T (see graymap.h): PGM reading and
+ *     writing a row at a time, and the exact operations tile by tile, one
+ *     loop for each sample size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "trace.h"
+#include "pnm.h"
+#include "pnmio.h"
+#include "transform.h"
+#include "movetile.h"
+#include "graymap.h"
+
+#define T Graymap_T
+
+/* tile side */
+#define TILE 64
+
+struct Graymap {
+        int width, height;
+        unsigned maxval;
+        int bytes;                      /* per sample, 1 or 2 */
+        unsigned char *samples;         /* row by row */
+};
+
+/* one operation in progress, shared by every tile */
+struct job {
+        T source, dest;
+        Transform_position *position;
+        int tiles_across;
+};
+
+T Graymap_new(int width, int height, unsigned maxval)
+{
+        assert(width > 0 && height > 0);
+        assert(maxval > 0 && maxval <= 65535);
+        T graymap;
+        NEW(graymap);
+        graymap->width   = width;
+        graymap->height  = height;
+        graymap->maxval  = maxval;
+        graymap->bytes   = maxval < 256 ? 1 : 2;
+        graymap->samples = ALLOC((long)width * height * graymap->bytes);
+        return graymap;
+}
+
+void Graymap_free(T *graymap)
+{
+        assert(graymap != NULL && *graymap != NULL);
+        FREE((*graymap)->samples);
+        FREE(*graymap);
+}
+
+int Graymap_width(T graymap)
+{
+        assert(graymap != NULL);
+        return graymap->width;
+}
+
+int Graymap_height(T graymap)
+{
+        assert(graymap != NULL);
+        return graymap->height;
+}
+
+unsigned Graymap_maxval(T graymap)
+{
+        assert(graymap != NULL);
+        return graymap->maxval;
+}
+
+unsigned Graymap_get(T graymap, int i, int j)
+{
+        assert(graymap != NULL);
+        assert(i >= 0 && i < graymap->width && j >= 0 &&
+               j < graymap->height);
+        long k = (long)j * graymap->width + i;
+        if (graymap->bytes == 1) {
+                return graymap->samples[k];
+        }
+        return ((const uint16_t *)(void *)graymap->samples)[k];
+}
+
+static void too_large(void)
+{
+        fprintf(stderr, "Error: PGM sample exceeds maxval\n");
+        exit(EXIT_FAILURE);
+}
+
+/*
+ * Name: Graymap_read
+ *
+ * Description: reads a PGM image whose magic number has been read
+ *
+ * Parameters:
+ *           FILE *fp: the open stream, just after the magic number
+ *           int magic: the digit of the magic number, '2' (plain) or '5'
+ *           (raw)
+ *
+ * Returns: the image, to be freed with Graymap_free
+ *
+ * Expects: fp is not NULL
+ *
+ * Notes: exits with an error message if the header is not valid, a
+ * sample, plain or raw, exceeds maxval or the image ends early. Raw
+ * samples of one byte are read straight into place and then checked;
+ * two-byte samples, most significant byte first in the file, are kept in
+ * the machine's order
+ */
+T Graymap_read(FILE *fp, int magic)
+{
+        assert(fp != NULL && (magic == '2' || magic == '5'));
+        int width = PnmIO_number(fp);
+        int height = PnmIO_number(fp);
+        int maxval = PnmIO_number(fp);
+        if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535) {
+                fprintf(stderr, "Error: invalid PGM header\n");
+                exit(EXIT_FAILURE);
+        }
+        T graymap = Graymap_new(width, height, (unsigned)maxval);
+        long count = (long)width * height;
+        uint16_t *wide = (uint16_t *)(void *)graymap->samples;
+
+        if (magic == '2') {
+                for (long k = 0; k < count; k++) {
+                        int v = PnmIO_number(fp);
+                        if (v > maxval) {
+                                too_large();
+                        }
+                        if (graymap->bytes == 1) {
+                                graymap->samples[k] = (unsigned char)v;
+                        } else {
+                                wide[k] = (uint16_t)v;
+                        }
+                }
+                return graymap;
+        }
+
+        size_t row_bytes = (size_t)width * graymap->bytes;
+        for (int j = 0; j < height; j++) {
+                unsigned char *row = graymap->samples + j * row_bytes;
+                if (fread(row, 1, row_bytes, fp) != row_bytes) {
+                        fprintf(stderr, "Error: PGM image is truncated\n");
+                        exit(EXIT_FAILURE);
+                }
+                if (graymap->bytes == 2) {
+                        uint16_t *samples = wide + (long)j * width;
+                        for (int i = 0; i < width; i++) {
+                                samples[i] = (uint16_t)(row[2 * i] << 8 |
+                                                        row[2 * i + 1]);
+                                if (samples[i] > maxval) {
+                                        too_large();
+                                }
+                        }
+                } else if (maxval < 255) {
+                        for (int i = 0; i < width; i++) {
+                                if (row[i] > maxval) {
+                                        too_large();
+                                }
+                        }
+                }
+        }
+        return graymap;
+}
+
+/* writes graymap as a raw (P5) PGM */
+void Graymap_write(FILE *fp, T graymap)
+{
+        assert(fp != NULL && graymap != NULL);
+        size_t row_bytes = (size_t)graymap->width * graymap->bytes;
+        unsigned char *bytes = ALLOC((long)row_bytes);
+        fprintf(fp, "P5\n%d %d\n%u\n", graymap->width, graymap->height,
+                graymap->maxval);
+        for (int j = 0; j < graymap->height; j++) {
+                const unsigned char *row = graymap->samples + j * row_bytes;
+                if (graymap->bytes == 2) {
+                        const uint16_t *samples = (const uint16_t *)
+                                (const void *)row;
+                        for (int i = 0; i < graymap->width; i++) {
+                                bytes[2 * i] = samples[i] >> 8;
+                                bytes[2 * i + 1] = samples[i] & 0xff;
+                        }
+                        row = bytes;
+                }
+                if (fwrite(row, 1, row_bytes, fp) != row_bytes) {
+                        fprintf(stderr, "Error: cannot write image\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        FREE(bytes);
+}
+
+/* the loops over one tile, one for each sample size */
+MOVETILE_DEFINE(move_tile8, uint8_t)
+MOVETILE_DEFINE(move_tile16, uint16_t)
+
+static void move_tile(int index, void *cl)
+{
+        const struct job *job = cl;
+        T source = job->source, dest = job->dest;
+        int x0 = index % job->tiles_across * TILE;
+        int y0 = index / job->tiles_across * TILE;
+        int x1 = x0 + TILE < source->width ? x0 + TILE : source->width;
+        int y1 = y0 + TILE < source->height ? y0 + TILE : source->height;
+
+        TRACE_BEGIN_XY("tile", "graymap", x0, y0);
+        if (source->bytes == 1) {
+                move_tile8(job->position, source->samples, source->width,
+                           source->height, dest->samples, dest->width, x0,
+                           y0, x1, y1);
+        } else {
+                move_tile16(job->position, source->samples, source->width,
+                            source->height, dest->samples, dest->width, x0,
+                            y0, x1, y1);
+        }
+        TRACE_END("tile", "graymap");
+}
+
+/*
+ * Name: Graymap_transform
+ *
+ * Description: makes the image that the exact operation transform turns
+ * graymap into
+ *
+ * Parameters:
+ *           T graymap: the original
+ *           const Transform *transform: one of Transform_table
+ *
+ * Returns: the new image, to be freed with Graymap_free
+ *
+ * Expects: neither argument is NULL
+ *
+ * Notes: the work is spread over Parallel_threads() threads by 64x64
+ * tiles of the original
+ */
+T Graymap_transform(T graymap, const Transform *transform)
+{
+        assert(graymap != NULL && transform != NULL);
+        struct job job;
+        job.source = graymap;
+        if (transform->swaps_dimensions) {
+                job.dest = Graymap_new(graymap->height, graymap->width,
+                                       graymap->maxval);
+        } else {
+                job.dest = Graymap_new(graymap->width, graymap->height,
+                                       graymap->maxval);
+        }
+        job.position = transform->position;
+        job.tiles_across = (graymap->width + TILE - 1) / TILE;
+        int tiles_down = (graymap->height + TILE - 1) / TILE;
+        Parallel_for(job.tiles_across * tiles_down, move_tile, &job);
+        return job.dest;
+}
+
+/* graymap as Pnm_rgb pixels, gray in every channel, for every other
+   operation */
+A2Methods_UArray2 Graymap_pixels(T graymap, A2Methods_T methods)
+{
+        assert(graymap != NULL && methods != NULL);
+        A2Methods_UArray2 array2 = methods->new(graymap->width,
+                                                graymap->height,
+                                                sizeof(struct Pnm_rgb));
+        struct A2Pixels pixels;
+        A2Pixels_open(&pixels, methods, array2);
+        for (int j = 0; j < graymap->height; j++) {
+                for (int i = 0; i < graymap->width; i++) {
+                        struct Pnm_rgb *p = A2Pixels_at(&pixels, i, j);
+                        p->red = p->green = p->blue =
+                                Graymap_get(graymap, i, j);
+                }
+        }
+        A2Pixels_close(&pixels);
+        return array2;
+}
@@ -0,0 +1,47 @@
+#ifndef GRAYMAP_INCLUDED
+#define GRAYMAP_INCLUDED
+/****************************************************************
+ *
+ *                         graymap.h
+ *
+ *       Interface to type Graymap_T, a grayscale (PGM) image stored
+ *       as packed samples: one byte each when maxval < 256, two
+ *       otherwise, row by row. Pnm_rgb pixels would take 12 bytes.
+ *
+ *       Usage:
+ *
+ *       PnmIO_magic(fp) read, then:
+ *       Graymap_T graymap = Graymap_read(fp, magic);
+ *       Graymap_T rotated = Graymap_transform(graymap, transform);
+ *       Graymap_write(stdout, rotated);
+ *
+ *       The exact operations of transform.h move 64x64 tiles of
+ *       samples, each tile's rows going to the rows (or columns) of
+ *       the new image that transform's position function gives, so
+ *       that reads and writes both stay within a few pages. Tiles are
+ *       spread over threads (see parallel.h).
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include "a2methods.h"
+#include "transform.h"
+
+typedef struct Graymap *Graymap_T;
+
+extern Graymap_T Graymap_new(int width, int height, unsigned maxval);
+extern Graymap_T Graymap_read(FILE *fp, int magic);
+extern void      Graymap_write(FILE *fp, Graymap_T graymap);
+extern void      Graymap_free(Graymap_T *graymap);
+
+extern int      Graymap_width(Graymap_T graymap);
+extern int      Graymap_height(Graymap_T graymap);
+extern unsigned Graymap_maxval(Graymap_T graymap);
+extern unsigned Graymap_get(Graymap_T graymap, int i, int j);
+
+extern Graymap_T Graymap_transform(Graymap_T graymap,
+                                   const Transform *transform);
+extern A2Methods_UArray2 Graymap_pixels(Graymap_T graymap,
+                                        A2Methods_T methods);
+
+#endif
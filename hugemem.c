@@ -0,0 +1,147 @@
+/*
+ *     hugemem.c
+ *     Locality
+ *
+ *     Implementation of the huge page allocator (see hugemem.h). Large
+ *     buffers are mapped anonymously with room to spare, trimmed to a
+ *     2 MiB aligned range so that every huge page they could use is
+ *     fully inside the buffer, and advised as huge page candidates.
+ *     Everything degrades to heap memory on systems without those
+ *     mmap/madvise flags.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "mem.h"
+#include "hugemem.h"
+
+static HugeMem_Policy policy = HugeMem_THP;
+
+static const char *policy_names[] = { "off", "thp", "hugetlb" };
+
+void HugeMem_set_policy(HugeMem_Policy new_policy)
+{
+        assert(new_policy == HugeMem_OFF || new_policy == HugeMem_THP ||
+               new_policy == HugeMem_HUGETLB);
+        policy = new_policy;
+}
+
+HugeMem_Policy HugeMem_policy(void)
+{
+        return policy;
+}
+
+/* look up a policy by name ("off", "thp" or "hugetlb"); false if unknown */
+bool HugeMem_parse(const char *name, HugeMem_Policy *result)
+{
+        assert(name != NULL && result != NULL);
+        for (int i = 0; i < 3; i++) {
+                if (strcmp(name, policy_names[i]) == 0) {
+                        *result = (HugeMem_Policy)i;
+                        return true;
+                }
+        }
+        return false;
+}
+
+static size_t round_up(size_t n)
+{
+        return (n + HUGEMEM_PAGE - 1) & ~(HUGEMEM_PAGE - 1);
+}
+
+/* anonymous mapping of nbytes aligned to HUGEMEM_PAGE, or NULL */
+static void *map_aligned(size_t nbytes)
+{
+        size_t length = round_up(nbytes);
+        char *raw = mmap(NULL, length + HUGEMEM_PAGE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+                return NULL;
+        }
+
+        /* give back the misaligned head and the unused tail */
+        char *start = (char *)(((uintptr_t)raw + HUGEMEM_PAGE - 1) &
+                               ~(uintptr_t)(HUGEMEM_PAGE - 1));
+        if (start > raw) {
+                munmap(raw, start - raw);
+        }
+        size_t tail = (raw + length + HUGEMEM_PAGE) - (start + length);
+        if (tail > 0) {
+                munmap(start + length, tail);
+        }
+#if defined(MADV_HUGEPAGE)
+        madvise(start, length, MADV_HUGEPAGE);
+#endif
+        return start;
+}
+
+/* mapping of nbytes from the hugetlbfs pool; exits if there is none */
+static void *map_hugetlb(size_t nbytes)
+{
+#if defined(MAP_HUGETLB)
+        void *p = mmap(NULL, round_up(nbytes), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+                return p;
+        }
+#endif
+        fprintf(stderr, "Error: cannot get %lu bytes of huge pages "
+                        "(see /proc/sys/vm/nr_hugepages)\n",
+                (unsigned long)round_up(nbytes));
+        exit(EXIT_FAILURE);
+}
+
+/*
+ * Name: HugeMem_alloc
+ * 
+ * Description: allocates a zeroed buffer of nbytes bytes, backed by huge
+ * pages according to the current policy when it is large enough
+ *
+ * Parameters:
+ *           size_t nbytes: the size of the buffer
+ *           bool *mapped: set to whether the buffer was mapped rather than
+ *                         taken from the heap
+ *        
+ * Returns: the buffer
+ * 
+ * Expects: mapped is not NULL
+ * 
+ * Notes: heap exhaustion raises Mem_Failed; under HugeMem_HUGETLB a
+ * missing huge page pool is a fatal error. A THP mapping that fails falls
+ * back to the heap
+ */
+void *HugeMem_alloc(size_t nbytes, bool *mapped)
+{
+        assert(mapped != NULL);
+        *mapped = false;
+        if (nbytes >= HUGEMEM_THRESHOLD) {
+                void *p = NULL;
+                if (policy == HugeMem_HUGETLB) {
+                        p = map_hugetlb(nbytes);
+                } else if (policy == HugeMem_THP) {
+                        p = map_aligned(nbytes);
+                }
+                if (p != NULL) {
+                        *mapped = true;
+                        return p;
+                }
+        }
+        return CALLOC(1, nbytes > 0 ? (long)nbytes : 1);
+}
+
+/* release a buffer from HugeMem_alloc, given its size and mapped flag */
+void HugeMem_free(void *ptr, size_t nbytes, bool mapped)
+{
+        if (ptr == NULL) {
+                return;
+        }
+        if (mapped) {
+                munmap(ptr, round_up(nbytes));
+        } else {
+                FREE(ptr);
+        }
+}
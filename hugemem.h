@@ -0,0 +1,45 @@
+#ifndef HUGEMEM_INCLUDED
+#define HUGEMEM_INCLUDED
+/****************************************************************
+ *
+ *                         hugemem.h
+ *
+ *       Allocator for the element storage of UArray2 and UArray2b.
+ *       Buffers of at least HUGEMEM_THRESHOLD bytes can be backed by
+ *       2 MiB pages, so that column walks and 90-degree rotations over
+ *       a wide image, which touch a new 4 KiB page on almost every
+ *       access, miss in the dTLB far less often:
+ *
+ *         HugeMem_OFF      plain zeroed heap memory
+ *         HugeMem_THP      anonymous memory aligned to 2 MiB and
+ *                          marked with madvise(MADV_HUGEPAGE), so the
+ *                          kernel backs it with transparent huge pages
+ *                          when it can (the default)
+ *         HugeMem_HUGETLB  explicit pages from the hugetlbfs pool
+ *                          (MAP_HUGETLB); failing to get them is fatal
+ *
+ *       Smaller buffers always come from the heap. All buffers are
+ *       zeroed. The policy is global and only affects buffers
+ *       allocated after it is set; HugeMem_free must be passed back
+ *       the mapped flag HugeMem_alloc returned.
+ *
+ *****************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HUGEMEM_PAGE      (2UL << 20)
+#define HUGEMEM_THRESHOLD HUGEMEM_PAGE
+
+typedef enum {
+        HugeMem_OFF, HugeMem_THP, HugeMem_HUGETLB
+} HugeMem_Policy;
+
+extern void HugeMem_set_policy(HugeMem_Policy policy);
+extern HugeMem_Policy HugeMem_policy(void);
+extern bool HugeMem_parse(const char *name, HugeMem_Policy *policy);
+
+extern void *HugeMem_alloc(size_t nbytes, bool *mapped);
+extern void  HugeMem_free(void *ptr, size_t nbytes, bool mapped);
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ *     imagegen.c
+ *     Locality
+ *
+ *     This file implements the synthetic image generator. ImageGen_fill
+ *     writes a pattern into an existing A2 array of Pnm_rgb pixels, and
+ *     ImageGen_write streams the same pattern to a binary PPM one row at
+ *     a time, so images far larger than memory can be produced.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "assert.h"
+#include "a2methods.h"
+#include "pnm.h"
+#include "imagegen.h"
+
+/* struct to hand the parameters to the fill apply function */
+struct fill_closure {
+        const ImageGen_Params *params;
+};
+
+/* a 32-bit integer hash (lowbias32), good enough to look like noise */
+static uint32_t hash(uint32_t x)
+{
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+}
+
+static uint32_t hash3(uint32_t a, uint32_t b, uint32_t c)
+{
+        return hash(a ^ hash(b ^ hash(c)));
+}
+
+/* scale position pos in [0, extent) to [0, maxval] */
+static unsigned ramp(long pos, long extent, unsigned maxval)
+{
+        if (extent <= 1) {
+                return 0;
+        }
+        return (unsigned)((uint64_t)pos * maxval / (extent - 1));
+}
+
+/* spread the low 16 bits of hash value v evenly over [0, maxval] */
+static unsigned level(uint32_t v, unsigned maxval)
+{
+        return (unsigned)(((uint64_t)(v & 0xffff) * (maxval + 1)) >> 16);
+}
+
+static void check_params(const ImageGen_Params *params)
+{
+        assert(params != NULL);
+        assert(params->width > 0 && params->height > 0);
+        assert(params->maxval >= 1 && params->maxval <= 65535);
+        assert(params->pattern != ImageGen_TILES || params->tile > 0);
+}
+
+
+/*
+ * Name: ImageGen_pattern
+ * 
+ * Description: converts a pattern name ("gradient", "noise" or "tiles") to
+ * its ImageGen_Pattern
+ *
+ * Parameters:
+ *           const char *name: the name given on the command line
+ *           ImageGen_Pattern *pattern: where to store the pattern
+ *        
+ * Returns: 1 if the name is known, 0 otherwise
+ * 
+ * Expects: name and pattern are not NULL
+ * 
+ * Notes: *pattern is left unchanged for an unknown name
+ */
+int ImageGen_pattern(const char *name, ImageGen_Pattern *pattern)
+{
+        assert(name != NULL && pattern != NULL);
+        if (strcmp(name, "gradient") == 0) {
+                *pattern = ImageGen_GRADIENT;
+        } else if (strcmp(name, "noise") == 0) {
+                *pattern = ImageGen_NOISE;
+        } else if (strcmp(name, "tiles") == 0) {
+                *pattern = ImageGen_TILES;
+        } else {
+                return 0;
+        }
+        return 1;
+}
+
+
+/*
+ * Name: ImageGen_pixel
+ * 
+ * Description: computes the pixel at column i, row j of the image described
+ * by params
+ *
+ * Parameters:
+ *           const ImageGen_Params *params: the image to generate
+ *           int i, int j: the column and row of the pixel
+ *           Pnm_rgb pixel: where to store the pixel
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid params and a position inside the image
+ * 
+ * Notes: every channel is in [0, maxval]
+ */
+void ImageGen_pixel(const ImageGen_Params *params, int i, int j,
+                    Pnm_rgb pixel)
+{
+        unsigned maxval = params->maxval;
+        uint32_t h;
+
+        switch (params->pattern) {
+        case ImageGen_GRADIENT:
+                pixel->red   = ramp(i, params->width, maxval);
+                pixel->green = ramp(j, params->height, maxval);
+                pixel->blue  = ramp((long)i + j,
+                                    (long)params->width + params->height - 1,
+                                    maxval);
+                break;
+        case ImageGen_NOISE:
+                h = hash3(params->seed, (uint32_t)i, (uint32_t)j);
+                pixel->red   = (h & 0xffff) % (maxval + 1);
+                pixel->green = (h >> 16) % (maxval + 1);
+                pixel->blue  = hash(h) % (maxval + 1);
+                break;
+        case ImageGen_TILES:
+                h = hash3(params->seed, (uint32_t)(i / params->tile),
+                          (uint32_t)(j / params->tile));
+                pixel->red   = level(h, maxval);
+                pixel->green = level(h >> 16, maxval);
+                pixel->blue  = level(hash(h), maxval);
+                break;
+        }
+}
+
+
+static void fill_apply(int i, int j, A2Methods_UArray2 array2, void *elem,
+                       void *cl)
+{
+        (void)array2;
+        struct fill_closure *closure = cl;
+        ImageGen_pixel(closure->params, i, j, elem);
+}
+
+
+/*
+ * Name: ImageGen_fill
+ * 
+ * Description: writes the generated image into an existing A2 array, using
+ * the array's default map so every layout is filled in its own best order
+ *
+ * Parameters:
+ *           const ImageGen_Params *params: the image to generate
+ *           A2Methods_T methods: the methods of array2
+ *           A2Methods_UArray2 array2: an array of struct Pnm_rgb
+ *        
+ * Returns: nothing
+ * 
+ * Expects: array2 has the width and height given in params
+ * 
+ * Notes: results in a checked runtime error if the dimensions or element
+ * size do not match, or if params is invalid
+ */
+void ImageGen_fill(const ImageGen_Params *params, A2Methods_T methods,
+                   A2Methods_UArray2 array2)
+{
+        check_params(params);
+        assert(methods != NULL && array2 != NULL);
+        assert(methods->width(array2) == params->width);
+        assert(methods->height(array2) == params->height);
+        assert(methods->size(array2) == sizeof(struct Pnm_rgb));
+
+        struct fill_closure closure = { params };
+        methods->map_default(array2, fill_apply, &closure);
+}
+
+
+/*
+ * Name: ImageGen_write
+ * 
+ * Description: streams the generated image to fp as a binary (P6) PPM, one
+ * row at a time, without ever holding the whole image in memory
+ *
+ * Parameters:
+ *           const ImageGen_Params *params: the image to generate
+ *           FILE *fp: the open output stream
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid params and an open stream
+ * 
+ * Notes: samples are one byte when maxval < 256 and two bytes (most
+ * significant first) otherwise, as the PPM format requires. Exits with an
+ * error message if the stream cannot be written
+ */
+void ImageGen_write(const ImageGen_Params *params, FILE *fp)
+{
+        check_params(params);
+        assert(fp != NULL);
+
+        int bytes = params->maxval < 256 ? 1 : 2;
+        size_t row_bytes = (size_t)params->width * 3 * bytes;
+        unsigned char *row = malloc(row_bytes);
+        assert(row != NULL);
+
+        fprintf(fp, "P6\n%d %d\n%u\n", params->width, params->height,
+                params->maxval);
+        for (int j = 0; j < params->height; j++) {
+                unsigned char *p = row;
+                for (int i = 0; i < params->width; i++) {
+                        struct Pnm_rgb pixel;
+                        ImageGen_pixel(params, i, j, &pixel);
+                        unsigned samples[3] = { pixel.red, pixel.green,
+                                                pixel.blue };
+                        for (int c = 0; c < 3; c++) {
+                                if (bytes == 2) {
+                                        *p++ = samples[c] >> 8;
+                                }
+                                *p++ = samples[c] & 0xff;
+                        }
+                }
+                if (fwrite(row, 1, row_bytes, fp) != row_bytes) {
+                        fprintf(stderr, "Error: cannot write image\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        free(row);
+}
@@ -0,0 +1,40 @@
+/*
+ *     imagegen.h
+ *     Locality
+ *
+ *     Interface to a deterministic synthetic image generator. Every pixel
+ *     is a pure function of its position, the image size, the maxval, the
+ *     pattern and a seed, so the same parameters always give the same
+ *     image whether it is streamed to a file or written into an A2 array.
+ */
+
+#ifndef IMAGEGEN_INCLUDED
+#define IMAGEGEN_INCLUDED
+
+#include <stdio.h>
+#include "a2methods.h"
+#include "pnm.h"
+
+typedef enum ImageGen_Pattern {
+        ImageGen_GRADIENT,   /* red across, green down, blue diagonal */
+        ImageGen_NOISE,      /* hashed per pixel, incompressible */
+        ImageGen_TILES       /* constant squares of tile x tile pixels */
+} ImageGen_Pattern;
+
+/* everything that determines a generated image */
+typedef struct ImageGen_Params {
+        int              width, height;
+        unsigned         maxval;    /* 1 to 65535 */
+        ImageGen_Pattern pattern;
+        unsigned         seed;
+        int              tile;      /* side of a tile, for ImageGen_TILES */
+} ImageGen_Params;
+
+extern int  ImageGen_pattern(const char *name, ImageGen_Pattern *pattern);
+extern void ImageGen_pixel(const ImageGen_Params *params, int i, int j,
+                           Pnm_rgb pixel);
+extern void ImageGen_fill(const ImageGen_Params *params, A2Methods_T methods,
+                          A2Methods_UArray2 array2);
+extern void ImageGen_write(const ImageGen_Params *params, FILE *fp);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ *     movetile.h
+ *     Locality
+ *
+ *     Header-only loop that moves a rectangle of a packed image (samples
+ *     or pixels of one fixed-size type, stored row by row) to where an
+ *     exact operation puts it. Every row of the rectangle is a straight
+ *     line in the new image, so two calls of the operation's
+ *     Transform_position give where a row starts and its step.
+ *
+ *     Usage:
+ *
+ *     MOVETILE_DEFINE(move_gray8, uint8_t)
+ *     ...
+ *     move_gray8(position, from, width, height, to, new_width,
+ *                x0, y0, x1, y1);
+ *
+ *     moves columns [x0, x1) of rows [y0, y1) of the width x height image
+ *     from into to, whose rows are new_width elements long. graymap.c
+ *     and pam.c share it for their tiles.
+ */
+
+#ifndef MOVETILE_INCLUDED
+#define MOVETILE_INCLUDED
+
+#include "transform.h"
+
+#define MOVETILE_DEFINE(NAME, TYPE)                                         \
+static inline void NAME(Transform_position *position, const void *source,   \
+                        int width, int height, void *dest, int new_width,   \
+                        int x0, int y0, int x1, int y1)                     \
+{                                                                           \
+        const TYPE *from = source;                                          \
+        TYPE *to = dest;                                                    \
+        for (int j = y0; j < y1; j++) {                                     \
+                int di, dj, ni, nj;                                         \
+                position(x0, j, width, height, &di, &dj);                   \
+                position(x0 + 1, j, width, height, &ni, &nj);               \
+                long at = (long)dj * new_width + di;                        \
+                long step = (long)(nj - dj) * new_width + (ni - di);        \
+                const TYPE *p = from + (long)j * width;                     \
+                for (int i = x0; i < x1; i++) {                             \
+                        to[at] = p[i];                                      \
+                        at += step;                                         \
+                }                                                           \
+        }                                                                   \
+}
+
+#endif
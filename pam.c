@@ -0,0 +1,638 @@
+/*
+ *     pam.c
+ *     Locality
+ *
+ *     Implementation of Pam_T (see pam.h): P7 headers and rows, the exact
+ *     operations a 64x64 tile at a time, and the compositing fused with
+ *     them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "trace.h"
+#include "pnm.h"
+#include "pnmio.h"
+#include "transform.h"
+#include "movetile.h"
+#include "pam.h"
+
+#define T Pam_T
+
+/* tile side */
+#define TILE 64
+
+/* longest tuple type kept */
+#define TUPLTYPE_MAX 64
+
+struct Pam {
+        int width, height;
+        unsigned maxval;
+        int depth;                      /* samples per pixel in the file */
+        char tupltype[TUPLTYPE_MAX + 1];
+        int bytes;                      /* per sample, 1 or 2 */
+        unsigned char *samples;         /* red, green, blue, alpha */
+};
+
+/* an exact operation on a PAM and the image, if any, its result is
+   composited over as each tile of it lands */
+struct job {
+        T source, dest, background;
+        const Transform *transform;
+        int tiles_across;
+};
+
+static const char *tuple_types[] = {
+        "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA"
+};
+
+static void bad_header(void)
+{
+        fprintf(stderr, "Error: invalid PAM header\n");
+        exit(EXIT_FAILURE);
+}
+
+T Pam_new(int width, int height, unsigned maxval, int depth)
+{
+        assert(width > 0 && height > 0);
+        assert(maxval > 0 && maxval <= 65535);
+        assert(depth >= 1 && depth <= 4);
+        T pam;
+        NEW(pam);
+        pam->width   = width;
+        pam->height  = height;
+        pam->maxval  = maxval;
+        pam->depth   = depth;
+        strcpy(pam->tupltype, tuple_types[depth - 1]);
+        pam->bytes   = maxval < 256 ? 1 : 2;
+        pam->samples = ALLOC((long)width * height * 4 * pam->bytes);
+        return pam;
+}
+
+void Pam_free(T *pam)
+{
+        assert(pam != NULL && *pam != NULL);
+        FREE((*pam)->samples);
+        FREE(*pam);
+}
+
+int Pam_width(T pam)
+{
+        assert(pam != NULL);
+        return pam->width;
+}
+
+int Pam_height(T pam)
+{
+        assert(pam != NULL);
+        return pam->height;
+}
+
+unsigned Pam_maxval(T pam)
+{
+        assert(pam != NULL);
+        return pam->maxval;
+}
+
+int Pam_depth(T pam)
+{
+        assert(pam != NULL);
+        return pam->depth;
+}
+
+/* sample c (red, green, blue, alpha) of the k-th pixel in row order */
+static inline unsigned sample(T pam, long k, int c)
+{
+        if (pam->bytes == 1) {
+                return pam->samples[4 * k + c];
+        }
+        return ((const uint16_t *)(const void *)pam->samples)[4 * k + c];
+}
+
+static inline void set_sample(T pam, long k, int c, unsigned value)
+{
+        if (pam->bytes == 1) {
+                pam->samples[4 * k + c] = (unsigned char)value;
+        } else {
+                ((uint16_t *)(void *)pam->samples)[4 * k + c] =
+                        (uint16_t)value;
+        }
+}
+
+/* sample channel (0 to 3: red, green, blue, alpha) of pixel (i, j) */
+unsigned Pam_get(T pam, int i, int j, int channel)
+{
+        assert(pam != NULL);
+        assert(i >= 0 && i < pam->width && j >= 0 && j < pam->height);
+        assert(channel >= 0 && channel < 4);
+        return sample(pam, (long)j * pam->width + i, channel);
+}
+
+/* reads a header keyword into word, and the one character after it */
+static void header_word(FILE *fp, char *word, int size)
+{
+        int c = getc(fp);
+        while (isspace(c) || c == '#') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(fp);
+                        }
+                }
+                c = getc(fp);
+        }
+        int length = 0;
+        while (c != EOF && !isspace(c)) {
+                if (length + 1 == size) {
+                        bad_header();
+                }
+                word[length++] = (char)c;
+                c = getc(fp);
+        }
+        word[length] = '\0';
+}
+
+/* reads the rest of a TUPLTYPE line, without the spaces around it */
+static void header_line(FILE *fp, char *line, int size)
+{
+        int c = getc(fp);
+        while (c == ' ' || c == '\t') {
+                c = getc(fp);
+        }
+        int length = 0;
+        while (c != '\n' && c != EOF) {
+                if (length + 1 < size) {
+                        line[length++] = (char)c;
+                }
+                c = getc(fp);
+        }
+        while (length > 0 && isspace((unsigned char)line[length - 1])) {
+                length--;
+        }
+        line[length] = '\0';
+}
+
+/* exits with an error message if any of the count samples of a raw row,
+   bytes each, exceeds maxval */
+static void check_row(const unsigned char *row, long count, int bytes,
+                      unsigned maxval)
+{
+        if (bytes == 1 && maxval >= 255) {
+                return;
+        }
+        for (long k = 0; k < count; k++) {
+                unsigned v = bytes == 1 ? row[k]
+                                        : (unsigned)row[2 * k] << 8 |
+                                          row[2 * k + 1];
+                if (v > maxval) {
+                        fprintf(stderr, "Error: PAM sample exceeds "
+                                        "maxval\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+}
+
+/*
+ * Name: Pam_read
+ *
+ * Description: reads a PAM image whose magic number has been read
+ *
+ * Parameters:
+ *           FILE *fp: the open stream, just after the magic number
+ *
+ * Returns: the image, to be freed with Pam_free
+ *
+ * Expects: fp is not NULL
+ *
+ * Notes: exits with an error message if the header is not valid, the
+ * depth is not 1 to 4, a sample exceeds maxval or the image ends early.
+ * Depths 1 to 4 are read as GRAYSCALE, GRAYSCALE_ALPHA, RGB and RGB_ALPHA
+ * whatever the tuple type says; the tuple type is only kept for writing.
+ * Raw RGB_ALPHA rows of one-byte samples are read straight into place and
+ * then checked
+ */
+T Pam_read(FILE *fp)
+{
+        assert(fp != NULL);
+        int width = -1, height = -1, depth = -1, maxval = -1;
+        char tupltype[TUPLTYPE_MAX + 1] = "";
+        char word[16];
+        for (;;) {
+                header_word(fp, word, sizeof(word));
+                if (strcmp(word, "ENDHDR") == 0) {
+                        break;
+                } else if (strcmp(word, "WIDTH") == 0) {
+                        width = PnmIO_number(fp);
+                } else if (strcmp(word, "HEIGHT") == 0) {
+                        height = PnmIO_number(fp);
+                } else if (strcmp(word, "DEPTH") == 0) {
+                        depth = PnmIO_number(fp);
+                } else if (strcmp(word, "MAXVAL") == 0) {
+                        maxval = PnmIO_number(fp);
+                } else if (strcmp(word, "TUPLTYPE") == 0) {
+                        header_line(fp, tupltype, sizeof(tupltype));
+                } else {
+                        bad_header();
+                }
+        }
+        if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535) {
+                bad_header();
+        }
+        if (depth < 1 || depth > 4) {
+                fprintf(stderr, "Error: PAM depth %d is not supported\n",
+                        depth);
+                exit(EXIT_FAILURE);
+        }
+        T pam = Pam_new(width, height, (unsigned)maxval, depth);
+        if (tupltype[0] != '\0') {
+                strcpy(pam->tupltype, tupltype);
+        }
+
+        size_t row_bytes = (size_t)width * depth * pam->bytes;
+        unsigned char *row = ALLOC((long)row_bytes);
+        for (int j = 0; j < height; j++) {
+                long k0 = (long)j * width;
+                if (depth == 4 && pam->bytes == 1) {
+                        if (fread(pam->samples + 4 * k0, 1, row_bytes, fp)
+                            != row_bytes) {
+                                fprintf(stderr, "Error: PAM image is "
+                                                "truncated\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        check_row(pam->samples + 4 * k0, 4L * width, 1,
+                                  (unsigned)maxval);
+                        continue;
+                }
+                if (fread(row, 1, row_bytes, fp) != row_bytes) {
+                        fprintf(stderr, "Error: PAM image is truncated\n");
+                        exit(EXIT_FAILURE);
+                }
+                check_row(row, (long)width * depth, pam->bytes,
+                          (unsigned)maxval);
+                const unsigned char *p = row;
+                for (int i = 0; i < width; i++) {
+                        unsigned v[4];
+                        for (int d = 0; d < depth; d++) {
+                                if (pam->bytes == 1) {
+                                        v[d] = *p++;
+                                } else {
+                                        v[d] = (unsigned)p[0] << 8 | p[1];
+                                        p += 2;
+                                }
+                        }
+                        bool color = depth >= 3;
+                        bool alpha = depth % 2 == 0;
+                        long k = k0 + i;
+                        set_sample(pam, k, 0, v[0]);
+                        set_sample(pam, k, 1, color ? v[1] : v[0]);
+                        set_sample(pam, k, 2, color ? v[2] : v[0]);
+                        set_sample(pam, k, 3, alpha ? v[depth - 1]
+                                                    : (unsigned)maxval);
+                }
+        }
+        FREE(row);
+        return pam;
+}
+
+/* writes pam as a P7 of its depth and tuple type */
+void Pam_write(FILE *fp, T pam)
+{
+        assert(fp != NULL && pam != NULL);
+        static const int channels[4][4] = {
+                { 0 }, { 0, 3 }, { 0, 1, 2 }, { 0, 1, 2, 3 }
+        };
+        const int *channel = channels[pam->depth - 1];
+        size_t row_bytes = (size_t)pam->width * pam->depth * pam->bytes;
+        unsigned char *row = ALLOC((long)row_bytes);
+        fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL %u\n"
+                    "TUPLTYPE %s\nENDHDR\n", pam->width, pam->height,
+                pam->depth, pam->maxval, pam->tupltype);
+        for (int j = 0; j < pam->height; j++) {
+                long k0 = (long)j * pam->width;
+                const unsigned char *out = row;
+                if (pam->depth == 4 && pam->bytes == 1) {
+                        out = pam->samples + 4 * k0;
+                } else {
+                        unsigned char *p = row;
+                        for (int i = 0; i < pam->width; i++) {
+                                for (int d = 0; d < pam->depth; d++) {
+                                        unsigned v = sample(pam, k0 + i,
+                                                            channel[d]);
+                                        if (pam->bytes == 2) {
+                                                *p++ = v >> 8;
+                                        }
+                                        *p++ = v & 0xff;
+                                }
+                        }
+                }
+                if (fwrite(out, 1, row_bytes, fp) != row_bytes) {
+                        fprintf(stderr, "Error: cannot write image\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        FREE(row);
+}
+
+/* moves the pixels of a rectangle of the original, one loop for each
+   pixel size */
+MOVETILE_DEFINE(move_pixels32, uint32_t)
+MOVETILE_DEFINE(move_pixels64, uint64_t)
+
+static void move_pixels(const struct job *job, int x0, int y0, int x1,
+                        int y1)
+{
+        T source = job->source, dest = job->dest;
+        Transform_position *position = job->transform->position;
+        if (x0 >= x1 || y0 >= y1) {
+                return;
+        }
+        if (source->bytes == 1) {
+                move_pixels32(position, source->samples, source->width,
+                              source->height, dest->samples, dest->width,
+                              x0, y0, x1, y1);
+        } else {
+                move_pixels64(position, source->samples, source->width,
+                              source->height, dest->samples, dest->width,
+                              x0, y0, x1, y1);
+        }
+}
+
+#if defined(__SSE2__)
+/* a tile of an operation that swaps dimensions, 32-bit pixels: each 4x4
+   block of the original is transposed in registers, its columns becoming
+   runs of 4 pixels in the new image, reversed when the operation runs the
+   original's rows backwards; the edges past the last whole block go one
+   pixel at a time */
+static void transpose_tile(const struct job *job, int x0, int y0, int x1,
+                           int y1)
+{
+        T source = job->source, dest = job->dest;
+        Transform_position *position = job->transform->position;
+        int w = source->width, h = source->height;
+        int di, dj, ni, nj, mi, mj;
+        position(x0, y0, w, h, &di, &dj);
+        position(x0 + 1, y0, w, h, &ni, &nj);
+        position(x0, y0 + 1, w, h, &mi, &mj);
+        long at0 = (long)dj * dest->width + di;
+        long step_i = (long)(nj - dj) * dest->width + (ni - di);
+        long step_j = (long)(mj - dj) * dest->width + (mi - di);
+        int x4 = x0 + (x1 - x0) / 4 * 4;
+        int y4 = y0 + (y1 - y0) / 4 * 4;
+        const uint32_t *from = (const uint32_t *)(const void *)source->samples;
+        uint32_t *to = (uint32_t *)(void *)dest->samples;
+
+        for (int j = y0; j < y4; j += 4) {
+                const uint32_t *row = from + (long)j * w;
+                for (int i = x0; i < x4; i += 4) {
+                        __m128i r0 = _mm_loadu_si128((const __m128i *)
+                                                     (const void *)(row + i));
+                        __m128i r1 = _mm_loadu_si128((const __m128i *)
+                                                     (const void *)
+                                                     (row + w + i));
+                        __m128i r2 = _mm_loadu_si128((const __m128i *)
+                                                     (const void *)
+                                                     (row + 2 * w + i));
+                        __m128i r3 = _mm_loadu_si128((const __m128i *)
+                                                     (const void *)
+                                                     (row + 3 * w + i));
+                        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+                        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+                        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+                        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+                        __m128i column[4] = {
+                                _mm_unpacklo_epi64(t0, t1),
+                                _mm_unpackhi_epi64(t0, t1),
+                                _mm_unpacklo_epi64(t2, t3),
+                                _mm_unpackhi_epi64(t2, t3)
+                        };
+                        long at = at0 + (i - x0) * step_i + (j - y0) * step_j;
+                        for (int k = 0; k < 4; k++) {
+                                __m128i v = column[k];
+                                long start = at + k * step_i;
+                                if (step_j < 0) {
+                                        v = _mm_shuffle_epi32(
+                                                v, _MM_SHUFFLE(0, 1, 2, 3));
+                                        start -= 3;
+                                }
+                                _mm_storeu_si128((__m128i *)(void *)
+                                                 (to + start), v);
+                        }
+                }
+        }
+        move_pixels(job, x4, y0, x1, y1);
+        move_pixels(job, x0, y4, x4, y1);
+}
+#endif
+
+#if defined(__SSE2__)
+/* the four samples of the k-th pixel as floats */
+static inline __m128 load_pixel(T pam, long k)
+{
+        __m128i zero = _mm_setzero_si128();
+        __m128i v;
+        if (pam->bytes == 1) {
+                int word;
+                memcpy(&word, pam->samples + 4 * k, sizeof(word));
+                v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero);
+        } else {
+                v = _mm_loadl_epi64((const __m128i *)(const void *)
+                                    (pam->samples + 8 * k));
+        }
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+}
+#endif
+
+/*
+ * Name: over
+ *
+ * Description: composites the k-th pixel of image over the same pixel of
+ * background, in place
+ *
+ * Parameters:
+ *           T image: the moved image
+ *           T background: of the same size and maxval
+ *           long k: the pixel, in row order
+ *           bool alpha: whether the result keeps an alpha; if not, it is
+ *           opaque
+ *
+ * Returns: nothing
+ *
+ * Expects: k lies within both images
+ *
+ * Notes: with straight alpha as and ab in [0, 1], the result has alpha
+ * ao = as + ab (1 - as) and colors (cs as + cb ab (1 - as)) / ao, rounded;
+ * all four samples are computed at once with SSE2, and one at a time in
+ * the same float steps without it, so both give the same pixels
+ */
+static inline void over(T image, T background, long k, bool alpha)
+{
+        unsigned alpha_s = sample(image, k, 3);
+        if (alpha_s == image->maxval) {
+                return;         /* opaque: ao is 1 and the colors are cs */
+        }
+        float maxval = (float)image->maxval;
+        float as = (float)alpha_s / maxval;
+        float ab = (float)sample(background, k, 3) / maxval;
+        float wb = ab * (1.0f - as);
+        float ao = as + wb;
+        int out[4] = { 0, 0, 0, 0 };
+        if (ao > 0.0f) {
+#if defined(__SSE2__)
+                __m128 s = load_pixel(image, k);
+                __m128 b = load_pixel(background, k);
+                __m128 v = _mm_div_ps(_mm_add_ps(_mm_mul_ps(s,
+                                                            _mm_set1_ps(as)),
+                                                 _mm_mul_ps(b,
+                                                            _mm_set1_ps(wb))),
+                                      _mm_set1_ps(ao));
+                v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()),
+                               _mm_set1_ps(maxval));
+                _mm_storeu_si128((__m128i *)(void *)out,
+                                 _mm_cvttps_epi32(_mm_add_ps(
+                                         v, _mm_set1_ps(0.5f))));
+#else
+                for (int c = 0; c < 3; c++) {
+                        float v = ((float)sample(image, k, c) * as +
+                                   (float)sample(background, k, c) * wb) /
+                                  ao;
+                        v = v < 0 ? 0 : v > maxval ? maxval : v;
+                        out[c] = (int)(v + 0.5f);
+                }
+#endif
+        }
+        out[3] = alpha ? (int)(ao * maxval + 0.5f) : (int)image->maxval;
+        for (int c = 0; c < 4; c++) {
+                set_sample(image, k, c, (unsigned)out[c]);
+        }
+}
+
+/* composites the part of the new image that the tile (x0, y0)-(x1, y1)
+   of the original moved to over the background */
+static void over_tile(const struct job *job, int x0, int y0, int x1, int y1)
+{
+        T source = job->source, dest = job->dest;
+        Transform_position *position = job->transform->position;
+        int ai, aj, bi, bj;
+        position(x0, y0, source->width, source->height, &ai, &aj);
+        position(x1 - 1, y1 - 1, source->width, source->height, &bi, &bj);
+        int left = ai < bi ? ai : bi, right = ai < bi ? bi : ai;
+        int top = aj < bj ? aj : bj, bottom = aj < bj ? bj : aj;
+        bool alpha = dest->depth % 2 == 0;
+        for (int j = top; j <= bottom; j++) {
+                long k = (long)j * dest->width;
+                for (int i = left; i <= right; i++) {
+                        over(dest, job->background, k + i, alpha);
+                }
+        }
+}
+
+static void move_tile(int index, void *cl)
+{
+        const struct job *job = cl;
+        T source = job->source;
+        int x0 = index % job->tiles_across * TILE;
+        int y0 = index / job->tiles_across * TILE;
+        int x1 = x0 + TILE < source->width ? x0 + TILE : source->width;
+        int y1 = y0 + TILE < source->height ? y0 + TILE : source->height;
+
+        TRACE_BEGIN_XY("tile", "pam", x0, y0);
+#if defined(__SSE2__)
+        if (source->bytes == 1 && job->transform->swaps_dimensions) {
+                transpose_tile(job, x0, y0, x1, y1);
+        } else {
+                move_pixels(job, x0, y0, x1, y1);
+        }
+#else
+        move_pixels(job, x0, y0, x1, y1);
+#endif
+        if (job->background != NULL) {
+                over_tile(job, x0, y0, x1, y1);
+        }
+        TRACE_END("tile", "pam");
+}
+
+/*
+ * Name: Pam_transform
+ *
+ * Description: makes the image that the exact operation transform turns
+ * pam into, composited over background if one is given
+ *
+ * Parameters:
+ *           T pam: the original
+ *           const Transform *transform: one of Transform_table
+ *           T background: the image to composite over, of the new image's
+ *           size and pam's maxval, or NULL
+ *
+ * Returns: the new image, to be freed with Pam_free. Without a background
+ * it has pam's depth and tuple type; with one it is RGB when either image
+ * is, and keeps an alpha only when both have one
+ *
+ * Expects: pam and transform are not NULL
+ *
+ * Notes: exits with an error message if background does not fit. The work
+ * is spread over Parallel_threads() threads by 64x64 tiles of the
+ * original, each composited as soon as it is moved, while it is in cache
+ */
+T Pam_transform(T pam, const Transform *transform, T background)
+{
+        assert(pam != NULL && transform != NULL);
+        int width = transform->swaps_dimensions ? pam->height : pam->width;
+        int height = transform->swaps_dimensions ? pam->width : pam->height;
+        struct job job;
+        job.source = pam;
+        job.background = background;
+        job.transform = transform;
+        if (background == NULL) {
+                job.dest = Pam_new(width, height, pam->maxval, pam->depth);
+                strcpy(job.dest->tupltype, pam->tupltype);
+        } else {
+                if (background->width != width ||
+                    background->height != height ||
+                    background->maxval != pam->maxval) {
+                        fprintf(stderr, "Error: the background must be "
+                                        "%dx%d with maxval %u\n", width,
+                                height, pam->maxval);
+                        exit(EXIT_FAILURE);
+                }
+                bool color = pam->depth >= 3 || background->depth >= 3;
+                bool alpha = pam->depth % 2 == 0 &&
+                             background->depth % 2 == 0;
+                job.dest = Pam_new(width, height, pam->maxval,
+                                   (color ? 3 : 1) + (alpha ? 1 : 0));
+        }
+        job.tiles_across = (pam->width + TILE - 1) / TILE;
+        int tiles_down = (pam->height + TILE - 1) / TILE;
+        Parallel_for(job.tiles_across * tiles_down, move_tile, &job);
+        return job.dest;
+}
+
+/* pam's colors as Pnm_rgb pixels, for every other operation; alpha is
+   dropped */
+A2Methods_UArray2 Pam_pixels(T pam, A2Methods_T methods)
+{
+        assert(pam != NULL && methods != NULL);
+        A2Methods_UArray2 array2 = methods->new(pam->width, pam->height,
+                                                sizeof(struct Pnm_rgb));
+        struct A2Pixels pixels;
+        A2Pixels_open(&pixels, methods, array2);
+        for (int j = 0; j < pam->height; j++) {
+                long k = (long)j * pam->width;
+                for (int i = 0; i < pam->width; i++) {
+                        struct Pnm_rgb *p = A2Pixels_at(&pixels, i, j);
+                        p->red   = sample(pam, k + i, 0);
+                        p->green = sample(pam, k + i, 1);
+                        p->blue  = sample(pam, k + i, 2);
+                }
+        }
+        A2Pixels_close(&pixels);
+        return array2;
+}
@@ -0,0 +1,56 @@
+#ifndef PAM_INCLUDED
+#define PAM_INCLUDED
+/****************************************************************
+ *
+ *                         pam.h
+ *
+ *       Interface to type Pam_T, a PAM (P7) image of tuple type
+ *       GRAYSCALE, GRAYSCALE_ALPHA, RGB or RGB_ALPHA, stored with
+ *       every pixel widened to red, green, blue and alpha samples:
+ *       four bytes, so one 32-bit word, when maxval < 256, or four
+ *       16-bit samples otherwise. A gray sample goes to all three
+ *       colors, and a pixel without alpha is opaque (alpha maxval),
+ *       so RGB is padded to the same aligned words. Writing gives
+ *       back the tuple type read.
+ *
+ *       Usage:
+ *
+ *       PnmIO_magic(fp) read, then:
+ *       Pam_T pam = Pam_read(fp);
+ *       Pam_T rotated = Pam_transform(pam, transform, NULL);
+ *       Pam_write(stdout, rotated);
+ *
+ *       The exact operations of transform.h move 64x64 tiles as whole
+ *       pixels; with SSE2, transposing and rotating by 90 or 270 moves
+ *       32-bit pixels through 4x4 register transposes. Given a
+ *       background of the new image's size and maxval,
+ *       Pam_transform composites the moved image over it ("over", with
+ *       straight alpha) tile by tile as each tile lands, with all four
+ *       samples of a pixel in one SSE2 register. Tiles are spread over
+ *       threads (see parallel.h).
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "a2methods.h"
+#include "transform.h"
+
+typedef struct Pam *Pam_T;
+
+extern Pam_T Pam_new(int width, int height, unsigned maxval, int depth);
+extern Pam_T Pam_read(FILE *fp);
+extern void  Pam_write(FILE *fp, Pam_T pam);
+extern void  Pam_free(Pam_T *pam);
+
+extern int      Pam_width(Pam_T pam);
+extern int      Pam_height(Pam_T pam);
+extern unsigned Pam_maxval(Pam_T pam);
+extern int      Pam_depth(Pam_T pam);
+extern unsigned Pam_get(Pam_T pam, int i, int j, int channel);
+
+extern Pam_T Pam_transform(Pam_T pam, const Transform *transform,
+                           Pam_T background);
+extern A2Methods_UArray2 Pam_pixels(Pam_T pam, A2Methods_T methods);
+
+#endif
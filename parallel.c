@@ -0,0 +1,98 @@
+/*
+ *     parallel.c
+ *     Locality
+ *
+ *     Implementation of the parallel loop in parallel.h. The caller and
+ *     Parallel_threads() - 1 POSIX threads take the next index from a
+ *     shared counter until it runs past the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "assert.h"
+#include "mem.h"
+#include "parallel.h"
+
+/* 0 until set: one thread per online CPU */
+static int threads = 0;
+
+struct loop {
+        int count;
+        int next;               /* next index to hand out */
+        Parallel_fn *fn;
+        void *cl;
+};
+
+void Parallel_set_threads(int n)
+{
+        assert(n >= 0);
+        threads = n;
+}
+
+int Parallel_threads(void)
+{
+        if (threads > 0) {
+                return threads;
+        }
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        return online > 0 ? (int)online : 1;
+}
+
+static void *run(void *vloop)
+{
+        struct loop *loop = vloop;
+        for (;;) {
+                int index = __sync_fetch_and_add(&loop->next, 1);
+                if (index >= loop->count) {
+                        return NULL;
+                }
+                loop->fn(index, loop->cl);
+        }
+}
+
+/*
+ * Name: Parallel_for
+ *
+ * Description: calls fn(index, cl) for every index in [0, count), spread
+ * over up to Parallel_threads() threads
+ *
+ * Parameters:
+ *           int count: the number of items
+ *           Parallel_fn fn: the function doing one item
+ *           void *cl: passed to every call of fn
+ *
+ * Returns: nothing, once every item is done
+ *
+ * Expects: count >= 0 and fn not NULL; fn must be safe to call from
+ * several threads at once on different indices
+ *
+ * Notes: runs everything in the calling thread when there is one thread
+ * or one item, or when no thread can be created
+ */
+void Parallel_for(int count, Parallel_fn fn, void *cl)
+{
+        assert(count >= 0 && fn != NULL);
+        struct loop loop = { count, 0, fn, cl };
+        int workers = Parallel_threads() - 1;
+        if (workers > count - 1) {
+                workers = count - 1;
+        }
+        if (workers <= 0) {
+                run(&loop);
+                return;
+        }
+
+        pthread_t *ids = ALLOC((long)workers * sizeof(*ids));
+        int started = 0;
+        while (started < workers &&
+               pthread_create(&ids[started], NULL, run, &loop) == 0) {
+                started++;
+        }
+        run(&loop);
+        for (int t = 0; t < started; t++) {
+                pthread_join(ids[t], NULL);
+        }
+        FREE(ids);
+}
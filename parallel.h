@@ -0,0 +1,28 @@
+#ifndef PARALLEL_INCLUDED
+#define PARALLEL_INCLUDED
+/****************************************************************
+ *
+ *                         parallel.h
+ *
+ *       A parallel loop over independent work items, such as the
+ *       tiles of an image. Parallel_for calls fn(index, cl) once for
+ *       every index in [0, count), from up to Parallel_threads()
+ *       threads including the caller, and returns when all of them
+ *       are done. Items are handed out in increasing order, one at a
+ *       time, so a slow item does not hold up the others; the order
+ *       in which they finish is unspecified.
+ *
+ *       The thread count is global. It defaults to the number of
+ *       online CPUs; Parallel_set_threads(1) runs every loop in the
+ *       calling thread. Workers are created per loop, so items
+ *       should be large (a tile, a band of rows), not single pixels.
+ *
+ *****************************************************************/
+
+typedef void Parallel_fn(int index, void *cl);
+
+extern void Parallel_set_threads(int threads);
+extern int  Parallel_threads(void);
+extern void Parallel_for(int count, Parallel_fn fn, void *cl);
+
+#endif
@@ -0,0 +1,118 @@
+/****************************************************************
+ *
+ *                         phasetimer.c
+ *
+ *       This source file implements the type PhaseTimer_T, which
+ *       times a sequence of named, non-nested phases by wall clock,
+ *       main-thread CPU time and process CPU time. See
+ *       phasetimer.h for usage.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <time.h>
+#include "assert.h"
+#include "phasetimer.h"
+
+/* one timed phase: its name, start readings and measured durations */
+struct phase {
+        const char     *name;
+        struct timespec wall_start, thread_start, process_start;
+        double          wall, thread_cpu, process_cpu;
+};
+
+struct PhaseTimer {
+        int          length;    /* phases started so far */
+        int          open;      /* 1 while the last phase is running */
+        struct phase phases[PHASETIMER_MAX_PHASES];
+};
+
+static double elapsed(struct timespec *start, struct timespec *stop)
+{
+        return (double)(stop->tv_sec - start->tv_sec) * 1000000000
+                + (stop->tv_nsec - start->tv_nsec);
+}
+
+PhaseTimer_T PhaseTimer_New(void)
+{
+        PhaseTimer_T timer = malloc(sizeof(*timer));
+        assert(timer != NULL);
+        timer->length = 0;
+        timer->open   = 0;
+        return timer;
+}
+
+void PhaseTimer_Free(PhaseTimer_T *timerp)
+{
+        assert(timerp != NULL && *timerp != NULL);
+        free(*timerp);
+        *timerp = NULL;
+}
+
+/*
+ *  PhaseTimer_Start
+ *
+ *  Begins a new phase. The name is not copied, so it must outlive the
+ *  timer (string literals are the usual case).
+ */
+void PhaseTimer_Start(PhaseTimer_T timer, const char *name)
+{
+        assert(timer != NULL && name != NULL);
+        assert(!timer->open);
+        assert(timer->length < PHASETIMER_MAX_PHASES);
+
+        struct phase *p = &timer->phases[timer->length++];
+        p->name = name;
+        p->wall = p->thread_cpu = p->process_cpu = 0;
+        timer->open = 1;
+
+        /* wall clock last, so it brackets the other readings */
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &p->process_start);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &p->thread_start);
+        clock_gettime(CLOCK_MONOTONIC, &p->wall_start);
+}
+
+void PhaseTimer_Stop(PhaseTimer_T timer)
+{
+        struct timespec wall, thread, process;
+        clock_gettime(CLOCK_MONOTONIC, &wall);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &process);
+
+        assert(timer != NULL && timer->open);
+        struct phase *p = &timer->phases[timer->length - 1];
+        p->wall        = elapsed(&p->wall_start, &wall);
+        p->thread_cpu  = elapsed(&p->thread_start, &thread);
+        p->process_cpu = elapsed(&p->process_start, &process);
+        timer->open = 0;
+}
+
+int PhaseTimer_Length(PhaseTimer_T timer)
+{
+        assert(timer != NULL);
+        return timer->length;
+}
+
+const char *PhaseTimer_Name(PhaseTimer_T timer, int phase)
+{
+        assert(timer != NULL && phase >= 0 && phase < timer->length);
+        return timer->phases[phase].name;
+}
+
+double PhaseTimer_Wall(PhaseTimer_T timer, int phase)
+{
+        assert(timer != NULL && phase >= 0 && phase < timer->length);
+        return timer->phases[phase].wall;
+}
+
+double PhaseTimer_ThreadCPU(PhaseTimer_T timer, int phase)
+{
+        assert(timer != NULL && phase >= 0 && phase < timer->length);
+        return timer->phases[phase].thread_cpu;
+}
+
+double PhaseTimer_ProcessCPU(PhaseTimer_T timer, int phase)
+{
+        assert(timer != NULL && phase >= 0 && phase < timer->length);
+        return timer->phases[phase].process_cpu;
+}
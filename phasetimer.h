@@ -0,0 +1,57 @@
+#ifndef PHASETIMER_INCLUDED
+#define PHASETIMER_INCLUDED
+/****************************************************************
+ *
+ *                         phasetimer.h
+ *
+ *       Interface to type PhaseTimer_T, which times a sequence of
+ *       named phases of a program (read, transform, write, ...).
+ *
+ *       Every phase records three clocks:
+ *         wall-clock time (CLOCK_MONOTONIC), which is the latency
+ *           the user sees even when several threads are working;
+ *         the CPU time of the calling (main) thread alone
+ *           (CLOCK_THREAD_CPUTIME_ID), none of its workers';
+ *         the CPU time of the whole process (CLOCK_PROCESS_CPUTIME_ID),
+ *           which includes any worker threads.
+ *
+ *       Usage:
+ *
+ *       PhaseTimer_T phases = PhaseTimer_New();
+ *       PhaseTimer_Start(phases, "read");
+ *         ... Do work to be timed here
+ *       PhaseTimer_Stop(phases);
+ *       for (int i = 0; i < PhaseTimer_Length(phases); i++)
+ *               ... PhaseTimer_Wall(phases, i) ...
+ *       PhaseTimer_Free(&phases);
+ *
+ *       All times are nanoseconds stored in a double, as in cputiming.h.
+ *       Phases do not nest; starting a phase while another is open is a
+ *       checked runtime error, as is recording more than
+ *       PHASETIMER_MAX_PHASES phases.
+ *
+ *****************************************************************/
+
+#define PHASETIMER_MAX_PHASES 32
+
+typedef struct PhaseTimer *PhaseTimer_T;
+
+PhaseTimer_T PhaseTimer_New(void);
+
+void PhaseTimer_Free(PhaseTimer_T *timerp);
+
+void PhaseTimer_Start(PhaseTimer_T timer, const char *name);
+
+void PhaseTimer_Stop(PhaseTimer_T timer);
+
+int PhaseTimer_Length(PhaseTimer_T timer);
+
+const char *PhaseTimer_Name(PhaseTimer_T timer, int phase);
+
+double PhaseTimer_Wall(PhaseTimer_T timer, int phase);
+
+double PhaseTimer_ThreadCPU(PhaseTimer_T timer, int phase);
+
+double PhaseTimer_ProcessCPU(PhaseTimer_T timer, int phase);
+
+#endif
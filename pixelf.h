@@ -0,0 +1,91 @@
+#ifndef PIXELF_INCLUDED
+#define PIXELF_INCLUDED
+/****************************************************************
+ *
+ *                         pixelf.h
+ *
+ *       Pixelf, the three channels of a Pnm_rgb as floats, for
+ *       filters that compute each new pixel as a weighted sum of old
+ *       ones. With SSE2 a Pixelf is one __m128 (red, green, blue, 0),
+ *       so a weighted sum takes one multiply and one add per term for
+ *       all three channels; otherwise it is a struct of three floats.
+ *
+ *       Pixelf_load   a pixel's channels
+ *       Pixelf_madd   acc + weight * v
+ *       Pixelf_store  round to the nearest integers in [0, maxval]
+ *
+ *       Arrays of Pixelf need 16-byte alignment, which ALLOC gives.
+ *
+ *****************************************************************/
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "pnm.h"
+
+#if defined(__SSE2__)
+typedef __m128 Pixelf;
+
+static inline Pixelf Pixelf_zero(void)
+{
+        return _mm_setzero_ps();
+}
+
+static inline Pixelf Pixelf_load(const struct Pnm_rgb *p)
+{
+        return _mm_cvtepi32_ps(_mm_setr_epi32((int)p->red, (int)p->green,
+                                              (int)p->blue, 0));
+}
+
+static inline Pixelf Pixelf_madd(Pixelf acc, Pixelf v, float weight)
+{
+        return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(weight)));
+}
+
+static inline void Pixelf_store(struct Pnm_rgb *p, Pixelf v, float maxval)
+{
+        v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(maxval));
+        int out[4];
+        _mm_storeu_si128((__m128i *)out,
+                         _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f))));
+        p->red   = out[0];
+        p->green = out[1];
+        p->blue  = out[2];
+}
+#else
+typedef struct { float c[3]; } Pixelf;
+
+static inline Pixelf Pixelf_zero(void)
+{
+        Pixelf v = { { 0, 0, 0 } };
+        return v;
+}
+
+static inline Pixelf Pixelf_load(const struct Pnm_rgb *p)
+{
+        Pixelf v = { { p->red, p->green, p->blue } };
+        return v;
+}
+
+static inline Pixelf Pixelf_madd(Pixelf acc, Pixelf v, float weight)
+{
+        for (int k = 0; k < 3; k++) {
+                acc.c[k] += v.c[k] * weight;
+        }
+        return acc;
+}
+
+static inline void Pixelf_store(struct Pnm_rgb *p, Pixelf v, float maxval)
+{
+        unsigned out[3];
+        for (int k = 0; k < 3; k++) {
+                float c = v.c[k] < 0 ? 0 : v.c[k] > maxval ? maxval : v.c[k];
+                out[k] = (unsigned)(c + 0.5f);
+        }
+        p->red   = out[0];
+        p->green = out[1];
+        p->blue  = out[2];
+}
+#endif
+
+#endif
@@ -0,0 +1,374 @@
+/*
+ *     pixelops.c
+ *     Locality
+ *
+ *     Implementation of PixelOps_T (see pixelops.h): recording the chain,
+ *     compiling it into stages once maxval is known, and the pass that
+ *     runs it while moving pixels with an exact transform.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "trace.h"
+#include "pnm.h"
+#include "transform.h"
+#include "pixelops.h"
+
+#define T PixelOps_T
+
+/* tile side when the original is plain */
+#define TILE 64
+
+/* largest maxval of a PPM */
+#define MAX_MAXVAL 65535
+
+typedef enum {
+        GRAYSCALE, BRIGHTNESS, CONTRAST, GAMMA, CHANNELS, INVERT, RESCALE
+} Kind;
+
+/* one operation as added */
+struct PixelOps_op {
+        Kind kind;
+        double arg;
+        int order[3];           /* CHANNELS: new channel c is old order[c] */
+};
+
+/* the pass in progress, shared by every tile */
+struct job {
+        T ops;
+        struct A2Pixels src, dst;
+        Transform_position *position;
+        int tile;
+        int tiles_across;
+};
+
+T PixelOps_new(void)
+{
+        T ops;
+        NEW(ops);
+        ops->ops      = NULL;
+        ops->length   = 0;
+        ops->capacity = 0;
+        ops->stages   = NULL;
+        ops->nstages  = 0;
+        return ops;
+}
+
+static void free_stages(T ops)
+{
+        for (int s = 0; s < ops->nstages; s++) {
+                for (int c = 0; c < 3; c++) {
+                        if (ops->stages[s].table[c] != NULL) {
+                                FREE(ops->stages[s].table[c]);
+                        }
+                }
+        }
+        if (ops->stages != NULL) {
+                FREE(ops->stages);
+        }
+        ops->nstages = 0;
+}
+
+void PixelOps_free(T *ops)
+{
+        assert(ops != NULL && *ops != NULL);
+        free_stages(*ops);
+        if ((*ops)->ops != NULL) {
+                FREE((*ops)->ops);
+        }
+        FREE(*ops);
+}
+
+bool PixelOps_empty(T ops)
+{
+        assert(ops != NULL);
+        return ops->length == 0;
+}
+
+static struct PixelOps_op *add(T ops, Kind kind, double arg)
+{
+        assert(ops != NULL);
+        if (ops->length == ops->capacity) {
+                ops->capacity = ops->capacity == 0 ? 8 : 2 * ops->capacity;
+                if (ops->ops == NULL) {
+                        ops->ops = ALLOC((long)ops->capacity *
+                                         sizeof(*ops->ops));
+                } else {
+                        RESIZE(ops->ops, (long)ops->capacity *
+                                         sizeof(*ops->ops));
+                }
+        }
+        struct PixelOps_op *op = &ops->ops[ops->length++];
+        op->kind = kind;
+        op->arg  = arg;
+        for (int c = 0; c < 3; c++) {
+                op->order[c] = c;
+        }
+        return op;
+}
+
+void PixelOps_grayscale(T ops)
+{
+        add(ops, GRAYSCALE, 0);
+}
+
+/* amount is a fraction of maxval, negative to darken */
+void PixelOps_brightness(T ops, double amount)
+{
+        add(ops, BRIGHTNESS, amount);
+}
+
+/* factor > 1 spreads values away from maxval / 2, < 1 pulls them in */
+void PixelOps_contrast(T ops, double factor)
+{
+        assert(factor >= 0);
+        add(ops, CONTRAST, factor);
+}
+
+void PixelOps_gamma(T ops, double gamma)
+{
+        assert(gamma > 0);
+        add(ops, GAMMA, gamma);
+}
+
+/* order names the old channel each new one takes, a permutation of "rgb";
+   false, with nothing added, if it is not one */
+bool PixelOps_channels(T ops, const char *order)
+{
+        assert(ops != NULL && order != NULL);
+        static const char names[] = "rgb";
+        int picked[3];
+        bool seen[3] = { false, false, false };
+        if (strlen(order) != 3) {
+                return false;
+        }
+        for (int c = 0; c < 3; c++) {
+                const char *name = strchr(names, order[c]);
+                if (order[c] == '\0' || name == NULL || seen[name - names]) {
+                        return false;
+                }
+                picked[c] = name - names;
+                seen[picked[c]] = true;
+        }
+        struct PixelOps_op *op = add(ops, CHANNELS, 0);
+        for (int c = 0; c < 3; c++) {
+                op->order[c] = picked[c];
+        }
+        return true;
+}
+
+void PixelOps_invert(T ops)
+{
+        add(ops, INVERT, 0);
+}
+
+void PixelOps_rescale(T ops, unsigned maxval)
+{
+        assert(maxval > 0 && maxval <= MAX_MAXVAL);
+        add(ops, RESCALE, maxval);
+}
+
+/* a per-channel operation on value v when the largest value is maxval */
+static unsigned channel_op(const struct PixelOps_op *op, unsigned v,
+                           unsigned maxval)
+{
+        double x = v;
+        switch (op->kind) {
+        case BRIGHTNESS:
+                x = v + op->arg * maxval;
+                break;
+        case CONTRAST:
+                x = (v - maxval / 2.0) * op->arg + maxval / 2.0;
+                break;
+        case GAMMA:
+                x = maxval * pow((double)v / maxval, 1.0 / op->arg);
+                break;
+        case INVERT:
+                x = (double)maxval - v;
+                break;
+        case RESCALE:
+                x = (double)v * op->arg / maxval;
+                maxval = (unsigned)op->arg;
+                break;
+        default:
+                assert(0);
+        }
+        x = floor(x + 0.5);
+        return x < 0 ? 0 : x > maxval ? maxval : (unsigned)x;
+}
+
+/* a table stage that changes nothing, for values up to maxval */
+static struct PixelOps_stage *push_identity(T ops, int *capacity,
+                                            unsigned maxval)
+{
+        if (ops->nstages == *capacity) {
+                *capacity *= 2;
+                RESIZE(ops->stages, (long)*capacity * sizeof(*ops->stages));
+        }
+        struct PixelOps_stage *stage = &ops->stages[ops->nstages++];
+        stage->grayscale = false;
+        stage->maxval = maxval;
+        for (int c = 0; c < 3; c++) {
+                stage->from[c]  = c;
+                stage->table[c] = ALLOC(((long)maxval + 1) *
+                                        sizeof(*stage->table[c]));
+                for (unsigned v = 0; v <= maxval; v++) {
+                        stage->table[c][v] = v;
+                }
+        }
+        return stage;
+}
+
+/*
+ * Name: PixelOps_prepare
+ *
+ * Description: compiles the chain for images whose largest channel value
+ * is maxval
+ *
+ * Parameters:
+ *           T ops: the chain
+ *           unsigned maxval: the maxval of the images it will run on
+ *
+ * Returns: the maxval of the results, different from maxval only after
+ * PixelOps_rescale
+ *
+ * Expects: ops is not NULL, 0 < maxval <= 65535
+ *
+ * Notes: may be called again for another maxval
+ */
+unsigned PixelOps_prepare(T ops, unsigned maxval)
+{
+        assert(ops != NULL);
+        assert(maxval > 0 && maxval <= MAX_MAXVAL);
+        free_stages(ops);
+        int capacity = 4;
+        ops->stages = ALLOC((long)capacity * sizeof(*ops->stages));
+
+        /* the last stage, and the maxval going into it */
+        struct PixelOps_stage *stage = NULL;
+        unsigned stage_maxval = maxval;
+        for (int k = 0; k < ops->length; k++) {
+                const struct PixelOps_op *op = &ops->ops[k];
+                if (op->kind == GRAYSCALE) {
+                        if (ops->nstages == capacity) {
+                                capacity *= 2;
+                                RESIZE(ops->stages, (long)capacity *
+                                                    sizeof(*ops->stages));
+                        }
+                        stage = &ops->stages[ops->nstages++];
+                        stage->grayscale = true;
+                        stage->maxval = maxval;
+                        for (int c = 0; c < 3; c++) {
+                                stage->from[c]  = c;
+                                stage->table[c] = NULL;
+                        }
+                        stage_maxval = maxval;
+                        continue;
+                }
+                if (stage == NULL || stage->grayscale) {
+                        stage = push_identity(ops, &capacity, maxval);
+                        stage_maxval = maxval;
+                }
+                if (op->kind == CHANNELS) {
+                        /* new channel c is old channel order[c] */
+                        int from[3];
+                        unsigned *table[3];
+                        for (int c = 0; c < 3; c++) {
+                                from[c]  = stage->from[op->order[c]];
+                                table[c] = stage->table[op->order[c]];
+                        }
+                        for (int c = 0; c < 3; c++) {
+                                stage->from[c]  = from[c];
+                                stage->table[c] = table[c];
+                        }
+                        continue;
+                }
+                for (int c = 0; c < 3; c++) {
+                        for (unsigned v = 0; v <= stage_maxval; v++) {
+                                stage->table[c][v] =
+                                        channel_op(op, stage->table[c][v],
+                                                   maxval);
+                        }
+                }
+                if (op->kind == RESCALE) {
+                        maxval = (unsigned)op->arg;
+                }
+        }
+        return maxval;
+}
+
+static void map_tile(int index, void *cl)
+{
+        const struct job *job = cl;
+        const struct A2Pixels *src = &job->src;
+        int x0 = index % job->tiles_across * job->tile;
+        int y0 = index / job->tiles_across * job->tile;
+        int x1 = x0 + job->tile < src->width ? x0 + job->tile : src->width;
+        int y1 = y0 + job->tile < src->height ? y0 + job->tile : src->height;
+
+        TRACE_BEGIN_XY("tile", "pixelops", x0, y0);
+        for (int j = y0; j < y1; j++) {
+                /* every operation is affine, so two pixels give the row */
+                int di, dj, ni, nj;
+                job->position(x0, j, src->width, src->height, &di, &dj);
+                job->position(x0 + 1, j, src->width, src->height, &ni, &nj);
+                int step_i = ni - di, step_j = nj - dj;
+                for (int i = x0; i < x1; i++) {
+                        struct Pnm_rgb pixel = *A2Pixels_at(src, i, j);
+                        PixelOps_apply(job->ops, &pixel);
+                        *A2Pixels_at(&job->dst, di, dj) = pixel;
+                        di += step_i;
+                        dj += step_j;
+                }
+        }
+        TRACE_END("tile", "pixelops");
+}
+
+/*
+ * Name: PixelOps_map
+ *
+ * Description: fills dest with the pixels of source run through the chain
+ * and moved by transform, reading and writing each pixel once
+ *
+ * Parameters:
+ *           T ops: the prepared chain
+ *           const Transform *transform: the exact operation
+ *           A2Methods_T methods: the methods of both images
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           A2Methods_UArray2 dest: an image from Transform_new_image
+ *
+ * Returns: nothing
+ *
+ * Expects: no NULL argument; PixelOps_prepare was called with the maxval
+ * of source
+ *
+ * Notes: source is walked a block (or 64x64 tile of a plain image) at a
+ * time, tiles spread over Parallel_threads() threads
+ */
+void PixelOps_map(T ops, const Transform *transform, A2Methods_T methods,
+                  A2Methods_UArray2 source, A2Methods_UArray2 dest)
+{
+        assert(ops != NULL && transform != NULL && methods != NULL);
+        assert(source != NULL && dest != NULL);
+        struct job job;
+        job.ops = ops;
+        job.position = transform->position;
+        A2Pixels_open(&job.src, methods, source);
+        A2Pixels_open(&job.dst, methods, dest);
+
+        job.tile = methods->blocksize(source) > 1 ? methods->blocksize(source)
+                                                  : TILE;
+        job.tiles_across = (job.src.width + job.tile - 1) / job.tile;
+        int tiles_down = (job.src.height + job.tile - 1) / job.tile;
+        Parallel_for(job.tiles_across * tiles_down, map_tile, &job);
+
+        A2Pixels_close(&job.src);
+        A2Pixels_close(&job.dst);
+}
@@ -0,0 +1,109 @@
+#ifndef PIXELOPS_INCLUDED
+#define PIXELOPS_INCLUDED
+/****************************************************************
+ *
+ *                         pixelops.h
+ *
+ *       Interface to type PixelOps_T, a chain of per-pixel operations
+ *       applied in the order they are added:
+ *
+ *         PixelOps_grayscale   every channel becomes the luma
+ *                              (0.299 R + 0.587 G + 0.114 B)
+ *         PixelOps_brightness  adds amount * maxval
+ *         PixelOps_contrast    scales the distance from maxval / 2
+ *         PixelOps_gamma       maxval * (v / maxval) ^ (1 / gamma)
+ *         PixelOps_channels    reorders the channels, "bgr" say
+ *         PixelOps_invert      maxval - v
+ *         PixelOps_rescale     changes maxval, scaling every value
+ *
+ *       Results are rounded and clamped to [0, maxval] after every
+ *       operation, so a chain gives what running the operations one
+ *       after another would. The chain is only recorded until
+ *       PixelOps_prepare learns the image's maxval and compiles it:
+ *       every run of operations that treat channels separately,
+ *       reordering included, becomes one table lookup per channel, so
+ *       any number of them costs three lookups per pixel. Only
+ *       grayscale, which mixes channels, starts a new stage.
+ *
+ *       Usage:
+ *
+ *       PixelOps_T ops = PixelOps_new();
+ *       PixelOps_gamma(ops, 2.2);
+ *       PixelOps_invert(ops);
+ *       image->denominator = PixelOps_prepare(ops, image->denominator);
+ *       PixelOps_map(ops, transform, methods, source, dest);
+ *       PixelOps_free(&ops);
+ *
+ *       PixelOps_map fuses the chain with one of the exact operations
+ *       of transform.h: each pixel is read, operated on and stored at
+ *       its new position in one pass. Other passes that make new pixels
+ *       (resize.h, rotate.h) call PixelOps_apply as they store them.
+ *       The fields of struct PixelOps are private to pixelops.c.
+ *
+ *****************************************************************/
+
+#include <stdbool.h>
+#include "a2methods.h"
+#include "pnm.h"
+#include "transform.h"
+
+typedef struct PixelOps *PixelOps_T;
+
+/* one compiled stage: out[c] = table[c][in[from[c]]], or the luma; in
+   values above maxval, the tables' last index, are taken as maxval */
+struct PixelOps_stage {
+        bool grayscale;
+        unsigned maxval;
+        int from[3];
+        unsigned *table[3];
+};
+
+struct PixelOps {
+        struct PixelOps_op *ops;        /* as added */
+        int length, capacity;
+        struct PixelOps_stage *stages;  /* after PixelOps_prepare */
+        int nstages;
+};
+
+extern PixelOps_T PixelOps_new(void);
+extern void       PixelOps_free(PixelOps_T *ops);
+extern bool       PixelOps_empty(PixelOps_T ops);
+
+extern void PixelOps_grayscale(PixelOps_T ops);
+extern void PixelOps_brightness(PixelOps_T ops, double amount);
+extern void PixelOps_contrast(PixelOps_T ops, double factor);
+extern void PixelOps_gamma(PixelOps_T ops, double gamma);
+extern bool PixelOps_channels(PixelOps_T ops, const char *order);
+extern void PixelOps_invert(PixelOps_T ops);
+extern void PixelOps_rescale(PixelOps_T ops, unsigned maxval);
+
+extern unsigned PixelOps_prepare(PixelOps_T ops, unsigned maxval);
+extern void     PixelOps_map(PixelOps_T ops, const Transform *transform,
+                             A2Methods_T methods, A2Methods_UArray2 source,
+                             A2Methods_UArray2 dest);
+
+/* runs the prepared chain on one pixel, in place; a channel above the
+   maxval given to PixelOps_prepare counts as that maxval */
+static inline void PixelOps_apply(PixelOps_T ops, struct Pnm_rgb *pixel)
+{
+        for (int s = 0; s < ops->nstages; s++) {
+                const struct PixelOps_stage *stage = &ops->stages[s];
+                unsigned in[3] = { pixel->red, pixel->green, pixel->blue };
+                for (int c = 0; c < 3; c++) {
+                        if (in[c] > stage->maxval) {
+                                in[c] = stage->maxval;
+                        }
+                }
+                if (stage->grayscale) {
+                        unsigned luma = (299 * in[0] + 587 * in[1] +
+                                         114 * in[2] + 500) / 1000;
+                        pixel->red = pixel->green = pixel->blue = luma;
+                } else {
+                        pixel->red   = stage->table[0][in[stage->from[0]]];
+                        pixel->green = stage->table[1][in[stage->from[1]]];
+                        pixel->blue  = stage->table[2][in[stage->from[2]]];
+                }
+        }
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ *     pnmio.c
+ *     Locality
+ *
+ *     Implementation of the shared Netpbm header reading (see pnmio.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "assert.h"
+#include "pnmio.h"
+
+static void bad_header(void)
+{
+        fprintf(stderr, "Error: not a Netpbm image\n");
+        exit(EXIT_FAILURE);
+}
+
+/*
+ * Name: PnmIO_peek
+ *
+ * Description: tells the format of the image at the start of fp, leaving
+ * fp where it was
+ *
+ * Parameters:
+ *           FILE *fp: the open stream, before the magic number
+ *
+ * Returns: the format, plain or raw alike, or PnmIO_UNKNOWN
+ *
+ * Expects: fp is not NULL
+ *
+ * Notes: a seekable stream is rewound; a pipe gets both characters pushed
+ * back, which the C library allows since both came from the buffer it
+ * just filled
+ */
+PnmIO_Format PnmIO_peek(FILE *fp)
+{
+        assert(fp != NULL);
+        long start = ftell(fp);
+        int p = getc(fp);
+        int digit = p == 'P' ? getc(fp) : EOF;
+        if (start >= 0 && fseek(fp, start, SEEK_SET) == 0) {
+                clearerr(fp);
+        } else {
+                if (digit != EOF) {
+                        ungetc(digit, fp);
+                }
+                if (p != EOF) {
+                        ungetc(p, fp);
+                }
+        }
+        switch (digit) {
+        case '1': case '4':
+                return PnmIO_PBM;
+        case '2': case '5':
+                return PnmIO_PGM;
+        case '3': case '6':
+                return PnmIO_PPM;
+        case '7':
+                return PnmIO_PAM;
+        default:
+                return PnmIO_UNKNOWN;
+        }
+}
+
+/* reads the magic number, returning its digit ('1' for P1 ...) */
+int PnmIO_magic(FILE *fp)
+{
+        assert(fp != NULL);
+        int p = getc(fp);
+        int digit = getc(fp);
+        if (p != 'P' || digit < '1' || digit > '7') {
+                bad_header();
+        }
+        return digit;
+}
+
+/* reads the next header number, after any white space and comments; the
+   single white space character after it is consumed too */
+int PnmIO_number(FILE *fp)
+{
+        assert(fp != NULL);
+        int c = getc(fp);
+        while (isspace(c) || c == '#') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(fp);
+                        }
+                }
+                c = getc(fp);
+        }
+        if (!isdigit(c)) {
+                bad_header();
+        }
+        long n = 0;
+        while (isdigit(c)) {
+                n = 10 * n + (c - '0');
+                if (n > 0x7fffffffL) {
+                        bad_header();
+                }
+                c = getc(fp);
+        }
+        if (c != EOF && !isspace(c)) {
+                bad_header();
+        }
+        return (int)n;
+}
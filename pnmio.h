@@ -0,0 +1,34 @@
+#ifndef PNMIO_INCLUDED
+#define PNMIO_INCLUDED
+/****************************************************************
+ *
+ *                         pnmio.h
+ *
+ *       The parts of reading a Netpbm file shared by the formats
+ *       read outside pnm.h (see bitmap.h, graymap.h and pam.h):
+ *       telling the format of a stream from its magic number without
+ *       consuming it, so that a PPM can still go to Pnm_ppmread, and
+ *       reading the numbers of a header, which may be separated by any
+ *       white space and comments running from '#' to the end of the
+ *       line.
+ *
+ *       Usage:
+ *
+ *       if (PnmIO_peek(fp) == PnmIO_PGM) {
+ *               PnmIO_magic(fp);
+ *               int width = PnmIO_number(fp); ...
+ *       }
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+
+typedef enum {
+        PnmIO_UNKNOWN, PnmIO_PBM, PnmIO_PGM, PnmIO_PPM, PnmIO_PAM
+} PnmIO_Format;
+
+extern PnmIO_Format PnmIO_peek(FILE *fp);
+extern int          PnmIO_magic(FILE *fp);
+extern int          PnmIO_number(FILE *fp);
+
+#endif
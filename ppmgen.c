@@ -0,0 +1,109 @@
+/*
+ *     ppmgen.c
+ *     Locality
+ *
+ *     This program writes a deterministic synthetic PPM image of any size,
+ *     maxval and pattern, so benchmarks do not depend on a single external
+ *     photo. The image is streamed row by row, which makes multi-gigapixel
+ *     outputs possible, and shapes such as 1xN, Nx1 or sizes that are not
+ *     a multiple of any blocksize are produced like any other.
+ *
+ *     Usage: ppmgen [-pattern {gradient,noise,tiles}] [-maxval n]
+ *                   [-seed n] [-tile n] [-o output_file] width height
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "imagegen.h"
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-pattern {gradient,noise,tiles}] "
+                        "[-maxval n] [-seed n] [-tile n] [-o output_file] "
+                        "width height\n",
+                        progname);
+        exit(1);
+}
+
+/* parse a decimal integer in [minimum, maximum] or exit with the usage */
+static long parse_number(const char *progname, const char *arg, long minimum,
+                         long maximum)
+{
+        char *endptr;
+        long n = strtol(arg, &endptr, 10);
+        if (*arg == '\0' || *endptr != '\0' || n < minimum || n > maximum) {
+                fprintf(stderr, "%s: bad number '%s'\n", progname, arg);
+                usage(progname);
+        }
+        return n;
+}
+
+int main(int argc, char *argv[])
+{
+        ImageGen_Params params = { 0, 0, 255, ImageGen_GRADIENT, 0, 32 };
+        const char *output_name = NULL;
+        int sizes_given = 0;
+
+        for (int i = 1; i < argc; i++) {
+                if (argv[i][0] == '-' && i + 1 >= argc) {
+                        usage(argv[0]);
+                }
+                if (strcmp(argv[i], "-pattern") == 0) {
+                        if (!ImageGen_pattern(argv[++i], &params.pattern)) {
+                                fprintf(stderr, "%s: unknown pattern '%s'\n",
+                                        argv[0], argv[i]);
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-maxval") == 0) {
+                        params.maxval = parse_number(argv[0], argv[++i], 1,
+                                                     65535);
+                } else if (strcmp(argv[i], "-seed") == 0) {
+                        params.seed = parse_number(argv[0], argv[++i], 0,
+                                                   0x7fffffffL);
+                } else if (strcmp(argv[i], "-tile") == 0) {
+                        params.tile = parse_number(argv[0], argv[++i], 1,
+                                                   0x7fffffffL);
+                } else if (strcmp(argv[i], "-o") == 0) {
+                        output_name = argv[++i];
+                } else if (argv[i][0] == '-') {
+                        fprintf(stderr, "%s: unknown option '%s'\n", argv[0],
+                                argv[i]);
+                        usage(argv[0]);
+                } else if (sizes_given == 0) {
+                        params.width = parse_number(argv[0], argv[i], 1,
+                                                    0x7fffffffL);
+                        sizes_given++;
+                } else if (sizes_given == 1) {
+                        params.height = parse_number(argv[0], argv[i], 1,
+                                                     0x7fffffffL);
+                        sizes_given++;
+                } else {
+                        fprintf(stderr, "Too many arguments\n");
+                        usage(argv[0]);
+                }
+        }
+        if (sizes_given != 2) {
+                usage(argv[0]);
+        }
+
+        FILE *fp = stdout;
+        if (output_name != NULL) {
+                fp = fopen(output_name, "wb");
+                if (fp == NULL) {
+                        fprintf(stderr,
+                                "Error: Cannot open file '%s' for writing.\n",
+                                output_name);
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        ImageGen_write(&params, fp);
+
+        if (fclose(fp) != 0) {
+                fprintf(stderr, "Error: cannot write image\n");
+                exit(EXIT_FAILURE);
+        }
+        return EXIT_SUCCESS;
+}
@@ -4,26 +4,51 @@
  *     2/23/24
  *     Locality
  *
- *     This program reads a PPM image file, performs image transformations
- *     (rotation, flipping, transposing) based on the commands given, and
- *     writes the transformed image to stdout. Command line is used to specify 
- *     the rotation angle, flip direction, mapping type (row-major,
- *     column-major, block-major), and an optional timing file to record the
- *     execution time and complementary information. The program uses the 
- *     A2Methods interface for the 2D array usage and pnm.h for PPM image 
- *     processing.
+ *     This program reads a PPM, PGM, PBM or PAM image file, performs image
+ *     transformations (rotation, flipping, transposing) based on the
+ *     commands given, and writes the transformed image to stdout. Command
+ *     line is used to specify the rotation angle (any angle, resampled when
+ *     it is not a right angle), flip direction, an optional region to crop
+ *     to, filter (convolution, median or box) and size to scale to first,
+ *     per-pixel operations (grayscale, brightness, contrast, gamma, channel
+ *     order, invert, maxval) done as the pixels are moved, dithering to a
+ *     lower maxval or a PBM, a PAM background to composite over, mapping
+ *     type (row-major, column-major, block-major, cache-oblivious), and an
+ *     optional timing file to record the execution time and complementary
+ *     information. The program uses the A2Methods interface for the 2D
+ *     array usage and pnm.h for PPM image processing.
  */
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include "assert.h"
+#include "mem.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "uarray2b.h"
 #include "cputiming.h"
+#include "phasetimer.h"
+#include "hugemem.h"
+#include "parallel.h"
+#include "rotate.h"
+#include "resize.h"
+#include "convolve.h"
+#include "window.h"
+#include "pixelops.h"
+#include "pyramid.h"
+#include "pnmio.h"
+#include "bitmap.h"
+#include "graymap.h"
+#include "pam.h"
+#include "dither.h"
+#include "trace.h"
 #include "pnm.h"
+#include "transform.h"
 
 #define SET_METHODS(METHODS, MAP, WHAT) do {                    \
         methods = (METHODS);                                    \
@@ -37,45 +62,237 @@
         }                                                       \
 } while (false)
 
-/* struct to allow us to access the second picture and A2 methods */
-/* struct to allow us to access the second picture and A2 methods */
-struct closure {
-        A2Methods_T methods;
-        A2Methods_UArray2 array2;
-};
-
 /* struct to store information about the image */
 /* struct to store information about the image */
 struct imageInfo {
-        int rotation, width, height;
-        char *image_name, *mapping, *transformation;
+        int width, height;
+        const char *image_name, *mapping, *operation, *kernel, *traversal;
 };
 
 /* function declarations */
 /* function declarations */
-void rotate0(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
-void rotate90(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
-void rotate180(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
-void rotate270(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
-void flipHorizontal(int i, int j, A2Methods_UArray2 array2, void *elem,
-                    void *cl);
-void flipVertical(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
-void doTranspose(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
-void writeTimer(double time_used, char *time_file_name, struct imageInfo);
+void writeTimer(PhaseTimer_T phases, CPUTime_T timer, char *time_file_name,
+                struct imageInfo image_info);
 
 /* Usage function */
 /* Usage function */
 static void usage(const char *progname)
 {
         fprintf(stderr, "Usage: %s [-rotate <angle>] "
-                        "[-{row,col,block}-major] "
-		        "[-time time_file] "
+                        "[-filter {bilinear,bicubic}] [-crop x y w h] "
+                        "[-blur sigma | -sharpen | -kernel file | "
+                        "-median r | -box r] "
+                        "[-scale WxH] "
+                        "[-scale-filter {box,bicubic,lanczos}] [-threads n] "
+                        "[-grayscale] [-brightness b] [-contrast c] "
+                        "[-gamma g] [-channels order] [-invert] "
+                        "[-maxval n] [-pyramid dir [tile=n]] "
+                        "[-over background.pam] [-dither {n,pbm}] "
+                        "[-{row,col,block}-major] [-cache-oblivious] "
+		        "[-generic] [-traversal {scatter,gather,auto}] "
+		        "[-stream {on,off,auto}] "
+		        "[-hugepages {off,thp,hugetlb}] [-tile-bytes n] "
+		        "[-time time_file] [-trace trace_file] "
 		        "[filename]\n",
                         progname);
         exit(1);
 }
 
 
+/* the number after option argv[*i], which must lie in [lo, hi] */
+static double numberArgument(int argc, char *argv[], int *i, double lo,
+                             double hi)
+{
+        if (!(*i + 1 < argc)) {     /* no number */
+                usage(argv[0]);
+        }
+        const char *option = argv[*i];
+        char *endptr;
+        double value = strtod(argv[++*i], &endptr);
+        if (endptr == argv[*i] || *endptr != '\0' || !(value >= lo &&
+                                                        value <= hi)) {
+                fprintf(stderr, "Invalid value for %s\n", option);
+                usage(argv[0]);
+        }
+        return value;
+}
+
+
+/* start a timed phase, and a trace event for it when tracing */
+static void beginPhase(PhaseTimer_T phases, const char *name)
+{
+        TRACE_BEGIN(name, "phase");
+        PhaseTimer_Start(phases, name);
+}
+
+
+/* stop the phase started last */
+static void endPhase(PhaseTimer_T phases)
+{
+        PhaseTimer_Stop(phases);
+        TRACE_END(PhaseTimer_Name(phases, PhaseTimer_Length(phases) - 1),
+                  "phase");
+}
+
+
+/* the PBM, PGM or PAM image on fp, widened to Pnm_rgb pixels for every
+   operation that needs them; PBM black is 0 and white 1, maxval 1, and
+   PAM alpha is dropped */
+static Pnm_ppm readPacked(FILE *fp, PnmIO_Format format,
+                          A2Methods_T methods)
+{
+        int magic = PnmIO_magic(fp);
+        Pnm_ppm image;
+        NEW(image);
+        image->methods = methods;
+        if (format == PnmIO_PBM) {
+                Bitmap_T bitmap = Bitmap_read(fp, magic);
+                image->width = Bitmap_width(bitmap);
+                image->height = Bitmap_height(bitmap);
+                image->denominator = 1;
+                image->pixels = Bitmap_pixels(bitmap, methods);
+                Bitmap_free(&bitmap);
+        } else if (format == PnmIO_PAM) {
+                Pam_T pam = Pam_read(fp);
+                image->width = Pam_width(pam);
+                image->height = Pam_height(pam);
+                image->denominator = Pam_maxval(pam);
+                image->pixels = Pam_pixels(pam, methods);
+                Pam_free(&pam);
+        } else {
+                Graymap_T graymap = Graymap_read(fp, magic);
+                image->width = Graymap_width(graymap);
+                image->height = Graymap_height(graymap);
+                image->denominator = Graymap_maxval(graymap);
+                image->pixels = Graymap_pixels(graymap, methods);
+                Graymap_free(&graymap);
+        }
+        return image;
+}
+
+
+/*
+ * Name: transformPacked
+ *
+ * Description: finishes the program for a PBM, PGM or PAM image moved by
+ * an exact operation: reads it packed, transforms it and writes it to
+ * stdout as a raw PBM (P4), PGM (P5) or PAM (P7), timing each phase
+ *
+ * Parameters:
+ *           FILE *fp: the image, before its magic number; closed here
+ *           PnmIO_Format format: PnmIO_PBM, PnmIO_PGM or PnmIO_PAM
+ *           const Transform *transform: the operation
+ *           const char *over_name: a PAM to composite the result over, or
+ *           NULL
+ *           PhaseTimer_T phases: the timer, inside the read phase
+ *           char *time_file_name: where to append the timing, or NULL
+ *           struct imageInfo image_info: the image's description, its size
+ *           and kernel filled in here
+ *
+ * Returns: nothing
+ *
+ * Expects: fp is open for reading; over_name is NULL unless format is
+ * PnmIO_PAM
+ *
+ * Notes: the mapping, traversal and streaming options have no meaning for
+ * packed images and are ignored. Exits with an error message if over_name
+ * cannot be read as a PAM
+ */
+static void transformPacked(FILE *fp, PnmIO_Format format,
+                            const Transform *transform,
+                            const char *over_name, PhaseTimer_T phases,
+                            char *time_file_name,
+                            struct imageInfo image_info)
+{
+        assert(over_name == NULL || format == PnmIO_PAM);
+        int magic = PnmIO_magic(fp);
+        Bitmap_T bitmap = NULL, new_bitmap = NULL;
+        Graymap_T graymap = NULL, new_graymap = NULL;
+        Pam_T pam = NULL, new_pam = NULL, background = NULL;
+        if (format == PnmIO_PBM) {
+                bitmap = Bitmap_read(fp, magic);
+                image_info.width = Bitmap_width(bitmap);
+                image_info.height = Bitmap_height(bitmap);
+                image_info.kernel = "bitmap";
+        } else if (format == PnmIO_PAM) {
+                pam = Pam_read(fp);
+                image_info.width = Pam_width(pam);
+                image_info.height = Pam_height(pam);
+                image_info.kernel = over_name != NULL ? "pam+over" : "pam";
+        } else {
+                graymap = Graymap_read(fp, magic);
+                image_info.width = Graymap_width(graymap);
+                image_info.height = Graymap_height(graymap);
+                image_info.kernel = "graymap";
+        }
+        fclose(fp);
+        if (over_name != NULL) {
+                FILE *over_file = fopen(over_name, "rb");
+                if (over_file == NULL) {
+                        fprintf(stderr, "Error: Cannot open file '%s' for "
+                                        "reading.\n", over_name);
+                        exit(EXIT_FAILURE);
+                }
+                if (PnmIO_magic(over_file) != '7') {
+                        fprintf(stderr, "Error: '%s' is not a PAM image\n",
+                                over_name);
+                        exit(EXIT_FAILURE);
+                }
+                background = Pam_read(over_file);
+                fclose(over_file);
+        }
+        endPhase(phases);
+
+        CPUTime_T timer = CPUTime_New();
+        if (time_file_name != NULL) {
+                CPUTime_EnableCounters(timer);
+        }
+        beginPhase(phases, "transform");
+        CPUTime_Start(timer);
+        if (bitmap != NULL) {
+                new_bitmap = Bitmap_transform(bitmap, transform);
+        } else if (pam != NULL) {
+                new_pam = Pam_transform(pam, transform, background);
+        } else {
+                new_graymap = Graymap_transform(graymap, transform);
+        }
+        CPUTime_Stop(timer);
+        endPhase(phases);
+
+        beginPhase(phases, "write");
+        if (new_bitmap != NULL) {
+                Bitmap_write(stdout, new_bitmap);
+        } else if (new_pam != NULL) {
+                Pam_write(stdout, new_pam);
+        } else {
+                Graymap_write(stdout, new_graymap);
+        }
+        fflush(stdout);
+        endPhase(phases);
+
+        beginPhase(phases, "free");
+        if (bitmap != NULL) {
+                Bitmap_free(&bitmap);
+                Bitmap_free(&new_bitmap);
+        } else if (pam != NULL) {
+                Pam_free(&pam);
+                Pam_free(&new_pam);
+        } else {
+                Graymap_free(&graymap);
+                Graymap_free(&new_graymap);
+        }
+        if (background != NULL) {
+                Pam_free(&background);
+        }
+        endPhase(phases);
+
+        if (time_file_name != NULL) {
+                writeTimer(phases, timer, time_file_name, image_info);
+        }
+        CPUTime_Free(&timer);
+}
+
+
 /*
  * Name: main
  * 
@@ -140,6 +357,40 @@ int main(int argc, char *argv[])
         bool  transpose      = false;
         char  *mapping       = "row-major";
         bool  rotation_given = false;
+        /* any other angle is resampled with filter, see rotate.h */
+        double degrees       = 0;
+        bool  arbitrary      = false;
+        Rotate_Filter filter = Rotate_BILINEAR;
+        /* work on the crop[2] x crop[3] region at (crop[0], crop[1]) */
+        bool  cropping       = false;
+        int   crop[4]        = { 0, 0, 0, 0 };
+        /* filter the (cropped) image: with this kernel, if any, or the
+        median or box filter over a window of this radius (window.h) */
+        Convolve_T convolution = NULL;
+        int   window_radius  = 0;
+        const char *filter_name = NULL;
+        /* scale to scale_width x scale_height before the operation */
+        bool  scaling        = false;
+        int   scale_width    = 0;
+        int   scale_height   = 0;
+        Resize_Filter scale_filter = Resize_LANCZOS;
+        /* write deep-zoom tiles under pyramid_dir instead of the image to
+        stdout, see pyramid.h */
+        const char *pyramid_dir = NULL;
+        int   pyramid_tile   = 256;
+        /* composite the result over this PAM, see pam.h */
+        const char *over_name = NULL;
+        /* error-diffuse the result down to this maxval (0: don't), or to
+        a PBM, see dither.h */
+        unsigned dither_maxval = 0;
+        bool  dither_pbm     = false;
+        /* per-pixel operations, in the order given, see pixelops.h */
+        PixelOps_T pixel_ops = PixelOps_new();
+        bool  generic        = false;
+        /* NULL: let Transform_choose_traversal decide */
+        const char *traversal_name = NULL;
+        /* non-temporal stores: "on", "off" or "auto" (output beyond LLC) */
+        const char *stream = "auto";
 
         /* default to UArray2 methods */
         A2Methods_T methods = uarray2_methods_plain; 
@@ -156,33 +407,230 @@ int main(int argc, char *argv[])
                                     "row-major");
                                     /* to be able to print the mapping if a
                                     time file is given */
-                                    mapping = "row major";
+                                    mapping = "row-major";
                 } else if (strcmp(argv[i], "-col-major") == 0) {
                         SET_METHODS(uarray2_methods_plain, map_col_major, 
                                     "column-major");
-                                    mapping = "column major";
+                                    mapping = "col-major";
                 } else if (strcmp(argv[i], "-block-major") == 0) {
                         SET_METHODS(uarray2_methods_blocked, map_block_major,
                                     "block-major");
-                                    mapping = "block major";
+                                    mapping = "block-major";
+                } else if (strcmp(argv[i], "-cache-oblivious") == 0) {
+                        /* not in the methods table, see a2plain.h */
+                        methods = uarray2_methods_plain;
+                        map = A2Plain_map_cache_oblivious;
+                        mapping = "cache-oblivious";
                 } else if (strcmp(argv[i], "-rotate") == 0) {
                         if (!(i + 1 < argc)) {      /* no rotate value */
                                 usage(argv[0]);
                         }
                         char *endptr;
-                        rotation = strtol(argv[++i], &endptr, 10);
-                        if (!(rotation == 0 || rotation == 90 ||
-                            rotation == 180 || rotation == 270)) {
-                                fprintf(stderr, 
-                                        "Rotation must be 0, 90 180 or 270\n");
+                        degrees = strtod(argv[++i], &endptr);
+                        if (endptr == argv[i] || *endptr != '\0' ||
+                            !isfinite(degrees)) {    /* Not a number */
+                                fprintf(stderr, "Invalid rotation angle\n");
                                 usage(argv[0]);
                         }
-                        if (rotation == 0) {
+                        /* right angles keep the exact transforms */
+                        arbitrary = !Rotate_right_angle(degrees, &rotation);
+                        if (!arbitrary && rotation == 0) {
                                 rotation_given = true;
                         }
-                        if (!(*endptr == '\0')) {    /* Not a number */
+                } else if (strcmp(argv[i], "-filter") == 0) {
+                        if (!(i + 1 < argc)) {      /* no filter */
+                                usage(argv[0]);
+                        }
+                        if (!Rotate_filter(argv[++i], &filter)) {
+                                fprintf(stderr, "Invalid filter\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-crop") == 0) {
+                        if (!(i + 4 < argc)) {      /* no region */
                                 usage(argv[0]);
                         }
+                        for (int k = 0; k < 4; k++) {
+                                char *endptr;
+                                long v = strtol(argv[++i], &endptr, 10);
+                                if (*endptr != '\0' || v < (k < 2 ? 0 : 1) ||
+                                    v > 0x7fffffffL) {
+                                        fprintf(stderr, "Invalid crop "
+                                                        "region\n");
+                                        usage(argv[0]);
+                                }
+                                crop[k] = (int)v;
+                        }
+                        cropping = true;
+                } else if (strcmp(argv[i], "-blur") == 0 ||
+                           strcmp(argv[i], "-sharpen") == 0 ||
+                           strcmp(argv[i], "-kernel") == 0) {
+                        /* the last filter given wins */
+                        if (convolution != NULL) {
+                                Convolve_free(&convolution);
+                        }
+                        filter_name = argv[i] + 1;
+                        if (strcmp(argv[i], "-sharpen") == 0) {
+                                convolution = Convolve_sharpen();
+                                continue;
+                        }
+                        if (!(i + 1 < argc)) {      /* no sigma or file */
+                                usage(argv[0]);
+                        }
+                        i++;
+                        if (strcmp(filter_name, "blur") == 0) {
+                                char *endptr;
+                                double sigma = strtod(argv[i], &endptr);
+                                if (endptr == argv[i] || *endptr != '\0' ||
+                                    !(sigma > 0 && sigma <= 1000)) {
+                                        fprintf(stderr, "Invalid sigma\n");
+                                        usage(argv[0]);
+                                }
+                                convolution = Convolve_gaussian(sigma);
+                                continue;
+                        }
+                        FILE *kernel_file = fopen(argv[i], "r");
+                        if (kernel_file == NULL) {
+                                fprintf(stderr, "Cannot open kernel file "
+                                                "'%s'\n", argv[i]);
+                                exit(1);
+                        }
+                        convolution = Convolve_read(kernel_file);
+                        fclose(kernel_file);
+                        if (convolution == NULL) {
+                                fprintf(stderr, "'%s' is not a kernel "
+                                                "file: it must give an odd "
+                                                "width and height of at "
+                                                "most %d, then that many "
+                                                "weights\n", argv[i],
+                                        CONVOLVE_MAX_SIDE);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "-median") == 0 ||
+                           strcmp(argv[i], "-box") == 0) {
+                        /* like the kernels, the last filter given wins */
+                        if (convolution != NULL) {
+                                Convolve_free(&convolution);
+                        }
+                        filter_name = argv[i] + 1;
+                        double radius = numberArgument(argc, argv, &i, 1,
+                                                       WINDOW_MAX_RADIUS);
+                        if (radius != floor(radius)) {
+                                fprintf(stderr, "Invalid radius\n");
+                                usage(argv[0]);
+                        }
+                        window_radius = (int)radius;
+                } else if (strcmp(argv[i], "-scale") == 0) {
+                        if (!(i + 1 < argc)) {      /* no size */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        long w = strtol(argv[++i], &endptr, 10), h = 0;
+                        if (*endptr == 'x') {
+                                char *start = endptr + 1;
+                                h = strtol(start, &endptr, 10);
+                                if (endptr == start) {
+                                        h = 0;
+                                }
+                        }
+                        if (*endptr != '\0' || w <= 0 || h <= 0 ||
+                            w > 0x7fffffffL || h > 0x7fffffffL) {
+                                fprintf(stderr, "Invalid size, expected "
+                                                "WxH\n");
+                                usage(argv[0]);
+                        }
+                        scaling = true;
+                        scale_width = (int)w;
+                        scale_height = (int)h;
+                } else if (strcmp(argv[i], "-scale-filter") == 0) {
+                        if (!(i + 1 < argc)) {      /* no filter */
+                                usage(argv[0]);
+                        }
+                        if (!Resize_filter(argv[++i], &scale_filter)) {
+                                fprintf(stderr, "Invalid scale filter\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-grayscale") == 0) {
+                        PixelOps_grayscale(pixel_ops);
+                } else if (strcmp(argv[i], "-brightness") == 0) {
+                        /* a fraction of maxval */
+                        PixelOps_brightness(pixel_ops,
+                                            numberArgument(argc, argv, &i,
+                                                           -1, 1));
+                } else if (strcmp(argv[i], "-contrast") == 0) {
+                        PixelOps_contrast(pixel_ops,
+                                          numberArgument(argc, argv, &i,
+                                                         0, 1000));
+                } else if (strcmp(argv[i], "-gamma") == 0) {
+                        PixelOps_gamma(pixel_ops,
+                                       numberArgument(argc, argv, &i,
+                                                      0.001, 1000));
+                } else if (strcmp(argv[i], "-channels") == 0) {
+                        if (!(i + 1 < argc)) {      /* no order */
+                                usage(argv[0]);
+                        }
+                        if (!PixelOps_channels(pixel_ops, argv[++i])) {
+                                fprintf(stderr, "Invalid channel order, "
+                                                "expected a permutation of "
+                                                "rgb\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-invert") == 0) {
+                        PixelOps_invert(pixel_ops);
+                } else if (strcmp(argv[i], "-maxval") == 0) {
+                        double maxval = numberArgument(argc, argv, &i,
+                                                       1, 65535);
+                        if (maxval != floor(maxval)) {
+                                fprintf(stderr, "Invalid maxval\n");
+                                usage(argv[0]);
+                        }
+                        PixelOps_rescale(pixel_ops, (unsigned)maxval);
+                } else if (strcmp(argv[i], "-pyramid") == 0) {
+                        if (!(i + 1 < argc)) {      /* no directory */
+                                usage(argv[0]);
+                        }
+                        pyramid_dir = argv[++i];
+                        if (i + 1 < argc &&
+                            strncmp(argv[i + 1], "tile=", 5) == 0) {
+                                char *endptr;
+                                long tile = strtol(argv[++i] + 5, &endptr,
+                                                   10);
+                                if (*endptr != '\0' || tile < 2 ||
+                                    tile > 8192 || tile % 2 != 0) {
+                                        fprintf(stderr, "Invalid tile size, "
+                                                        "expected an even "
+                                                        "number\n");
+                                        usage(argv[0]);
+                                }
+                                pyramid_tile = (int)tile;
+                        }
+                } else if (strcmp(argv[i], "-over") == 0) {
+                        if (!(i + 1 < argc)) {      /* no background */
+                                usage(argv[0]);
+                        }
+                        over_name = argv[++i];
+                } else if (strcmp(argv[i], "-dither") == 0) {
+                        if (i + 1 < argc && strcmp(argv[i + 1], "pbm") == 0) {
+                                dither_pbm = true;
+                                dither_maxval = 0;
+                                i++;
+                        } else {
+                                dither_maxval = (unsigned)numberArgument(
+                                        argc, argv, &i, 1, 65535);
+                                dither_pbm = false;
+                        }
+                } else if (strcmp(argv[i], "-threads") == 0) {
+                        if (!(i + 1 < argc)) {      /* no thread count */
+                                usage(argv[0]);
+                        }
+                        /* 0: one per CPU */
+                        char *endptr;
+                        long threads = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0' || threads < 0 ||
+                            threads > 1024) {
+                                fprintf(stderr, "Invalid thread count\n");
+                                usage(argv[0]);
+                        }
+                        Parallel_set_threads((int)threads);
                 } else if (strcmp(argv[i], "-flip") == 0) {
                         if (!(i + 1 < argc)) {
                                 fprintf(stderr, "Direction of flip required\n");
@@ -200,11 +648,68 @@ int main(int argc, char *argv[])
                         }
                 } else if (strcmp(argv[i], "-transpose") == 0) {
                         transpose = true;
+                } else if (strcmp(argv[i], "-generic") == 0) {
+                        /* always go through the apply function */
+                        generic = true;
+                } else if (strcmp(argv[i], "-traversal") == 0) {
+                        if (!(i + 1 < argc)) {      /* no traversal */
+                                usage(argv[0]);
+                        }
+                        Transform_Traversal unused;
+                        traversal_name = argv[++i];
+                        if (strcmp(traversal_name, "auto") == 0) {
+                                traversal_name = NULL;
+                        } else if (!Transform_traversal(traversal_name,
+                                                        &unused)) {
+                                fprintf(stderr, "Invalid traversal\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-stream") == 0) {
+                        if (!(i + 1 < argc)) {      /* no stream mode */
+                                usage(argv[0]);
+                        }
+                        stream = argv[++i];
+                        if (strcmp(stream, "on") != 0 &&
+                            strcmp(stream, "off") != 0 &&
+                            strcmp(stream, "auto") != 0) {
+                                fprintf(stderr, "Invalid stream mode\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-hugepages") == 0) {
+                        if (!(i + 1 < argc)) {      /* no page policy */
+                                usage(argv[0]);
+                        }
+                        /* must be set before the image is read */
+                        HugeMem_Policy policy;
+                        if (!HugeMem_parse(argv[++i], &policy)) {
+                                fprintf(stderr, "Invalid huge page policy\n");
+                                usage(argv[0]);
+                        }
+                        HugeMem_set_policy(policy);
+                } else if (strcmp(argv[i], "-tile-bytes") == 0) {
+                        if (!(i + 1 < argc)) {      /* no tile budget */
+                                usage(argv[0]);
+                        }
+                        /* like -hugepages, needed before the image is read */
+                        char *endptr;
+                        long tile_bytes = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0' || tile_bytes < 0 ||
+                            tile_bytes > 0x7fffffffL) {
+                                fprintf(stderr, "Invalid tile size\n");
+                                usage(argv[0]);
+                        }
+                        UArray2b_set_tile_bytes((int)tile_bytes);
                 } else if (strcmp(argv[i], "-time") == 0) {
                         if (!(i + 1 < argc)) {      /* no time file */
                                 usage(argv[0]);
                         }
                         time_file_name = argv[++i];
+                } else if (strcmp(argv[i], "-trace") == 0) {
+                        if (!(i + 1 < argc)) {      /* no trace file */
+                                usage(argv[0]);
+                        }
+                        /* written when the program exits */
+                        Trace_Enable(argv[++i]);
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n", argv[0],
                                 argv[i]);
@@ -217,7 +722,36 @@ int main(int argc, char *argv[])
                        }
         }
 
+        /* check what transformation to perform (rotate 0 when none given) */
+        const char *operation = "rotate0";
+        if (rotation == 0 && rotation_given) {
+                operation = "rotate0";
+        } else if (rotation == 90) {
+                operation = "rotate90";
+        } else if (rotation == 180) {
+                operation = "rotate180";
+        } else if (rotation == 270) {
+                operation = "rotate270";
+        } else if (horizontal) {
+                operation = "horizontal";
+        } else if (vertical) {
+                operation = "vertical";
+        } else if (transpose) {
+                operation = "transpose";
+        }
+        const Transform *transform = Transform_find(operation);
+        assert(transform != NULL);
+
+        if (dither_pbm && pyramid_dir != NULL) {
+                fprintf(stderr, "-dither pbm cannot be used with -pyramid\n");
+                exit(1);
+        }
+
+        /* every phase is timed; the log is only written with -time */
+        PhaseTimer_T phases = PhaseTimer_New();
+
         /* image file openning */
+        beginPhase(phases, "read");
         FILE *fp;
         if (!file_given) {
                 fp = stdin;
@@ -231,442 +765,381 @@ int main(int argc, char *argv[])
                 }
         }
 
-        /* populate orig_image->pixels with the file read */
-        Pnm_ppm orig_image = Pnm_ppmread(fp, methods);
+        /* a PBM, PGM or PAM image that is only moved by an exact operation
+        stays packed from read to write (see bitmap.h, graymap.h and
+        pam.h); compositing needs that path */
+        PnmIO_Format format = PnmIO_peek(fp);
+        bool packed = format != PnmIO_PPM && format != PnmIO_UNKNOWN;
+        if (over_name != NULL && format != PnmIO_PAM) {
+                fprintf(stderr, "-over needs a PAM image\n");
+                usage(argv[0]);
+        }
+        if (packed && !cropping && filter_name == NULL && !scaling &&
+            !arbitrary && PixelOps_empty(pixel_ops) && pyramid_dir == NULL &&
+            dither_maxval == 0 && !dither_pbm && !generic) {
+                struct imageInfo image_info = { 0, 0,
+                                                file_given ? argv[argc - 1]
+                                                           : "stdin",
+                                                mapping, transform->name,
+                                                NULL, "scatter" };
+                transformPacked(fp, format, transform, over_name, phases,
+                                time_file_name, image_info);
+                PixelOps_free(&pixel_ops);
+                PhaseTimer_Free(&phases);
+                return EXIT_SUCCESS;
+        }
+
+        /* populate orig_image->pixels with the file read; any other PBM or
+        PGM image is widened to the same Pnm_rgb pixels */
+        Pnm_ppm orig_image;
+        if (over_name != NULL) {
+                fprintf(stderr, "-over allows at most a rotation, flip or "
+                                "transpose\n");
+                usage(argv[0]);
+        }
+        if (packed) {
+                orig_image = readPacked(fp, format, methods);
+        } else {
+                orig_image = Pnm_ppmread(fp, methods);
+        }
         fclose(fp);
         assert(orig_image);
+        endPhase(phases);
+
+        /* from here on the image is the region: a view of a plain image,
+        or a copy of the blocks it overlaps in a blocked one */
+        A2Methods_UArray2 full_image = NULL;
+        if (cropping) {
+                if ((long)crop[0] + crop[2] > (long)orig_image->width ||
+                    (long)crop[1] + crop[3] > (long)orig_image->height) {
+                        fprintf(stderr, "Crop region outside the %ux%u "
+                                        "image\n", orig_image->width,
+                                orig_image->height);
+                        exit(1);
+                }
+                beginPhase(phases, "crop");
+                full_image = orig_image->pixels;
+                orig_image->pixels = Transform_region(methods, full_image,
+                                                      crop[0], crop[1],
+                                                      crop[2], crop[3]);
+                orig_image->width  = crop[2];
+                orig_image->height = crop[3];
+                endPhase(phases);
+        }
 
-        /* create a new uarray2 to perform the rotation on that one */
+        /* the filtered image replaces the (cropped) one as the source */
+        A2Methods_UArray2 unfiltered = NULL;
+        if (filter_name != NULL) {
+                beginPhase(phases, "filter");
+                unfiltered = orig_image->pixels;
+                orig_image->pixels = methods->new_with_blocksize(
+                        orig_image->width, orig_image->height,
+                        sizeof(struct Pnm_rgb), methods->blocksize(unfiltered));
+                if (convolution != NULL) {
+                        Convolve_apply(convolution, methods, unfiltered,
+                                       orig_image->pixels,
+                                       orig_image->denominator);
+                        Convolve_free(&convolution);
+                } else if (strcmp(filter_name, "median") == 0) {
+                        Window_median(methods, unfiltered, orig_image->pixels,
+                                      window_radius, orig_image->denominator);
+                } else {
+                        Window_box(methods, unfiltered, orig_image->pixels,
+                                   window_radius);
+                }
+                endPhase(phases);
+        }
+
+        /* per-pixel operations run on each pixel as the last pass stores
+        it; without them that pass sees none (NULL) */
+        unsigned maxval = orig_image->denominator;
+        if (PixelOps_empty(pixel_ops)) {
+                PixelOps_free(&pixel_ops);
+        } else {
+                maxval = PixelOps_prepare(pixel_ops, orig_image->denominator);
+        }
+
+        /* create a new uarray2 to perform the rotation on that one; when
+        scaling as well, an exact operation is done as the scaled pixels are
+        stored, and an arbitrary rotation turns the (smaller) scaled image */
+        beginPhase(phases, "allocate");
         A2Methods_UArray2 new_image;
+        A2Methods_UArray2 scaled = NULL;
+        if (scaling && arbitrary) {
+                scaled = Resize_new_image(methods, orig_image->pixels,
+                                          scale_width, scale_height, NULL);
+                new_image = Rotate_new_image(methods, scaled, degrees);
+        } else if (scaling) {
+                new_image = Resize_new_image(methods, orig_image->pixels,
+                                             scale_width, scale_height,
+                                             transform);
+        } else if (arbitrary) {
+                new_image = Rotate_new_image(methods, orig_image->pixels,
+                                             degrees);
+        } else {
+                new_image = Transform_new_image(transform, methods,
+                                                orig_image->pixels);
+        }
+        endPhase(phases);
 
-        /* create and start the timer right before rotating */
-        CPUTime_T timer = CPUTime_New();
-        CPUTime_Start(timer);
+        /* walk the original image (scatter) or the new one (gather) */
+        Transform_Traversal traversal;
+        if (traversal_name == NULL) {
+                traversal = Transform_choose_traversal(transform, methods,
+                                                       map);
+        } else {
+                Transform_traversal(traversal_name, &traversal);
+        }
 
-        /* check what transformation to perform */
-        if (rotation == 0 && rotation_given) {
-                /* set the new image's dimensions */
-                new_image = methods->new(methods->width(orig_image), 
-                                         methods->height(orig_image),
-                                         sizeof(struct Pnm_rgb));
-                /* create an instance of closure to access methods and 
-                new_image while rotating */
-                struct closure infoGet = {methods, new_image};
-                /* map with the set major mapping function */
-                map(orig_image->pixels, rotate0, &infoGet);
-        } else if (rotation == 90) {
-                new_image = methods->new(methods->height(orig_image), 
-                                         methods->width(orig_image),
-                                         sizeof(struct Pnm_rgb));
-                struct closure infoGet = {methods, new_image};
-                map(orig_image->pixels, rotate90, &infoGet);
-        } else if (rotation == 180) {
-                new_image = methods->new(methods->width(orig_image), 
-                                         methods->height(orig_image),
-                                         sizeof(struct Pnm_rgb));
-                struct closure infoGet = {methods, new_image};
-                map(orig_image->pixels, rotate180, &infoGet);
-        } else if (rotation == 270) {
-                new_image = methods->new(methods->height(orig_image), 
-                                         methods->width(orig_image),
-                                         sizeof(struct Pnm_rgb));
-                struct closure infoGet = {methods, new_image};
-                map(orig_image->pixels, rotate270, &infoGet);
-        } else if (horizontal) {
-                        new_image = methods->new(methods->width(orig_image), 
-                                                 methods->height(orig_image),
-                                                 sizeof(struct Pnm_rgb));
-                        struct closure infoGet = {methods, new_image};
-                        map(orig_image->pixels, flipHorizontal, &infoGet);
-        } else if (vertical) {
-                        new_image = methods->new(methods->width(orig_image), 
-                                                 methods->height(orig_image),
-                                                 sizeof(struct Pnm_rgb));
-                        struct closure infoGet = {methods, new_image};
-                        map(orig_image->pixels, flipVertical, &infoGet);
-        } else if (transpose) {
-                        new_image = methods->new(methods->height(orig_image), 
-                                                 methods->width(orig_image),
-                                                 sizeof(struct Pnm_rgb));
-                        struct closure infoGet = {methods, new_image};
-                        map(orig_image->pixels, doTranspose, &infoGet);
+        /* an output bigger than the last-level cache would evict the
+        source while it is written, so it is gathered with streaming stores
+        instead; these kernels gather, so -traversal scatter rules them out */
+        double output_bytes = (double)orig_image->width * orig_image->height
+                              * sizeof(struct Pnm_rgb);
+        bool streaming = strcmp(stream, "on") == 0 ||
+                         (strcmp(stream, "auto") == 0 &&
+                          output_bytes > Transform_cache_bytes());
+        if (traversal_name != NULL && strcmp(traversal_name, "scatter") == 0) {
+                streaming = false;
         }
 
-        /* stop the timer right after the rotation has been performed */
-        double time_used = CPUTime_Stop(timer);
+        /* use the compile-time specialized loop for this operation and
+        mapping unless -generic asked for the apply function path */
+        Transform_kernel *kernel = NULL;
+        const char *kernel_name = "generic";
+        char filter_names[64];
+        if (scaling || arbitrary) {
+                /* resampling always gathers, whatever was asked for, and
+                has no specialized kernels */
+                snprintf(filter_names, sizeof(filter_names), "%s%s%s",
+                         scaling ? Resize_filter_name(scale_filter) : "",
+                         scaling && arbitrary ? "+" : "",
+                         arbitrary ? Rotate_filter_name(filter) : "");
+                kernel_name = filter_names;
+                traversal = Transform_GATHER;
+                generic = true;
+        } else if (pixel_ops != NULL) {
+                /* one pass over the original that operates on every pixel
+                and stores it where the operation moves it */
+                kernel_name = "fused";
+                traversal = Transform_SCATTER;
+                generic = true;
+        }
+        if (!generic && streaming) {
+                kernel = Transform_find_stream_kernel(transform, methods, map);
+                if (kernel != NULL) {
+                        kernel_name = "streaming";
+                        traversal = Transform_GATHER;
+                }
+        }
+        if (!generic && kernel == NULL) {
+                kernel = Transform_find_kernel(transform, methods, map,
+                                               traversal);
+                if (kernel != NULL) {
+                        kernel_name = "specialized";
+                }
+        }
 
-        /* Check if a time file has been given, if so, print the information
-        gathered to the time file (appending it)*/
+        /* the CPU timer brackets only the map, for the hardware counters */
+        CPUTime_T timer = CPUTime_New();
         if (time_file_name != NULL) {
-                char *transformation;
-                /* check if a non-rotation transformation was given */
-                if (vertical) {
-                        transformation = "vertical";
-                } else if (horizontal) {
-                        transformation = "horizontal";
-                } else if (transpose) {
-                        transformation = "transpose";
-                } else {
-                        transformation = "NO";
+                /* hardware counters are optional: timing works without */
+                CPUTime_EnableCounters(timer);
+        }
+        beginPhase(phases, "transform");
+        CPUTime_Start(timer);
+        if (scaling && !arbitrary) {
+                Resize_scale(methods, orig_image->pixels, new_image,
+                             transform, scale_filter,
+                             orig_image->denominator, pixel_ops);
+        } else if (arbitrary) {
+                if (scaled != NULL) {
+                        Resize_scale(methods, orig_image->pixels, scaled,
+                                     NULL, scale_filter,
+                                     orig_image->denominator, NULL);
                 }
-                        
-                struct imageInfo image_info = { rotation, 
-                                                methods->width(orig_image),
-                                                methods->height(orig_image),
-                                                argv[argc - 1], 
-                                                mapping, transformation };
-                writeTimer(time_used, time_file_name, image_info);
+                Rotate_resample(methods,
+                                scaled != NULL ? scaled : orig_image->pixels,
+                                new_image, degrees, filter,
+                                orig_image->denominator, pixel_ops);
+        } else if (pixel_ops != NULL) {
+                PixelOps_map(pixel_ops, transform, methods,
+                             orig_image->pixels, new_image);
+        } else if (kernel != NULL) {
+                kernel(orig_image->pixels, new_image);
+        } else {
+                Transform_map(transform, methods, map, traversal,
+                              orig_image->pixels, new_image);
         }
+        CPUTime_Stop(timer);
+        endPhase(phases);
 
-        /* free the information */
-        CPUTime_Free(&timer);
-        methods->free(&orig_image->pixels);
+        /* the original pixels are freed with everything else at the end */
+        char operation_name[64];
+        if (arbitrary) {
+                snprintf(operation_name, sizeof(operation_name), "rotate%g",
+                         degrees);
+        } else {
+                snprintf(operation_name, sizeof(operation_name), "%s",
+                         transform->name);
+        }
+        if (scaling) {
+                size_t length = strlen(operation_name);
+                snprintf(operation_name + length,
+                         sizeof(operation_name) - length, "+scale%dx%d",
+                         scale_width, scale_height);
+        }
+        if (filter_name != NULL) {
+                size_t length = strlen(operation_name);
+                snprintf(operation_name + length,
+                         sizeof(operation_name) - length, "+%s",
+                         filter_name);
+        }
+        if (cropping) {
+                size_t length = strlen(operation_name);
+                snprintf(operation_name + length,
+                         sizeof(operation_name) - length, "+crop");
+        }
+        if (pixel_ops != NULL) {
+                size_t length = strlen(operation_name);
+                snprintf(operation_name + length,
+                         sizeof(operation_name) - length, "+pixelops");
+        }
+        if (dither_maxval != 0 || dither_pbm) {
+                size_t length = strlen(operation_name);
+                snprintf(operation_name + length,
+                         sizeof(operation_name) - length, "+dither");
+        }
+        struct imageInfo image_info = { orig_image->width, orig_image->height,
+                                        file_given ? argv[argc - 1] : "stdin",
+                                        mapping, operation_name,
+                                        kernel_name,
+                                        Transform_traversal_name(traversal) };
+        A2Methods_UArray2 old_pixels = orig_image->pixels;
         orig_image->width = methods->width(new_image);
         orig_image->height = methods->height(new_image);
         orig_image->pixels = new_image;
 
-        /* write the transformed image to standard output */
-        Pnm_ppmwrite(stdout, orig_image);
-        Pnm_ppmfree(&orig_image);
-
-        return EXIT_SUCCESS;
-}
-
-/*
- * Name: rotate0
- * 
- * Description: rotates the given UArray2 by 0 degrees. This is called in main 
- * as an apply function, which means that it maps each element it is called on
- * (each pixel) to the respective position in the rotated image
- *
- * Parameters:
- *           int i: the column position the elem is at
- *           int j: the row position the elem is at
- *           A2Methods_UArray2 array2: the UArray containing the image
- *           void *elem: the element at the previously mentioned location in 
- *           the uarray containing the image
- *           void *cl: the struct containing the methods and the second UArray2
- *           we need to create the new image (rotated version)
- *        
- * Returns: nothing
- * 
- * Expects: valid position of the pixel
- * 
- * Notes: results in checked runtime error if: the column pos is a non-positive 
- * value or the row is a non-positive value 
- */
-void rotate0(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
-{
-        /* check for the bounds passed as parameters */
-        assert(i >= 0 && j >= 0);
-        (void)array2;
-        /* create instance of the struct to be able to access its information */
-        struct closure *info = cl;
-        int height = info->methods->height(array2);
-        int width = info->methods->width(array2);
-
-        /* check for the mapping coordinates to be inside of bounds */
-        if (i < 0 || i >= width || j < 0 || j >= height) {
-                fprintf(stderr, 
-                        "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
-                        i, j, height - j - 1, i);
-                exit(EXIT_FAILURE);
-        }
-
-        /* element in the original array*/
-        Pnm_rgb array_pixel = elem;
-        /* position where we want to store the element in the tranformed 
-        image */
-        Pnm_rgb rotated_pixel = info->methods->at(info->array2, i, j);
-        /* assign the element read to the respective position in the transformed
-        image */
-        *rotated_pixel = *array_pixel;
-}       
-
-
-/*
- * Name: rotate90
- * 
- * Description: rotates the given UArray2 by 90 degrees. This is called in main 
- * as an apply function, which means that it maps each element it is called on
- * (each pixel) to the respective position in the rotated image
- *
- * Parameters:
- *           int i: the column position the elem is at
- *           int j: the row position the elem is at
- *           A2Methods_UArray2 array2: the UArray containing the image
- *           void *elem: the element at the previously mentioned location in the
- *           uarray containing the image
- *           void *cl: the struct containing the methods and the second UArray2
- *           we need to create the new image (rotated version)
- *        
- * Returns: nothing
- * 
- * Expects: valid position of the pixel
- * 
- * Notes: results in checked runtime error if: the column pos is a non-positive 
- * value or the row is a non-positive value 
- */
-void rotate90(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
-{
-        assert(i >= 0 && j >= 0);
-        struct closure *info = cl;
-        int height = info->methods->height(array2);
-        int width = info->methods->width(array2);
-
-        if (height - j - 1 < 0 || height - j - 1 >= height || 
-            i < 0 || i >= width) {
-                fprintf(stderr, 
-                       "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
-                        i, j, height - j - 1, i);
-                exit(EXIT_FAILURE);
-        }
-
-        Pnm_rgb array_pixel = elem;
-        Pnm_rgb rotated_pixel = info->methods->at(info->array2, 
-                                                  height - j - 1, i);
-        *rotated_pixel = *array_pixel;
-}
-
-
-/*
- * Name: rotate180
- * 
- * Description: rotates the given UArray2 by 180 degrees. This is called in main 
- * as an apply function, which means that it maps each element it is called on
- * (each pixel) to the respective position in the rotated image
- *
- * Parameters:
- *           int i: the column position the elem is at
- *           int j: the row position the elem is at
- *           A2Methods_UArray2 array2: the UArray containing the image
- *           void *elem: the element at the previously mentioned location in the
- *           uarray containing the image
- *           void *cl: the struct containing the methods and the second UArray2
- *           we need to create the new image (rotated version)
- *        
- * Returns: nothing
- * 
- * Expects: valid position of the pixel
- * 
- * Notes: results in checked runtime error if: the column pos is a non-positive 
- * value or the row is a non-positive value 
- */
-void rotate180(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
-{
-        assert(i >= 0 && j >= 0);
-        struct closure *info = cl;
-        int height = info->methods->height(array2);
-        int width = info->methods->width(array2);
-
-        if (i < 0 || i >= width || j < 0 || j >= height) {
-                fprintf(stderr, 
-                "Error: Invalid pixel coordinates (%d, %d)\n",
-                i, j);
-        exit(EXIT_FAILURE);
-        }
-
-        Pnm_rgb array_pixel = elem;
-        Pnm_rgb rotated_pixel = info->methods->at(info->array2, width - i - 1, 
-                                                  height - j - 1);
-        *rotated_pixel = *array_pixel;
-}
-
-
-/*
- * Name: rotate270
- * 
- * Description: rotates the given UArray2 by 270 degrees. This is called in main 
- * as an apply function, which means that it maps each element it is called on
- * (each pixel) to the respective position in the rotated image
- *
- * Parameters:
- *           int i: the column position the elem is at
- *           int j: the row position the elem is at
- *           A2Methods_UArray2 array2: the UArray containing the image
- *           void *elem: the element at the previously mentioned location in the
- *           uarray containing the image
- *           void *cl: the struct containing the methods and the second UArray2
- *           we need to create the new image (rotated version)
- *        
- * Returns: nothing
- * 
- * Expects: valid position of the pixel
- * 
- * Notes: results in checked runtime error if: the column pos is a non-positive 
- * value or the row is a non-positive value 
- */
-void rotate270(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
-{
-        assert(i >= 0 && j >= 0);
-        struct closure *info = cl;
-        int height = info->methods->height(array2);
-        int width = info->methods->width(array2);
+        /* the last pass before writing: it needs every pixel of the row
+        above, so it cannot be fused with the others */
+        Bitmap_T dithered = NULL;
+        if (dither_maxval != 0 || dither_pbm) {
+                beginPhase(phases, "dither");
+                if (dither_pbm) {
+                        dithered = Dither_bitmap(methods, new_image, maxval);
+                } else {
+                        Dither_maxval(methods, new_image, maxval,
+                                      dither_maxval);
+                        maxval = dither_maxval;
+                }
+                endPhase(phases);
+        }
+        orig_image->denominator = maxval;
 
-        if (j < 0 || j >= height || width - i - 1 < 0 || 
-                                    width - i - 1 >= width) {
-                fprintf(stderr, 
-                       "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
-                        i, j, height - j - 1, i);
-                exit(EXIT_FAILURE);
+        /* write the transformed image to standard output, or its tiles */
+        if (dithered != NULL) {
+                beginPhase(phases, "write");
+                Bitmap_write(stdout, dithered);
+                fflush(stdout);
+                endPhase(phases);
+        } else if (pyramid_dir != NULL) {
+                beginPhase(phases, "pyramid");
+                Pyramid_write(methods, new_image, maxval, pyramid_dir,
+                              pyramid_tile);
+                endPhase(phases);
+        } else {
+                beginPhase(phases, "write");
+                Pnm_ppmwrite(stdout, orig_image);
+                fflush(stdout);
+                endPhase(phases);
         }
 
-        Pnm_rgb array_pixel = elem;
-        Pnm_rgb rotated_pixel = info->methods->at(info->array2, j,
-                                                  width - i - 1);
-        *rotated_pixel = *array_pixel;
-}  
+        /* free the information */
+        beginPhase(phases, "free");
+        methods->free(&old_pixels);
+        if (unfiltered != NULL) {
+                methods->free(&unfiltered);
+        }
+        if (full_image != NULL) {
+                methods->free(&full_image);
+        }
+        if (scaled != NULL) {
+                methods->free(&scaled);
+        }
+        if (pixel_ops != NULL) {
+                PixelOps_free(&pixel_ops);
+        }
+        if (dithered != NULL) {
+                Bitmap_free(&dithered);
+        }
+        Pnm_ppmfree(&orig_image);
+        endPhase(phases);
 
+        /* Check if a time file has been given, if so, append one JSON line
+        per phase to it */
+        if (time_file_name != NULL) {
+                writeTimer(phases, timer, time_file_name, image_info);
+        }
+        CPUTime_Free(&timer);
+        PhaseTimer_Free(&phases);
 
-/*
- * Name: flipHorizontal
- * 
- * Description: flips the given UArray2 horizontally. This is called in main 
- * as an apply function, which means that it maps each element it is called on
- * (each pixel) to the respective position in the flipped image
- *
- * Parameters:
- *           int i: the column position the elem is at
- *           int j: the row position the elem is at
- *           A2Methods_UArray2 array2: the UArray containing the image
- *           void *elem: the element at the previously mentioned location in the
- *           uarray containing the image
- *           void *cl: the struct containing the methods and the second UArray2
- *           we need to create the new image (flipped version)
- *        
- * Returns: nothing
- * 
- * Expects: valid position of the pixel
- * 
- * Notes: results in checked runtime error if: the column pos is a non-positive 
- * value or the row is a non-positive value 
- */
-void flipHorizontal(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
-{
-        assert(i >= 0 && j >= 0);
-        struct closure *info = cl;
-        int width = info->methods->width(array2);
-
-        if (width - i - 1 < 0 || width - i - 1 >= width || 
-            j < 0 || j >= width) {
-                fprintf(stderr, 
-                        "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
-                        i, j, width - i - 1, j);
-                exit(EXIT_FAILURE);
-        }
-
-        Pnm_rgb array_pixel = elem;
-        Pnm_rgb rotated_pixel = info->methods->at(info->array2,
-                                                  width - i - 1, j);
-        *rotated_pixel = *array_pixel;
+        return EXIT_SUCCESS;
 }
 
-
-/*
- * Name: flipVertical
- * 
- * Description: flips the given UArray2 vertically. This is called in main 
- * as an apply function, which means that it maps each element it is called on
- * (each pixel) to the respective position in the flipped image
- *
- * Parameters:
- *           int i: the column position the elem is at
- *           int j: the row position the elem is at
- *           A2Methods_UArray2 array2: the UArray containing the image
- *           void *elem: the element at the previously mentioned location in the
- *           uarray containing the image
- *           void *cl: the struct containing the methods and the second UArray2
- *           we need to create the new image (flipped version)
- *        
- * Returns: nothing
- * 
- * Expects: valid position of the pixel
- * 
- * Notes: results in checked runtime error if: the column pos is a non-positive 
- * value or the row is a non-positive value 
- */
-void flipVertical(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
+/* write s as a JSON string literal */
+static void writeJSONString(FILE *fp, const char *s)
 {
-        assert(i >= 0 && j >= 0);
-        struct closure *info = cl;
-        int height = info->methods->height(array2);
-
-        // if (i < 0 || i >= height || height - j - 1 < 0 || 
-        //                             height - j - 1 >= height) {
-        //         fprintf(stderr, 
-        //                 "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
-        //                 i, j, i, height - j - 1);
-        //         exit(EXIT_FAILURE);
-        // }
-
-        Pnm_rgb array_pixel = elem;
-        Pnm_rgb rotated_pixel = info->methods->at(info->array2, i,
-                                                  height - j - 1);
-        *rotated_pixel = *array_pixel;
+        putc('"', fp);
+        for (; *s != '\0'; s++) {
+                unsigned char c = *s;
+                if (c == '"' || c == '\\') {
+                        fprintf(fp, "\\%c", c);
+                } else if (c < 0x20) {
+                        fprintf(fp, "\\u%04x", c);
+                } else {
+                        putc(c, fp);
+                }
+        }
+        putc('"', fp);
 }
 
 
-/*
- * Name: doTranspose
- * 
- * Description: transposes the given UArray2. This is called in main 
- * as an apply function, which means that it maps each element it is called on
- * (each pixel) to the respective position in the transposed image
- *
- * Parameters:
- *           int i: the column position the elem is at
- *           int j: the row position the elem is at
- *           A2Methods_UArray2 array2: the UArray containing the image
- *           void *elem: the element at the previously mentioned location in the
- *           uarray containing the image
- *           void *cl: the struct containing the methods and the second UArray2
- *           we need to create the new image (transposed version)
- *        
- * Returns: nothing
- * 
- * Expects: valid position of the pixel
- * 
- * Notes: results in checked runtime error if: the column pos is a non-positive 
- * value or the row is a non-positive value 
- */
-void doTranspose(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl) 
+/* write a counter name such as "L1d misses" as a JSON key, "l1d_misses" */
+static void writeCounterKey(FILE *fp, const char *name)
 {
-        assert(i >= 0 && j >= 0);
-        struct closure *info = cl;
-        int height = info->methods->height(array2);
-        int width = info->methods->width(array2);
-
-        if (i < 0 || i >= width || j < 0 || j >= height) {
-                fprintf(stderr, 
-                        "Error: Invalid pixel coordinates (%d, %d)\n",
-                        i, j);
-                exit(EXIT_FAILURE);
+        putc('"', fp);
+        for (; *name != '\0'; name++) {
+                putc(*name == ' ' ? '_' : tolower((unsigned char)*name), fp);
         }
-
-        Pnm_rgb array_pixel = elem;
-        Pnm_rgb rotated_pixel = info->methods->at(info->array2, j, i);
-        *rotated_pixel = *array_pixel;
+        putc('"', fp);
 }
 
 
 /*
  * Name: writeTimer
  * 
- * Description: writes timing information to a file, including details about
- * the image, rotation, transformation, mapping, time taken, and time per pixel
+ * Description: appends the timing information to a file as JSON lines, one
+ * object per phase (read, allocate, transform, write, free). Every object
+ * names the image, its dimensions, the mapping and the operation, and gives
+ * the phase's wall-clock time, the main thread's CPU time and the process
+ * CPU time, in total and per pixel. The transform line also carries any
+ * hardware counters the CPU timer was able to collect
  *
  * Parameters:
- *           double time_used: the total time taken for the operation
- *           char *time_file_name: the name of the file to write the timing information to
- *           struct imageInfo image_info: a struct containing information about the image
+ *           PhaseTimer_T phases: the timer holding every phase
+ *           CPUTime_T timer: the timer that measured the map itself
+ *           char *time_file_name: the name of the file to write the timing
+ *           information to
+ *           struct imageInfo image_info: a struct containing information
+ *           about the image
  *        
  * Returns: nothing
  * 
  * Expects: valid file name and image information
  * 
- * Notes: results in a checked runtime error if the file cannot be opened for writing
+ * Notes: prints an error and returns if the file cannot be opened
  */
-void writeTimer(double time_used, char *time_file_name, 
+void writeTimer(PhaseTimer_T phases, CPUTime_T timer, char *time_file_name, 
                 struct imageInfo image_info)
 {
         /* open the output file in append mode - to append the information */
@@ -680,25 +1153,43 @@ void writeTimer(double time_used, char *time_file_name,
 
         /* get the total number of pixels to be able to calculate the time per 
         pixel */
-        int pixel_total = image_info.width * image_info.height;
-        double time_per_pixel = time_used / pixel_total;
-
-        /* print the information */
-        fprintf(time_file, "FILE: %s\n"
-                "Image has a width of %d pixels and a height of %d pixels\n"
-                "Rotation: %d degree\n"
-                "Transformation: %s\n"
-                "Mapping: %s \n"
-                "Time taken: %0.f nanoseconds\n"
-                "Time taken on each pixel: %0.f nanoseconds\n", 
-                image_info.image_name, 
-                image_info.width, 
-                image_info.height, 
-                image_info.rotation, 
-                image_info.transformation, 
-                image_info.mapping, 
-                time_used, 
-                time_per_pixel);
+        double pixel_total = (double)image_info.width * image_info.height;
+
+        for (int p = 0; p < PhaseTimer_Length(phases); p++) {
+                const char *name = PhaseTimer_Name(phases, p);
+                double wall = PhaseTimer_Wall(phases, p);
+
+                fprintf(time_file, "{\"file\": ");
+                writeJSONString(time_file, image_info.image_name);
+                fprintf(time_file, ", \"width\": %d, \"height\": %d, "
+                        "\"mapping\": \"%s\", \"operation\": \"%s\", "
+                        "\"kernel\": \"%s\", \"traversal\": \"%s\", "
+                        "\"phase\": \"%s\", \"wall_ns\": %.0f, "
+                        "\"main_thread_cpu_ns\": %.0f, "
+                        "\"process_cpu_ns\": %.0f, "
+                        "\"wall_ns_per_pixel\": %.3f",
+                        image_info.width, image_info.height,
+                        image_info.mapping, image_info.operation,
+                        image_info.kernel, image_info.traversal, name, wall,
+                        PhaseTimer_ThreadCPU(phases, p),
+                        PhaseTimer_ProcessCPU(phases, p),
+                        wall / pixel_total);
+
+                /* hardware counters, so we can see why one mapping wins */
+                if (strcmp(name, "transform") == 0) {
+                        for (int c = 0; c < CPUTime_NUM_COUNTERS; c++) {
+                                if (!CPUTime_CounterValid(timer, c)) {
+                                        continue;
+                                }
+                                fprintf(time_file, ", ");
+                                writeCounterKey(time_file,
+                                                CPUTime_CounterName(c));
+                                fprintf(time_file, ": %.0f",
+                                        CPUTime_Counter(timer, c));
+                        }
+                }
+                fprintf(time_file, "}\n");
+        }
         
         fclose(time_file);
 }
@@ -0,0 +1,334 @@
+/*
+ *     pyramid.c
+ *     Locality
+ *
+ *     Implementation of deep-zoom tiling (see pyramid.h): tiles are made
+ *     depth first down a quadtree, each from its four children, and
+ *     written as they are made.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "trace.h"
+#include "pnm.h"
+#include "pyramid.h"
+
+/* subtrees per thread, at least, when the work is split */
+#define SUBTREES_PER_THREAD 4
+
+/* one tile: width x height pixels, row by row, in a tile x tile buffer */
+struct tile {
+        int width, height;
+        struct Pnm_rgb *pixels;
+};
+
+/* the pyramid in progress */
+struct job {
+        struct A2Pixels image;
+        unsigned maxval;
+        const char *dir;
+        int tile;
+        int top;                        /* the level of the image itself */
+        int split;                      /* the level spread over threads */
+        int split_across;               /* tiles across the split level */
+        struct tile *subtrees;          /* the tiles of the split level */
+};
+
+/* the largest level, ceil(log2(max(width, height))) */
+int Pyramid_levels(int width, int height)
+{
+        assert(width > 0 && height > 0);
+        int side = width > height ? width : height;
+        int top = 0;
+        while ((1L << top) < side) {
+                top++;
+        }
+        return top;
+}
+
+/* the width or height of level from the image's size */
+static int level_size(const struct job *job, int level, int size)
+{
+        int shift = job->top - level;
+        return (int)(((long)size + (1L << shift) - 1) >> shift);
+}
+
+static void make_directory(const char *path)
+{
+        if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+                fprintf(stderr, "Error: cannot create directory '%s'\n",
+                        path);
+                exit(EXIT_FAILURE);
+        }
+}
+
+/* the tile as a binary PPM, written with one fwrite */
+static void write_tile(const struct job *job, int level, int col, int row,
+                       const struct tile *tile)
+{
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/image_files/%d/%d_%d.ppm", job->dir,
+                 level, col, row);
+        FILE *fp = fopen(path, "wb");
+        if (fp == NULL) {
+                fprintf(stderr, "Error: cannot open '%s' for writing\n",
+                        path);
+                exit(EXIT_FAILURE);
+        }
+
+        TRACE_BEGIN_XY("encode", "pyramid", col, row);
+        int bytes = job->maxval < 256 ? 1 : 2;
+        size_t size = (size_t)tile->width * tile->height * 3 * bytes;
+        unsigned char *data = ALLOC((long)size);
+        unsigned char *p = data;
+        for (long k = 0; k < (long)tile->width * tile->height; k++) {
+                unsigned samples[3] = { tile->pixels[k].red,
+                                        tile->pixels[k].green,
+                                        tile->pixels[k].blue };
+                for (int c = 0; c < 3; c++) {
+                        if (bytes == 2) {
+                                *p++ = samples[c] >> 8;
+                        }
+                        *p++ = samples[c] & 0xff;
+                }
+        }
+        fprintf(fp, "P6\n%d %d\n%u\n", tile->width, tile->height,
+                job->maxval);
+        if (fwrite(data, 1, size, fp) != size || fclose(fp) != 0) {
+                fprintf(stderr, "Error: cannot write '%s'\n", path);
+                exit(EXIT_FAILURE);
+        }
+        FREE(data);
+        TRACE_END("encode", "pyramid");
+}
+
+/* the 2x2 averages of child into the quadrant (dx, dy) of parent; the
+   last row or column of an odd child averages fewer pixels */
+static void reduce(const struct tile *child, struct tile *parent, int dx,
+                   int dy, int tile)
+{
+        int half = tile / 2;
+        for (int y = 0; 2 * y < child->height; y++) {
+                const struct Pnm_rgb *r0 = child->pixels +
+                                           (long)2 * y * child->width;
+                const struct Pnm_rgb *r1 = 2 * y + 1 < child->height
+                                           ? r0 + child->width : r0;
+                struct Pnm_rgb *out = parent->pixels +
+                                      (long)(dy * half + y) * parent->width +
+                                      dx * half;
+                for (int x = 0; 2 * x < child->width; x++) {
+                        int x1 = 2 * x + 1 < child->width ? 2 * x + 1
+                                                          : 2 * x;
+                        unsigned n = (x1 != 2 * x ? 2 : 1) *
+                                     (r1 != r0 ? 2 : 1);
+                        unsigned red = r0[2 * x].red, green = r0[2 * x].green,
+                                 blue = r0[2 * x].blue;
+                        if (x1 != 2 * x) {
+                                red += r0[x1].red;
+                                green += r0[x1].green;
+                                blue += r0[x1].blue;
+                        }
+                        if (r1 != r0) {
+                                red += r1[2 * x].red;
+                                green += r1[2 * x].green;
+                                blue += r1[2 * x].blue;
+                                if (x1 != 2 * x) {
+                                        red += r1[x1].red;
+                                        green += r1[x1].green;
+                                        blue += r1[x1].blue;
+                                }
+                        }
+                        out[x].red   = (red + n / 2) / n;
+                        out[x].green = (green + n / 2) / n;
+                        out[x].blue  = (blue + n / 2) / n;
+                }
+        }
+}
+
+/*
+ * Name: build
+ *
+ * Description: makes tile (col, row) of level, and every tile under it,
+ * writing each
+ *
+ * Parameters:
+ *           const struct job *job: the pyramid
+ *           int level, col, row: the tile
+ *           struct tile *out: its pixels, with room for tile x tile
+ *
+ * Returns: nothing
+ *
+ * Expects: the tile exists
+ *
+ * Notes: above the split level, the tiles of the split level are taken
+ * from job->subtrees, made and written already, instead of made again
+ */
+static void build(const struct job *job, int level, int col, int row,
+                  struct tile *out)
+{
+        int t = job->tile;
+        int width = level_size(job, level, job->image.width);
+        int height = level_size(job, level, job->image.height);
+        out->width = width - col * t < t ? width - col * t : t;
+        out->height = height - row * t < t ? height - row * t : t;
+
+        if (level == job->top) {
+                for (int y = 0; y < out->height; y++) {
+                        struct Pnm_rgb *p = out->pixels +
+                                            (long)y * out->width;
+                        for (int x = 0; x < out->width; x++) {
+                                p[x] = *A2Pixels_at(&job->image,
+                                                    col * t + x,
+                                                    row * t + y);
+                        }
+                }
+        } else {
+                int child_width = level_size(job, level + 1,
+                                             job->image.width);
+                int child_height = level_size(job, level + 1,
+                                              job->image.height);
+                struct tile scratch = { 0, 0, NULL };
+                for (int dy = 0; dy < 2; dy++) {
+                        for (int dx = 0; dx < 2; dx++) {
+                                int c = 2 * col + dx, r = 2 * row + dy;
+                                if ((long)c * t >= child_width ||
+                                    (long)r * t >= child_height) {
+                                        continue;
+                                }
+                                const struct tile *child;
+                                if (level + 1 == job->split &&
+                                    job->subtrees != NULL) {
+                                        child = &job->subtrees[
+                                                r * job->split_across + c];
+                                } else {
+                                        if (scratch.pixels == NULL) {
+                                                scratch.pixels = ALLOC(
+                                                        (long)t * t *
+                                                        sizeof(struct
+                                                               Pnm_rgb));
+                                        }
+                                        build(job, level + 1, c, r,
+                                              &scratch);
+                                        child = &scratch;
+                                }
+                                reduce(child, out, dx, dy, t);
+                        }
+                }
+                if (scratch.pixels != NULL) {
+                        FREE(scratch.pixels);
+                }
+        }
+        write_tile(job, level, col, row, out);
+}
+
+static void build_subtree(int index, void *cl)
+{
+        struct job *job = cl;
+        build(job, job->split, index % job->split_across,
+              index / job->split_across, &job->subtrees[index]);
+}
+
+/*
+ * Name: Pyramid_write
+ *
+ * Description: writes the deep-zoom pyramid of image under dir
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of image
+ *           A2Methods_UArray2 image: the image holding Pnm_rgb pixels
+ *           unsigned maxval: its largest channel value
+ *           const char *dir: the directory, made if it does not exist
+ *           int tile: the side of a tile, even
+ *
+ * Returns: nothing
+ *
+ * Expects: methods, image and dir are not NULL, image is not empty, 0 <
+ * maxval <= 65535, tile >= 2 and even
+ *
+ * Notes: exits with an error message if a directory or file cannot be
+ * made or written; tiles already in dir are overwritten
+ */
+void Pyramid_write(A2Methods_T methods, A2Methods_UArray2 image,
+                   unsigned maxval, const char *dir, int tile)
+{
+        assert(methods != NULL && image != NULL && dir != NULL);
+        assert(maxval > 0 && maxval <= 65535);
+        assert(tile >= 2 && tile % 2 == 0);
+        struct job job;
+        A2Pixels_open(&job.image, methods, image);
+        assert(job.image.width > 0 && job.image.height > 0);
+        job.maxval = maxval;
+        job.dir = dir;
+        job.tile = tile;
+        job.top = Pyramid_levels(job.image.width, job.image.height);
+        job.subtrees = NULL;
+
+        char path[4096];
+        make_directory(dir);
+        snprintf(path, sizeof(path), "%s/image_files", dir);
+        make_directory(path);
+        for (int level = 0; level <= job.top; level++) {
+                snprintf(path, sizeof(path), "%s/image_files/%d", dir,
+                         level);
+                make_directory(path);
+        }
+        snprintf(path, sizeof(path), "%s/image.dzi", dir);
+        FILE *fp = fopen(path, "w");
+        if (fp == NULL) {
+                fprintf(stderr, "Error: cannot open '%s' for writing\n",
+                        path);
+                exit(EXIT_FAILURE);
+        }
+        fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                    "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/"
+                    "2008\" TileSize=\"%d\" Overlap=\"0\" Format=\"ppm\">\n"
+                    "  <Size Width=\"%d\" Height=\"%d\"/>\n"
+                    "</Image>\n", tile, job.image.width, job.image.height);
+        if (fclose(fp) != 0) {
+                fprintf(stderr, "Error: cannot write '%s'\n", path);
+                exit(EXIT_FAILURE);
+        }
+
+        /* the highest level with too few tiles to go round is split no
+           further */
+        int wanted = SUBTREES_PER_THREAD * Parallel_threads();
+        int across = 1, down = 1;
+        job.split = 0;
+        while (job.split < job.top && across * down < wanted) {
+                job.split++;
+                across = (level_size(&job, job.split, job.image.width) +
+                          tile - 1) / tile;
+                down = (level_size(&job, job.split, job.image.height) +
+                        tile - 1) / tile;
+        }
+        job.split_across = across;
+
+        job.subtrees = ALLOC((long)across * down * sizeof(*job.subtrees));
+        for (int k = 0; k < across * down; k++) {
+                job.subtrees[k].pixels = ALLOC((long)tile * tile *
+                                               sizeof(struct Pnm_rgb));
+        }
+        Parallel_for(across * down, build_subtree, &job);
+
+        if (job.split > 0) {
+                struct tile root = { 0, 0, NULL };
+                root.pixels = ALLOC((long)tile * tile * sizeof(*root.pixels));
+                build(&job, 0, 0, 0, &root);
+                FREE(root.pixels);
+        }
+
+        for (int k = 0; k < across * down; k++) {
+                FREE(job.subtrees[k].pixels);
+        }
+        FREE(job.subtrees);
+        A2Pixels_close(&job.image);
+}
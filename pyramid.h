@@ -0,0 +1,36 @@
+#ifndef PYRAMID_INCLUDED
+#define PYRAMID_INCLUDED
+/****************************************************************
+ *
+ *                         pyramid.h
+ *
+ *       Deep-zoom tiling of a Pnm_rgb image: every level of its mip
+ *       pyramid, each half the size of the one above (rounded up)
+ *       down to 1x1, cut into square tiles and written as binary PPM
+ *       files in the Deep Zoom layout:
+ *
+ *         dir/image.dzi                      size and tile size
+ *         dir/image_files/<level>/<c>_<r>.ppm
+ *
+ *       Level 0 is 1x1 and the highest level the image itself; tile
+ *       (c, r) of a level holds its pixels from (c * tile, r * tile),
+ *       tiles on the right and bottom edges being smaller.
+ *
+ *       The pyramid is made in one pass over the image. A tile of a
+ *       lower level is the 2x2 average of the four tiles it covers on
+ *       the level above, and it is made as soon as those four are,
+ *       depth first, so they are still in cache: the image is read
+ *       once and no level exists whole in memory. The subtrees under
+ *       the tiles of one level are spread over threads (see
+ *       parallel.h), each encoding and writing its own tiles; the few
+ *       levels left above them are finished at the end.
+ *
+ *****************************************************************/
+
+#include "a2methods.h"
+
+extern int  Pyramid_levels(int width, int height);
+extern void Pyramid_write(A2Methods_T methods, A2Methods_UArray2 image,
+                          unsigned maxval, const char *dir, int tile);
+
+#endif
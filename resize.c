@@ -0,0 +1,360 @@
+/*
+ *     resize.c
+ *     Locality
+ *
+ *     Implementation of separable resizing (see resize.h). A new pixel is
+ *     the weighted sum of a run of old columns, taken across each old row
+ *     it needs, and then of a run of those rows. The runs and weights of
+ *     both axes are tabulated before any pixel is touched.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "pixelf.h"
+#include "trace.h"
+#include "pnm.h"
+#include "transform.h"
+#include "pixelops.h"
+#include "resize.h"
+
+/* new rows per band, the unit of parallel work */
+#define BAND 32
+
+static const char *filter_names[] = { "box", "bicubic", "lanczos" };
+
+/* how far each filter reaches, in old pixels, before widening */
+static const double filter_support[] = { 0.5, 2.0, 3.0 };
+
+/* the weights of one axis: new pixel x is the sum over k < count[x] of
+   weight[x * taps + k] times old pixel start[x] + k */
+struct weights {
+        int *start, *count;
+        float *weight;
+        int taps;
+};
+
+/* the scaling in progress, shared by every band */
+struct job {
+        struct A2Pixels src, dst;
+        int width, height;              /* of the scaled image */
+        struct weights cols, rows;
+        Transform_position *position;   /* NULL: pixels stay put */
+        float maxval;
+        PixelOps_T ops;                 /* NULL: none */
+};
+
+bool Resize_filter(const char *name, Resize_Filter *filter)
+{
+        assert(name != NULL && filter != NULL);
+        for (int i = 0; i < 3; i++) {
+                if (strcmp(name, filter_names[i]) == 0) {
+                        *filter = (Resize_Filter)i;
+                        return true;
+                }
+        }
+        return false;
+}
+
+const char *Resize_filter_name(Resize_Filter filter)
+{
+        assert(filter >= Resize_BOX && filter <= Resize_LANCZOS);
+        return filter_names[filter];
+}
+
+static double sinc(double t)
+{
+        if (t == 0) {
+                return 1.0;
+        }
+        return sin(M_PI * t) / (M_PI * t);
+}
+
+/* the filter's weight for an old pixel t old pixels away */
+static double filter_weight(Resize_Filter filter, double t)
+{
+        switch (filter) {
+        case Resize_BOX:
+                return t >= -0.5 && t < 0.5 ? 1.0 : 0.0;
+        case Resize_BICUBIC:
+                t = fabs(t);
+                if (t <= 1.0) {
+                        return (1.5 * t - 2.5) * t * t + 1.0;
+                } else if (t < 2.0) {
+                        return ((-0.5 * t + 2.5) * t - 4.0) * t + 2.0;
+                }
+                return 0.0;
+        case Resize_LANCZOS:
+                return fabs(t) < 3.0 ? sinc(t) * sinc(t / 3.0) : 0.0;
+        }
+        return 0.0;
+}
+
+/*
+ * Name: weights_new
+ *
+ * Description: tabulates the weights that take an axis of old_size pixels
+ * to new_size pixels
+ *
+ * Parameters:
+ *           struct weights *ws: filled in, freed with weights_free
+ *           int old_size, new_size: the lengths of the axis
+ *           Resize_Filter filter: the filter
+ *
+ * Returns: nothing
+ *
+ * Expects: old_size and new_size > 0
+ *
+ * Notes: old pixels past the edges are left out and the rest of the
+ * weights renormalized, so every run lies inside the axis
+ */
+static void weights_new(struct weights *ws, int old_size, int new_size,
+                        Resize_Filter filter)
+{
+        double scale = (double)new_size / old_size;
+        double widen = scale < 1.0 ? 1.0 / scale : 1.0;
+        double support = filter_support[filter] * widen;
+
+        ws->taps   = 2 * (int)ceil(support) + 2;
+        ws->start  = ALLOC((long)new_size * sizeof(*ws->start));
+        ws->count  = ALLOC((long)new_size * sizeof(*ws->count));
+        ws->weight = CALLOC((long)new_size * ws->taps, sizeof(*ws->weight));
+
+        double *raw = ALLOC((long)ws->taps * sizeof(*raw));
+        for (int x = 0; x < new_size; x++) {
+                /* the center of new pixel x, in old pixel units */
+                double center = (x + 0.5) / scale;
+                int left = (int)floor(center - support);
+                int first = -1, last = -1;
+                double total = 0;
+                for (int k = 0; k < ws->taps; k++) {
+                        int i = left + k;
+                        raw[k] = 0;
+                        if (i < 0 || i >= old_size) {
+                                continue;
+                        }
+                        raw[k] = filter_weight(filter,
+                                               (i + 0.5 - center) / widen);
+                        if (raw[k] != 0) {
+                                first = first < 0 ? k : first;
+                                last = k;
+                                total += raw[k];
+                        }
+                }
+
+                float *weight = ws->weight + (long)x * ws->taps;
+                if (first < 0 || total == 0) {
+                        /* nothing in reach: take the nearest pixel */
+                        int i = (int)center;
+                        ws->start[x] = i < old_size ? i : old_size - 1;
+                        ws->count[x] = 1;
+                        weight[0] = 1.0f;
+                        continue;
+                }
+                ws->start[x] = left + first;
+                ws->count[x] = last - first + 1;
+                for (int k = first; k <= last; k++) {
+                        weight[k - first] = (float)(raw[k] / total);
+                }
+        }
+        FREE(raw);
+}
+
+static void weights_free(struct weights *ws)
+{
+        FREE(ws->start);
+        FREE(ws->count);
+        FREE(ws->weight);
+}
+
+/* old row j scaled across into out, through line for the old pixels */
+static void scale_across(const struct job *job, int j, Pixelf *line,
+                         Pixelf *out)
+{
+        const struct A2Pixels *src = &job->src;
+        for (int i = 0; i < src->width; i++) {
+                line[i] = Pixelf_load(A2Pixels_at(src, i, j));
+        }
+
+        const struct weights *cols = &job->cols;
+        for (int x = 0; x < job->width; x++) {
+                const Pixelf *p = line + cols->start[x];
+                const float *weight = cols->weight + (long)x * cols->taps;
+                Pixelf v = Pixelf_zero();
+                for (int k = 0; k < cols->count[x]; k++) {
+                        v = Pixelf_madd(v, p[k], weight[k]);
+                }
+                out[x] = v;
+        }
+}
+
+/* store new row y, moved by the job's operation and run through its
+   per-pixel operations */
+static void store_row(const struct job *job, int y, const Pixelf *row)
+{
+        int di = 0, dj = y, step_i = 1, step_j = 0;
+        if (job->position != NULL) {
+                /* every operation is affine, so two pixels give the row */
+                int ni, nj;
+                job->position(0, y, job->width, job->height, &di, &dj);
+                job->position(1, y, job->width, job->height, &ni, &nj);
+                step_i = ni - di;
+                step_j = nj - dj;
+        }
+        for (int x = 0; x < job->width; x++) {
+                struct Pnm_rgb *out = A2Pixels_at(&job->dst, di, dj);
+                Pixelf_store(out, row[x], job->maxval);
+                if (job->ops != NULL) {
+                        PixelOps_apply(job->ops, out);
+                }
+                di += step_i;
+                dj += step_j;
+        }
+}
+
+static void scale_band(int band, void *cl)
+{
+        const struct job *job = cl;
+        const struct weights *rows = &job->rows;
+        int y0 = band * BAND;
+        int y1 = y0 + BAND < job->height ? y0 + BAND : job->height;
+
+        /* the old rows this band reads */
+        int lo = rows->start[y0], hi = lo;
+        for (int y = y0; y < y1; y++) {
+                int end = rows->start[y] + rows->count[y];
+                hi = end > hi ? end : hi;
+                lo = rows->start[y] < lo ? rows->start[y] : lo;
+        }
+
+        TRACE_BEGIN_XY("band", "resize", 0, y0);
+        Pixelf *line = ALLOC((long)job->src.width * sizeof(*line));
+        Pixelf *across = ALLOC((long)(hi - lo) * job->width *
+                               sizeof(*across));
+        Pixelf *row = ALLOC((long)job->width * sizeof(*row));
+        for (int j = lo; j < hi; j++) {
+                scale_across(job, j, line, across + (long)(j - lo) *
+                                                    job->width);
+        }
+
+        for (int y = y0; y < y1; y++) {
+                for (int x = 0; x < job->width; x++) {
+                        row[x] = Pixelf_zero();
+                }
+                const float *weight = rows->weight + (long)y * rows->taps;
+                for (int k = 0; k < rows->count[y]; k++) {
+                        const Pixelf *p = across +
+                                (long)(rows->start[y] + k - lo) * job->width;
+                        for (int x = 0; x < job->width; x++) {
+                                row[x] = Pixelf_madd(row[x], p[x],
+                                                     weight[k]);
+                        }
+                }
+                store_row(job, y, row);
+        }
+
+        FREE(line);
+        FREE(across);
+        FREE(row);
+        TRACE_END("band", "resize");
+}
+
+/*
+ * Name: Resize_new_image
+ *
+ * Description: allocates the image Resize_scale fills: width x height,
+ * swapped when transform swaps dimensions, with source's methods and
+ * blocksize
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of source
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           int width, height: the size to scale source to
+ *           const Transform *transform: the operation fused with the
+ *           scaling, or NULL for none
+ *
+ * Returns: the new image, to be freed by the client
+ *
+ * Expects: methods and source are not NULL, width and height > 0
+ *
+ * Notes: none
+ */
+A2Methods_UArray2 Resize_new_image(A2Methods_T methods,
+                                   A2Methods_UArray2 source, int width,
+                                   int height, const Transform *transform)
+{
+        assert(methods != NULL && source != NULL);
+        assert(width > 0 && height > 0);
+        if (transform != NULL && transform->swaps_dimensions) {
+                int temp = width;
+                width  = height;
+                height = temp;
+        }
+        return methods->new_with_blocksize(width, height,
+                                           sizeof(struct Pnm_rgb),
+                                           methods->blocksize(source));
+}
+
+/*
+ * Name: Resize_scale
+ *
+ * Description: fills dest with source scaled by filter and then moved by
+ * transform
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of both images
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           A2Methods_UArray2 dest: an image from Resize_new_image
+ *           const Transform *transform: the operation fused with the
+ *           scaling, or NULL for none
+ *           Resize_Filter filter: the filter
+ *           unsigned maxval: the largest channel value of the images
+ *           PixelOps_T ops: operations run on every new pixel, or NULL
+ *
+ * Returns: nothing
+ *
+ * Expects: methods, source and dest are not NULL, source is not empty,
+ * maxval > 0, ops prepared for maxval
+ *
+ * Notes: the scaled size is read off dest; bands are spread over
+ * Parallel_threads() threads
+ */
+void Resize_scale(A2Methods_T methods, A2Methods_UArray2 source,
+                  A2Methods_UArray2 dest, const Transform *transform,
+                  Resize_Filter filter, unsigned maxval, PixelOps_T ops)
+{
+        assert(methods != NULL && source != NULL && dest != NULL);
+        assert(maxval > 0);
+        struct job job;
+        A2Pixels_open(&job.src, methods, source);
+        A2Pixels_open(&job.dst, methods, dest);
+        assert(job.src.width > 0 && job.src.height > 0);
+
+        job.width  = job.dst.width;
+        job.height = job.dst.height;
+        job.position = NULL;
+        if (transform != NULL) {
+                job.position = transform->position;
+                if (transform->swaps_dimensions) {
+                        job.width  = job.dst.height;
+                        job.height = job.dst.width;
+                }
+        }
+        job.maxval = (float)maxval;
+        job.ops = ops;
+
+        weights_new(&job.cols, job.src.width, job.width, filter);
+        weights_new(&job.rows, job.src.height, job.height, filter);
+        Parallel_for((job.height + BAND - 1) / BAND, scale_band, &job);
+        weights_free(&job.cols);
+        weights_free(&job.rows);
+
+        A2Pixels_close(&job.src);
+        A2Pixels_close(&job.dst);
+}
@@ -0,0 +1,52 @@
+#ifndef RESIZE_INCLUDED
+#define RESIZE_INCLUDED
+/****************************************************************
+ *
+ *                         resize.h
+ *
+ *       Resizing of a Pnm_rgb image to any width and height with a
+ *       separable filter:
+ *
+ *         Resize_BOX      the average of the pixels each new pixel
+ *                         covers (nearest pixel when enlarging)
+ *         Resize_BICUBIC  Keys cubic, a = -0.5
+ *         Resize_LANCZOS  Lanczos with 3 lobes, the sharpest
+ *
+ *       Filters are widened by the reduction factor when shrinking,
+ *       so shrinking averages instead of aliasing. The weights of
+ *       every new column and row are computed once; the new image is
+ *       then made in bands of rows, each scaled across into a float
+ *       buffer and then down, with bands spread over threads (see
+ *       parallel.h) and channels handled together (see pixelf.h).
+ *
+ *       Resize_scale also takes one of the exact operations of
+ *       transform.h and writes every new pixel straight to where that
+ *       operation would move it, so scaling and rotating by 90 (say)
+ *       is a single pass that never stores the unrotated result, and
+ *       runs every new pixel through a chain of per-pixel operations
+ *       (see pixelops.h) as it stores it.
+ *
+ *****************************************************************/
+
+#include <stdbool.h>
+#include "a2methods.h"
+#include "transform.h"
+#include "pixelops.h"
+
+typedef enum {
+        Resize_BOX, Resize_BICUBIC, Resize_LANCZOS
+} Resize_Filter;
+
+extern bool Resize_filter(const char *name, Resize_Filter *filter);
+extern const char *Resize_filter_name(Resize_Filter filter);
+
+extern A2Methods_UArray2 Resize_new_image(A2Methods_T methods,
+                                          A2Methods_UArray2 source,
+                                          int width, int height,
+                                          const Transform *transform);
+extern void Resize_scale(A2Methods_T methods, A2Methods_UArray2 source,
+                         A2Methods_UArray2 dest, const Transform *transform,
+                         Resize_Filter filter, unsigned maxval,
+                         PixelOps_T ops);
+
+#endif
@@ -0,0 +1,347 @@
+/*
+ *     rotate.c
+ *     Locality
+ *
+ *     Implementation of arbitrary-angle rotation (see rotate.h). Each new
+ *     pixel is mapped back to the original with the inverse rotation,
+ *     which is affine, so along a row of the new image the source
+ *     position only moves by a constant step. Pixels are read and written
+ *     through struct A2Pixels, so plain and blocked images are handled by
+ *     the same code.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "pixelf.h"
+#include "trace.h"
+#include "pnm.h"
+#include "pixelops.h"
+#include "rotate.h"
+
+/* tile side when the new image is plain */
+#define TILE 64
+
+/* pixels per cache line, the stride of the prefetches */
+#define LINE_PIXELS (64 / sizeof(struct Pnm_rgb))
+
+static const char *filter_names[] = { "bilinear", "bicubic" };
+
+/* one rotation in progress, shared by every tile */
+struct job {
+        struct A2Pixels src, dst;
+        int tile;                       /* tile side */
+        int tiles_across, tiles_down;
+        /* source position of new pixel (x, y) is
+           (x * cos_t + y * sin_t + cx, -x * sin_t + y * cos_t + cy) */
+        double cos_t, sin_t, cx, cy;
+        Rotate_Filter filter;
+        float maxval;
+        PixelOps_T ops;                 /* NULL: none */
+};
+
+bool Rotate_filter(const char *name, Rotate_Filter *filter)
+{
+        assert(name != NULL && filter != NULL);
+        for (int i = 0; i < 2; i++) {
+                if (strcmp(name, filter_names[i]) == 0) {
+                        *filter = (Rotate_Filter)i;
+                        return true;
+                }
+        }
+        return false;
+}
+
+const char *Rotate_filter_name(Rotate_Filter filter)
+{
+        assert(filter == Rotate_BILINEAR || filter == Rotate_BICUBIC);
+        return filter_names[filter];
+}
+
+/*
+ * Name: Rotate_right_angle
+ *
+ * Description: tells whether a rotation by degrees is one of the exact
+ * operations, once reduced to [0, 360)
+ *
+ * Parameters:
+ *           double degrees: the clockwise angle
+ *           int *rotation: set to 0, 90, 180 or 270 when it is
+ *
+ * Returns: true if degrees is a multiple of 90
+ *
+ * Expects: rotation is not NULL
+ *
+ * Notes: none
+ */
+bool Rotate_right_angle(double degrees, int *rotation)
+{
+        assert(rotation != NULL);
+        double reduced = fmod(degrees, 360.0);
+        if (reduced < 0) {
+                reduced += 360.0;
+        }
+        for (int r = 0; r < 360; r += 90) {
+                if (reduced == r) {
+                        *rotation = r;
+                        return true;
+                }
+        }
+        return false;
+}
+
+static void new_size(int width, int height, double degrees, int *new_width,
+                     int *new_height)
+{
+        double radians = degrees * M_PI / 180.0;
+        double c = fabs(cos(radians)), s = fabs(sin(radians));
+        /* the slack keeps near fits from growing by a pixel */
+        *new_width  = (int)ceil(width * c + height * s - 0.01);
+        *new_height = (int)ceil(width * s + height * c - 0.01);
+        if (*new_width < 1) {
+                *new_width = 1;
+        }
+        if (*new_height < 1) {
+                *new_height = 1;
+        }
+}
+
+/*
+ * Name: Rotate_new_image
+ *
+ * Description: allocates the image that Rotate_resample fills: the
+ * bounding box of source rotated by degrees, with source's methods and
+ * blocksize
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of source
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           double degrees: the clockwise angle
+ *
+ * Returns: the new image, to be freed by the client
+ *
+ * Expects: methods and source are not NULL
+ *
+ * Notes: none
+ */
+A2Methods_UArray2 Rotate_new_image(A2Methods_T methods,
+                                   A2Methods_UArray2 source, double degrees)
+{
+        assert(methods != NULL && source != NULL);
+        int width, height;
+        new_size(methods->width(source), methods->height(source), degrees,
+                 &width, &height);
+        return methods->new_with_blocksize(width, height,
+                                           sizeof(struct Pnm_rgb),
+                                           methods->blocksize(source));
+}
+
+/* the Keys cubic convolution weight of a pixel t away (a = -0.5) */
+static inline float cubic(float t)
+{
+        t = fabsf(t);
+        if (t <= 1.0f) {
+                return (1.5f * t - 2.5f) * t * t + 1.0f;
+        } else if (t < 2.0f) {
+                return ((-0.5f * t + 2.5f) * t - 4.0f) * t + 2.0f;
+        }
+        return 0.0f;
+}
+
+static inline Pixelf bilinear(const struct A2Pixels *src, double sx,
+                              double sy)
+{
+        int x0 = (int)floor(sx), y0 = (int)floor(sy);
+        float fx = (float)(sx - x0), fy = (float)(sy - y0);
+        int xa = A2Pixels_clamp(x0, src->width - 1);
+        int xb = A2Pixels_clamp(x0 + 1, src->width - 1);
+        int ya = A2Pixels_clamp(y0, src->height - 1);
+        int yb = A2Pixels_clamp(y0 + 1, src->height - 1);
+
+        Pixelf v = Pixelf_zero();
+        v = Pixelf_madd(v, Pixelf_load(A2Pixels_at(src, xa, ya)),
+                        (1 - fx) * (1 - fy));
+        v = Pixelf_madd(v, Pixelf_load(A2Pixels_at(src, xb, ya)),
+                        fx * (1 - fy));
+        v = Pixelf_madd(v, Pixelf_load(A2Pixels_at(src, xa, yb)),
+                        (1 - fx) * fy);
+        v = Pixelf_madd(v, Pixelf_load(A2Pixels_at(src, xb, yb)), fx * fy);
+        return v;
+}
+
+static inline Pixelf bicubic(const struct A2Pixels *src, double sx,
+                             double sy)
+{
+        int x0 = (int)floor(sx), y0 = (int)floor(sy);
+        float fx = (float)(sx - x0), fy = (float)(sy - y0);
+        float wx[4], wy[4];
+        int xs[4];
+        for (int k = 0; k < 4; k++) {
+                wx[k] = cubic(fx - (k - 1));
+                wy[k] = cubic(fy - (k - 1));
+                xs[k] = A2Pixels_clamp(x0 + k - 1, src->width - 1);
+        }
+
+        Pixelf v = Pixelf_zero();
+        for (int r = 0; r < 4; r++) {
+                int y = A2Pixels_clamp(y0 + r - 1, src->height - 1);
+                Pixelf row = Pixelf_zero();
+                for (int k = 0; k < 4; k++) {
+                        const struct Pnm_rgb *p = A2Pixels_at(src, xs[k], y);
+                        row = Pixelf_madd(row, Pixelf_load(p), wx[k]);
+                }
+                v = Pixelf_madd(v, row, wy[r]);
+        }
+        return v;
+}
+
+/* the new pixels covered by a tile, clipped to the image */
+static void tile_bounds(const struct job *job, int index, int *x0, int *y0,
+                        int *x1, int *y1)
+{
+        *x0 = index % job->tiles_across * job->tile;
+        *y0 = index / job->tiles_across * job->tile;
+        *x1 = *x0 + job->tile < job->dst.width ? *x0 + job->tile
+                                                : job->dst.width;
+        *y1 = *y0 + job->tile < job->dst.height ? *y0 + job->tile
+                                                 : job->dst.height;
+}
+
+/* prefetch the part of the original that tile index reads: the bounding
+   box of its corners mapped back, widened by the filter's reach */
+static void prefetch_footprint(const struct job *job, int index)
+{
+#if defined(__GNUC__)
+        int x0, y0, x1, y1;
+        tile_bounds(job, index, &x0, &y0, &x1, &y1);
+        double lo_x = 1e300, hi_x = -1e300, lo_y = 1e300, hi_y = -1e300;
+        for (int corner = 0; corner < 4; corner++) {
+                double x = corner & 1 ? x1 : x0, y = corner & 2 ? y1 : y0;
+                double sx = x * job->cos_t + y * job->sin_t + job->cx;
+                double sy = -x * job->sin_t + y * job->cos_t + job->cy;
+                lo_x = sx < lo_x ? sx : lo_x;
+                hi_x = sx > hi_x ? sx : hi_x;
+                lo_y = sy < lo_y ? sy : lo_y;
+                hi_y = sy > hi_y ? sy : hi_y;
+        }
+        const struct A2Pixels *src = &job->src;
+        if (hi_x < -2 || hi_y < -2 || lo_x > src->width + 1 ||
+            lo_y > src->height + 1) {
+                return;         /* the tile is all background */
+        }
+        int i0 = A2Pixels_clamp((int)floor(lo_x) - 2, src->width - 1);
+        int i1 = A2Pixels_clamp((int)ceil(hi_x) + 2, src->width - 1);
+        int j0 = A2Pixels_clamp((int)floor(lo_y) - 2, src->height - 1);
+        int j1 = A2Pixels_clamp((int)ceil(hi_y) + 2, src->height - 1);
+        for (int j = j0; j <= j1; j++) {
+                for (int i = i0; i <= i1; i += LINE_PIXELS) {
+                        __builtin_prefetch(A2Pixels_at(src, i, j));
+                }
+        }
+#else
+        (void)job;
+        (void)index;
+#endif
+}
+
+static void rotate_tile(int index, void *cl)
+{
+        struct job *job = cl;
+        const struct A2Pixels *src = &job->src;
+        int x0, y0, x1, y1;
+        tile_bounds(job, index, &x0, &y0, &x1, &y1);
+        if (index + 1 < job->tiles_across * job->tiles_down) {
+                prefetch_footprint(job, index + 1);
+        }
+
+        TRACE_BEGIN_XY("tile", "rotate", x0, y0);
+        /* a sample must land within half a pixel of the original */
+        double max_x = src->width - 0.5, max_y = src->height - 0.5;
+        for (int y = y0; y < y1; y++) {
+                double sx = x0 * job->cos_t + y * job->sin_t + job->cx;
+                double sy = -x0 * job->sin_t + y * job->cos_t + job->cy;
+                for (int x = x0; x < x1; x++) {
+                        struct Pnm_rgb *out = A2Pixels_at(&job->dst, x, y);
+                        if (sx < -0.5 || sx > max_x || sy < -0.5 ||
+                            sy > max_y) {
+                                out->red = out->green = out->blue = 0;
+                        } else if (job->filter == Rotate_BICUBIC) {
+                                Pixelf_store(out, bicubic(src, sx, sy),
+                                           job->maxval);
+                        } else {
+                                Pixelf_store(out, bilinear(src, sx, sy),
+                                           job->maxval);
+                        }
+                        if (job->ops != NULL) {
+                                PixelOps_apply(job->ops, out);
+                        }
+                        sx += job->cos_t;
+                        sy -= job->sin_t;
+                }
+        }
+        TRACE_END("tile", "rotate");
+}
+
+/*
+ * Name: Rotate_resample
+ *
+ * Description: fills dest with source rotated clockwise by degrees about
+ * the centers of both images, resampling with filter
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of both images
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           A2Methods_UArray2 dest: an image from Rotate_new_image
+ *           double degrees: the clockwise angle
+ *           Rotate_Filter filter: the interpolation
+ *           unsigned maxval: the largest channel value of the images
+ *           PixelOps_T ops: operations run on every new pixel, or NULL
+ *
+ * Returns: nothing
+ *
+ * Expects: methods, source and dest are not NULL, maxval > 0, ops
+ * prepared for maxval
+ *
+ * Notes: tiles are spread over Parallel_threads() threads; pixels outside
+ * the original are black before ops
+ */
+void Rotate_resample(A2Methods_T methods, A2Methods_UArray2 source,
+                     A2Methods_UArray2 dest, double degrees,
+                     Rotate_Filter filter, unsigned maxval, PixelOps_T ops)
+{
+        assert(methods != NULL && source != NULL && dest != NULL);
+        assert(maxval > 0);
+        struct job job;
+        A2Pixels_open(&job.src, methods, source);
+        A2Pixels_open(&job.dst, methods, dest);
+
+        /* a blocked image is resampled one block at a time */
+        job.tile = methods->blocksize(dest) > 1 ? methods->blocksize(dest)
+                                                : TILE;
+        job.tiles_across = (job.dst.width + job.tile - 1) / job.tile;
+        job.tiles_down   = (job.dst.height + job.tile - 1) / job.tile;
+
+        /* new pixel (x, y) is (x + 0.5 - dw / 2, y + 0.5 - dh / 2) from the
+           center of the new image, and the inverse rotation of that offset
+           from the center of the original is where it came from */
+        double radians = degrees * M_PI / 180.0;
+        job.cos_t = cos(radians);
+        job.sin_t = sin(radians);
+        double px = 0.5 - job.dst.width / 2.0, py = 0.5 - job.dst.height / 2.0;
+        job.cx = px * job.cos_t + py * job.sin_t + job.src.width / 2.0 - 0.5;
+        job.cy = -px * job.sin_t + py * job.cos_t + job.src.height / 2.0
+                 - 0.5;
+        job.filter = filter;
+        job.maxval = (float)maxval;
+        job.ops = ops;
+
+        Parallel_for(job.tiles_across * job.tiles_down, rotate_tile, &job);
+
+        A2Pixels_close(&job.src);
+        A2Pixels_close(&job.dst);
+}
@@ -0,0 +1,51 @@
+#ifndef ROTATE_INCLUDED
+#define ROTATE_INCLUDED
+/****************************************************************
+ *
+ *                         rotate.h
+ *
+ *       Rotation of a Pnm_rgb image by any angle, clockwise in
+ *       degrees like ppmtrans -rotate. The new image is the bounding
+ *       box of the rotated original; pixels that fall outside the
+ *       original are black. Every new pixel is resampled from the
+ *       original around the position it came from:
+ *
+ *         Rotate_BILINEAR  the 2x2 nearest pixels
+ *         Rotate_BICUBIC   the 4x4 nearest pixels (Keys, a = -0.5),
+ *                          sharper, clamped to [0, maxval]
+ *
+ *       The new image is filled tile by tile in parallel (see
+ *       parallel.h): a tile is a block of a blocked image, or 64x64
+ *       pixels of a plain one. Before a tile is resampled, the part of
+ *       the original that the next tile reads is prefetched, and the
+ *       three channels of a pixel are interpolated together in one
+ *       SSE register where available.
+ *
+ *       Right angles are better served by the exact operations in
+ *       transform.h; Rotate_right_angle tells them apart.
+ *
+ *       Rotate_resample runs every new pixel through a chain of
+ *       per-pixel operations (see pixelops.h) as it stores it.
+ *
+ *****************************************************************/
+
+#include <stdbool.h>
+#include "a2methods.h"
+#include "pixelops.h"
+
+typedef enum { Rotate_BILINEAR, Rotate_BICUBIC } Rotate_Filter;
+
+extern bool Rotate_filter(const char *name, Rotate_Filter *filter);
+extern const char *Rotate_filter_name(Rotate_Filter filter);
+
+extern bool Rotate_right_angle(double degrees, int *rotation);
+
+extern A2Methods_UArray2 Rotate_new_image(A2Methods_T methods,
+                                          A2Methods_UArray2 source,
+                                          double degrees);
+extern void Rotate_resample(A2Methods_T methods, A2Methods_UArray2 source,
+                            A2Methods_UArray2 dest, double degrees,
+                            Rotate_Filter filter, unsigned maxval,
+                            PixelOps_T ops);
+
+#endif
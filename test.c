@@ -1,23 +1,51 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "mem.h"
 #include "uarray2b.h"
 #include "uarray2.h"
 #include "uarray.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "pnm.h"
+#include "pnmio.h"
+#include "transform.h"
+#include "bitmap.h"
+#include "pam.h"
+#include "dither.h"
+#include "parallel.h"
+
+/* image sizes for the packed formats: none a multiple of 64 except where
+   a 64 meets an odd side, so every edge case of the blocks comes up */
+static const int packed_sizes[][2] = {
+        { 1, 1 }, { 1, 70 }, { 70, 1 }, { 3, 5 }, { 63, 65 }, { 65, 63 },
+        { 64, 37 }, { 100, 129 }, { 130, 67 }
+};
+#define NSIZES (int)(sizeof(packed_sizes) / sizeof(packed_sizes[0]))
 
 void test_new();
 void test_free();
 void print_element(int col, int row, UArray2b_T array2b, void *elem, void *cl);
 void populate(UArray2b_T array2b);
 void populate_element(int col, int row, UArray2b_T array2b, void *elem, void *cl);
+static void test_bitmap_transforms(void);
+static void test_pam_transforms(void);
+static void test_pam_over(void);
+static void test_dither(void);
 
 int main()
 {
-        UArray2b_T array2b = UArray2b_new(0, 10, sizeof(int), 4);
+        UArray2b_T array2b = UArray2b_new(10, 10, sizeof(int), 4);
         populate(array2b);
         int count = 0;
         UArray2b_map(array2b, print_element, &count);
+        assert(count == 100);
+        UArray2b_free(&array2b);
+        test_bitmap_transforms();
+        test_pam_transforms();
+        test_pam_over();
+        test_dither();
         printf("Test passed!\n");
         return 0;
 }
@@ -66,4 +94,479 @@ void populate_element(int col, int row, UArray2b_T array2b, void *elem, void *cl
     int *count = (int *)cl;
     *(int *)elem = *count;
     (*count)++;
-}
\ No newline at end of file
+}
+
+
+/* the width x height image that the generic Pnm_rgb path makes from pixels
+   by transform */
+static A2Methods_UArray2 generic_transform(const Transform *transform,
+                                           A2Methods_UArray2 pixels)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        return Transform_apply(transform, methods, methods->map_default,
+                               Transform_SCATTER, pixels);
+}
+
+/*
+ * Name: random_pbm
+ *
+ * Description: reads a random raw PBM from memory through Bitmap_read
+ *
+ * Parameters:
+ *           int width, height: the size of the image
+ *           unsigned char **bits: set to the rows as in the file, to be
+ *           freed by the caller
+ *
+ * Returns: the image
+ *
+ * Notes: the padding bits at the end of every row are random too, as a
+ * file is free to leave them
+ */
+static Bitmap_T random_pbm(int width, int height, unsigned char **bits)
+{
+        size_t row_bytes = ((size_t)width + 7) / 8;
+        size_t size = row_bytes * height;
+        char header[32];
+        int header_len = sprintf(header, "P4\n%d %d\n", width, height);
+        char *file = malloc(header_len + size);
+        *bits = malloc(size);
+        assert(file != NULL && *bits != NULL);
+        for (size_t k = 0; k < size; k++) {
+                (*bits)[k] = rand() & 0xff;
+        }
+        memcpy(file, header, header_len);
+        memcpy(file + header_len, *bits, size);
+
+        FILE *fp = fmemopen(file, header_len + size, "rb");
+        assert(fp != NULL);
+        int magic = PnmIO_magic(fp);
+        Bitmap_T bitmap = Bitmap_read(fp, magic);
+        fclose(fp);
+        free(file);
+        return bitmap;
+}
+
+/* bitmap as written by Bitmap_write must hold its pixels and, past the
+   width of each row, only 0 bits */
+static void check_pbm_rows(Bitmap_T bitmap)
+{
+        char *file;
+        size_t size;
+        FILE *fp = open_memstream(&file, &size);
+        assert(fp != NULL);
+        Bitmap_write(fp, bitmap);
+        fclose(fp);
+
+        int width = Bitmap_width(bitmap), height = Bitmap_height(bitmap);
+        size_t row_bytes = ((size_t)width + 7) / 8;
+        assert(size >= row_bytes * height);
+        const unsigned char *bits = (unsigned char *)file + size -
+                                    row_bytes * height;
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < (int)row_bytes * 8; i++) {
+                        int bit = bits[j * row_bytes + i / 8] >>
+                                  (7 - i % 8) & 1;
+                        assert(bit == (i < width ? Bitmap_get(bitmap, i, j)
+                                                 : 0));
+                }
+        }
+        free(file);
+}
+
+/* every exact operation on PBMs of awkward sizes, checked pixel by pixel
+   against the generic Pnm_rgb path (black is 0 there) */
+static void test_bitmap_transforms(void)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        srand(48);
+        for (int s = 0; s < NSIZES; s++) {
+                int width = packed_sizes[s][0], height = packed_sizes[s][1];
+                unsigned char *bits;
+                Bitmap_T bitmap = random_pbm(width, height, &bits);
+                size_t row_bytes = ((size_t)width + 7) / 8;
+                for (int j = 0; j < height; j++) {
+                        for (int i = 0; i < width; i++) {
+                                int bit = bits[j * row_bytes + i / 8] >>
+                                          (7 - i % 8) & 1;
+                                assert(Bitmap_get(bitmap, i, j) == bit);
+                        }
+                }
+                free(bits);
+                check_pbm_rows(bitmap);
+                A2Methods_UArray2 pixels = Bitmap_pixels(bitmap, methods);
+
+                for (int t = 0; t < Transform_count; t++) {
+                        const Transform *transform = &Transform_table[t];
+                        Bitmap_T packed = Bitmap_transform(bitmap, transform);
+                        A2Methods_UArray2 expected =
+                                generic_transform(transform, pixels);
+                        int w = methods->width(expected);
+                        int h = methods->height(expected);
+                        assert(Bitmap_width(packed) == w);
+                        assert(Bitmap_height(packed) == h);
+                        for (int j = 0; j < h; j++) {
+                                for (int i = 0; i < w; i++) {
+                                        struct Pnm_rgb *p =
+                                                methods->at(expected, i, j);
+                                        assert(Bitmap_get(packed, i, j) ==
+                                               (p->red == 0));
+                                }
+                        }
+                        check_pbm_rows(packed);
+                        methods->free(&expected);
+                        Bitmap_free(&packed);
+                }
+                methods->free(&pixels);
+                Bitmap_free(&bitmap);
+        }
+}
+
+/*
+ * Name: read_pam
+ *
+ * Description: reads a PAM from memory through Pam_read
+ *
+ * Parameters:
+ *           int width, height, depth: the shape of the image
+ *           unsigned maxval: its maxval
+ *           const unsigned *values: the samples as in the file, depth to a
+ *           pixel, row by row
+ *
+ * Returns: the image
+ */
+static Pam_T read_pam(int width, int height, int depth, unsigned maxval,
+                      const unsigned *values)
+{
+        static const char *tuple_types[] = {
+                "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA"
+        };
+        char *file;
+        size_t size;
+        FILE *fp = open_memstream(&file, &size);
+        assert(fp != NULL);
+        fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL %u\n"
+                    "TUPLTYPE %s\nENDHDR\n", width, height, depth, maxval,
+                tuple_types[depth - 1]);
+        for (long k = 0; k < (long)width * height * depth; k++) {
+                if (maxval > 255) {
+                        putc(values[k] >> 8, fp);
+                }
+                putc(values[k] & 0xff, fp);
+        }
+        fclose(fp);
+
+        fp = fmemopen(file, size, "rb");
+        assert(fp != NULL);
+        assert(PnmIO_magic(fp) == '7');
+        Pam_T pam = Pam_read(fp);
+        fclose(fp);
+        free(file);
+        return pam;
+}
+
+/* count random samples in [0, maxval] */
+static unsigned *random_samples(long count, unsigned maxval)
+{
+        unsigned *values = malloc(count * sizeof(*values));
+        assert(values != NULL);
+        for (long k = 0; k < count; k++) {
+                values[k] = (unsigned)(rand() & 0xffff) * (maxval + 1) >> 16;
+        }
+        return values;
+}
+
+/* one channel of pam (0 to 3: red, green, blue, alpha) in the red of
+   Pnm_rgb pixels, for the generic path to move */
+static A2Methods_UArray2 pam_channel(Pam_T pam, int channel)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        A2Methods_UArray2 pixels = methods->new(Pam_width(pam),
+                                                Pam_height(pam),
+                                                sizeof(struct Pnm_rgb));
+        for (int j = 0; j < Pam_height(pam); j++) {
+                for (int i = 0; i < Pam_width(pam); i++) {
+                        struct Pnm_rgb *p = methods->at(pixels, i, j);
+                        p->red = p->green = p->blue =
+                                Pam_get(pam, i, j, channel);
+                }
+        }
+        return pixels;
+}
+
+/* every exact operation on PAMs of every depth, one and two bytes a
+   sample, checked channel by channel against the generic Pnm_rgb path */
+static void test_pam_transforms(void)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        static const unsigned maxvals[] = { 255, 65535 };
+        srand(49);
+        for (int n = 0; n < NSIZES * 8; n++) {
+                int s = n / 8, d = n / 2 % 4 + 1;
+                int width = packed_sizes[s][0], height = packed_sizes[s][1];
+                unsigned maxval = maxvals[n % 2];
+                unsigned *values = random_samples((long)width * height * d,
+                                                  maxval);
+                Pam_T pam = read_pam(width, height, d, maxval, values);
+                free(values);
+                assert(Pam_depth(pam) == d && Pam_maxval(pam) == maxval);
+                A2Methods_UArray2 colors = Pam_pixels(pam, methods);
+                A2Methods_UArray2 alpha = pam_channel(pam, 3);
+
+                for (int t = 0; t < Transform_count; t++) {
+                        const Transform *transform = &Transform_table[t];
+                        Pam_T packed = Pam_transform(pam, transform, NULL);
+                        A2Methods_UArray2 expected =
+                                generic_transform(transform, colors);
+                        A2Methods_UArray2 expected_alpha =
+                                generic_transform(transform, alpha);
+                        int w = methods->width(expected);
+                        int h = methods->height(expected);
+                        assert(Pam_width(packed) == w);
+                        assert(Pam_height(packed) == h);
+                        assert(Pam_depth(packed) == d);
+                        for (int j = 0; j < h; j++) {
+                                for (int i = 0; i < w; i++) {
+                                        struct Pnm_rgb *p =
+                                                methods->at(expected, i, j);
+                                        struct Pnm_rgb *a =
+                                                methods->at(expected_alpha,
+                                                            i, j);
+                                        assert(Pam_get(packed, i, j, 0) ==
+                                               p->red);
+                                        assert(Pam_get(packed, i, j, 1) ==
+                                               p->green);
+                                        assert(Pam_get(packed, i, j, 2) ==
+                                               p->blue);
+                                        assert(Pam_get(packed, i, j, 3) ==
+                                               a->red);
+                                }
+                        }
+                        methods->free(&expected);
+                        methods->free(&expected_alpha);
+                        Pam_free(&packed);
+                }
+                methods->free(&colors);
+                methods->free(&alpha);
+                Pam_free(&pam);
+        }
+}
+
+/*
+ * Name: check_over
+ *
+ * Description: checks one pixel of image composited over background
+ * against the straight-alpha formula, worked in doubles
+ *
+ * Parameters:
+ *           Pam_T result: the composite
+ *           Pam_T image, background: what it was made from
+ *           int i, j: the pixel
+ *
+ * Returns: nothing
+ *
+ * Notes: a transparent pixel must give the background and an opaque one
+ * the image exactly; a partial one may be 1 off, as the composite is
+ * worked in floats
+ */
+static void check_over(Pam_T result, Pam_T image, Pam_T background, int i,
+                       int j)
+{
+        double maxval = Pam_maxval(image);
+        unsigned alpha_s = Pam_get(image, i, j, 3);
+        double as = alpha_s / maxval;
+        double ab = Pam_get(background, i, j, 3) / maxval;
+        double ao = as + ab * (1 - as);
+        bool keeps_alpha = Pam_depth(result) % 2 == 0;
+        for (int c = 0; c < 3; c++) {
+                double cs = Pam_get(image, i, j, c);
+                double cb = Pam_get(background, i, j, c);
+                unsigned want = 0;
+                if (ao > 0) {
+                        want = (unsigned)((cs * as + cb * ab * (1 - as)) /
+                                          ao + 0.5);
+                }
+                unsigned got = Pam_get(result, i, j, c);
+                if (alpha_s == Pam_maxval(image)) {
+                        assert(got == (unsigned)cs);
+                } else if (alpha_s == 0 && ab > 0) {
+                        assert(got == (unsigned)cb);
+                } else {
+                        assert(got + 1 >= want && got <= want + 1);
+                }
+        }
+        unsigned want = keeps_alpha ? (unsigned)(ao * maxval + 0.5)
+                                    : Pam_maxval(image);
+        unsigned got = Pam_get(result, i, j, 3);
+        assert(got + 1 >= want && got <= want + 1);
+        if (alpha_s == Pam_maxval(image) || !keeps_alpha) {
+                assert(got == Pam_maxval(image));
+        }
+}
+
+/* -over: images whose pixels are transparent, partly transparent and
+   opaque in turn, moved by every exact operation and composited over
+   backgrounds of every depth */
+static void test_pam_over(void)
+{
+        static const unsigned maxvals[] = { 255, 65535 };
+        static const int sizes[][2] = { { 1, 1 }, { 65, 63 }, { 130, 67 } };
+        srand(50);
+        for (int n = 0; n < 3 * 8; n++) {
+                int s = n / 8, d = n / 2 % 4 + 1;
+                int width = sizes[s][0], height = sizes[s][1];
+                unsigned maxval = maxvals[n % 2];
+                long count = (long)width * height;
+                unsigned *values = random_samples(count * 4, maxval);
+                for (long k = 0; k < count; k++) {
+                        unsigned *alpha = &values[4 * k + 3];
+                        if (k % 3 == 0) {
+                                *alpha = 0;
+                        } else if (k % 3 == 1) {
+                                *alpha = maxval;
+                        } else if (*alpha == 0 || *alpha == maxval) {
+                                *alpha = maxval / 2;
+                        }
+                }
+                Pam_T image = read_pam(width, height, 4, maxval, values);
+                free(values);
+
+                for (int t = 0; t < Transform_count; t++) {
+                        const Transform *transform = &Transform_table[t];
+                        Pam_T moved = Pam_transform(image, transform, NULL);
+                        int w = Pam_width(moved), h = Pam_height(moved);
+                        values = random_samples((long)w * h * d, maxval);
+                        Pam_T background = read_pam(w, h, d, maxval, values);
+                        free(values);
+                        Pam_T result = Pam_transform(image, transform,
+                                                     background);
+                        assert(Pam_width(result) == w);
+                        assert(Pam_height(result) == h);
+                        assert(Pam_depth(result) == (d % 2 == 0 ? 4 : 3));
+                        for (int j = 0; j < h; j++) {
+                                for (int i = 0; i < w; i++) {
+                                        check_over(result, moved, background,
+                                                   i, j);
+                                }
+                        }
+                        Pam_free(&result);
+                        Pam_free(&background);
+                        Pam_free(&moved);
+                }
+                Pam_free(&image);
+        }
+}
+
+/* a width x height image of random pixels in [0, maxval] */
+static A2Methods_UArray2 random_pixels(int width, int height,
+                                       unsigned maxval)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        A2Methods_UArray2 pixels = methods->new(width, height,
+                                                sizeof(struct Pnm_rgb));
+        unsigned *values = random_samples(3L * width * height, maxval);
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        struct Pnm_rgb *p = methods->at(pixels, i, j);
+                        long k = 3 * ((long)j * width + i);
+                        p->red   = values[k];
+                        p->green = values[k + 1];
+                        p->blue  = values[k + 2];
+                }
+        }
+        free(values);
+        return pixels;
+}
+
+/* a copy of pixels */
+static A2Methods_UArray2 copy_pixels(A2Methods_UArray2 pixels)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        int width = methods->width(pixels), height = methods->height(pixels);
+        A2Methods_UArray2 copy = methods->new(width, height,
+                                              sizeof(struct Pnm_rgb));
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        *(struct Pnm_rgb *)methods->at(copy, i, j) =
+                                *(struct Pnm_rgb *)methods->at(pixels, i, j);
+                }
+        }
+        return copy;
+}
+
+/* Floyd-Steinberg dithering: a case worked by hand, and the same output,
+   pixels and bits, for any number of threads */
+static void test_dither(void)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        int saved_threads = Parallel_threads();
+
+        /* gray, maxval 16 to 1, worked by hand: with a step of 16 every
+           error has a small power of two below it, so floats hold it
+           exactly, and changing any of the four weights changes at least
+           one pixel */
+        static const unsigned gray_in[3][3] = { { 10, 0, 15 },
+                                                { 13, 13, 13 },
+                                                { 11, 15, 6 } };
+        static const unsigned gray_out[3][3] = { { 1, 0, 1 },
+                                                 { 1, 1, 1 },
+                                                 { 1, 0, 0 } };
+        A2Methods_UArray2 gray = methods->new(3, 3, sizeof(struct Pnm_rgb));
+        for (int j = 0; j < 3; j++) {
+                for (int i = 0; i < 3; i++) {
+                        struct Pnm_rgb *p = methods->at(gray, i, j);
+                        p->red = p->green = p->blue = gray_in[j][i];
+                }
+        }
+        Bitmap_T bitmap = Dither_bitmap(methods, gray, 16);
+        Dither_maxval(methods, gray, 16, 1);
+        for (int j = 0; j < 3; j++) {
+                for (int i = 0; i < 3; i++) {
+                        struct Pnm_rgb *p = methods->at(gray, i, j);
+                        assert(p->red == gray_out[j][i]);
+                        assert(p->green == gray_out[j][i]);
+                        assert(p->blue == gray_out[j][i]);
+                        assert(Bitmap_get(bitmap, i, j) ==
+                               (gray_out[j][i] == 0));
+                }
+        }
+        Bitmap_free(&bitmap);
+        methods->free(&gray);
+
+        /* rows of several segments, so the wavefront has rows waiting on
+           one another */
+        static const int threads[] = { 1, 2, 7 };
+        srand(50);
+        A2Methods_UArray2 original = random_pixels(500, 60, 65535);
+        A2Methods_UArray2 first = NULL;
+        Bitmap_T first_bitmap = NULL;
+        for (int t = 0; t < 3; t++) {
+                Parallel_set_threads(threads[t]);
+                A2Methods_UArray2 image = copy_pixels(original);
+                Dither_maxval(methods, image, 65535, 255);
+                bitmap = Dither_bitmap(methods, original, 65535);
+                if (first == NULL) {
+                        first = image;
+                        first_bitmap = bitmap;
+                        continue;
+                }
+                for (int j = 0; j < 60; j++) {
+                        for (int i = 0; i < 500; i++) {
+                                struct Pnm_rgb *p = methods->at(image, i, j);
+                                struct Pnm_rgb *q = methods->at(first, i, j);
+                                assert(p->red == q->red);
+                                assert(p->green == q->green);
+                                assert(p->blue == q->blue);
+                                assert(p->red <= 255 && p->green <= 255 &&
+                                       p->blue <= 255);
+                                assert(Bitmap_get(bitmap, i, j) ==
+                                       Bitmap_get(first_bitmap, i, j));
+                        }
+                }
+                methods->free(&image);
+                Bitmap_free(&bitmap);
+        }
+        methods->free(&first);
+        Bitmap_free(&first_bitmap);
+        methods->free(&original);
+        Parallel_set_threads(saved_threads);
+}
@@ -0,0 +1,171 @@
+/****************************************************************
+ *
+ *                         trace.c
+ *
+ *       This source file implements the Chrome trace-event tracer
+ *       declared in trace.h.
+ *
+ *       Each thread lazily allocates a ring buffer the first time it
+ *       records an event and links it onto a global list (the only
+ *       step that takes a lock). Events are stored as begin ('B') and
+ *       end ('E') records with a CLOCK_MONOTONIC timestamp. At exit the
+ *       list is walked and every ring is written out oldest first; a
+ *       ring that wrapped around loses its oldest events and says how
+ *       many in the thread's metadata.
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "assert.h"
+#include "trace.h"
+
+#define TRACE_RING_SIZE (1 << 15)   /* events per thread */
+
+struct event {
+        const char *name;
+        const char *category;
+        uint64_t    timestamp;      /* nanoseconds, CLOCK_MONOTONIC */
+        int         x, y;           /* tile or band, -1 if none */
+        char        phase;          /* 'B' or 'E' */
+};
+
+struct ring {
+        int           tid;
+        uint64_t      count;        /* events ever recorded */
+        struct ring  *next;
+        struct event  events[TRACE_RING_SIZE];
+};
+
+int Trace_active = 0;
+
+static const char     *trace_filename;
+static uint64_t        trace_epoch;
+static struct ring    *rings;
+static int             next_tid = 1;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct ring *my_ring;
+
+static uint64_t now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* this thread's ring, allocated and registered on first use */
+static struct ring *thread_ring(void)
+{
+        if (my_ring == NULL) {
+                struct ring *ring = malloc(sizeof(*ring));
+                assert(ring != NULL);
+                ring->count = 0;
+                pthread_mutex_lock(&rings_lock);
+                ring->tid  = next_tid++;
+                ring->next = rings;
+                rings      = ring;
+                pthread_mutex_unlock(&rings_lock);
+                my_ring = ring;
+        }
+        return my_ring;
+}
+
+static void record(const char *name, const char *category, char phase,
+                   int x, int y)
+{
+        uint64_t timestamp = now();
+        struct ring *ring = thread_ring();
+        struct event *e = &ring->events[ring->count % TRACE_RING_SIZE];
+        e->name      = name;
+        e->category  = category;
+        e->timestamp = timestamp;
+        e->x         = x;
+        e->y         = y;
+        e->phase     = phase;
+        ring->count++;
+}
+
+void Trace_Begin(const char *name, const char *category, int x, int y)
+{
+        record(name, category, 'B', x, y);
+}
+
+void Trace_End(const char *name, const char *category)
+{
+        record(name, category, 'E', -1, -1);
+}
+
+/*
+ *  write_trace
+ *
+ *  atexit handler: writes every ring to the trace file as a JSON object
+ *  with a "traceEvents" array. Timestamps are microseconds since
+ *  Trace_Enable, as the format expects.
+ */
+static void write_trace(void)
+{
+        Trace_active = 0;
+        FILE *fp = fopen(trace_filename, "w");
+        if (fp == NULL) {
+                fprintf(stderr, "Error opening file: %s\n", trace_filename);
+                return;
+        }
+
+        int pid = (int)getpid();
+        const char *separator = "";
+        fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+
+        pthread_mutex_lock(&rings_lock);
+        for (struct ring *ring = rings; ring != NULL; ring = ring->next) {
+                uint64_t first = 0;
+                if (ring->count > TRACE_RING_SIZE) {
+                        first = ring->count - TRACE_RING_SIZE;
+                }
+                fprintf(fp, "%s{\"ph\": \"M\", \"name\": \"thread_name\", "
+                            "\"pid\": %d, \"tid\": %d, \"args\": "
+                            "{\"name\": \"thread %d\", \"dropped\": %lu}}",
+                        separator, pid, ring->tid, ring->tid,
+                        (unsigned long)first);
+                separator = ",\n";
+
+                for (uint64_t n = first; n < ring->count; n++) {
+                        struct event *e = &ring->events[n % TRACE_RING_SIZE];
+                        double ts = (e->timestamp - trace_epoch) / 1000.0;
+                        fprintf(fp, "%s{\"ph\": \"%c\", \"name\": \"%s\", "
+                                    "\"cat\": \"%s\", \"pid\": %d, "
+                                    "\"tid\": %d, \"ts\": %.3f",
+                                separator, e->phase, e->name, e->category,
+                                pid, ring->tid, ts);
+                        if (e->x >= 0) {
+                                fprintf(fp, ", \"args\": {\"x\": %d, "
+                                            "\"y\": %d}", e->x, e->y);
+                        }
+                        fprintf(fp, "}");
+                }
+        }
+        pthread_mutex_unlock(&rings_lock);
+
+        fprintf(fp, "\n]}\n");
+        fclose(fp);
+}
+
+/*
+ *  Trace_Enable
+ *
+ *  Turns tracing on and arranges for the trace to be written to
+ *  filename when the program exits. Calling it twice is a checked
+ *  runtime error.
+ */
+void Trace_Enable(const char *filename)
+{
+        assert(filename != NULL);
+        assert(!Trace_active && trace_filename == NULL);
+        trace_filename = filename;
+        trace_epoch    = now();
+        atexit(write_trace);
+        Trace_active = 1;
+}
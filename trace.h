@@ -0,0 +1,54 @@
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+/****************************************************************
+ *
+ *                         trace.h
+ *
+ *       Interface to an event tracer that writes Chrome trace-event
+ *       JSON (load it in chrome://tracing or Perfetto).
+ *
+ *       Usage:
+ *
+ *       Trace_Enable("trace.json");        once, early in main
+ *       TRACE_BEGIN("transform", "phase");
+ *         ... Do work to be traced here
+ *       TRACE_END("transform", "phase");
+ *
+ *       Every thread records into its own fixed-size ring buffer, so
+ *       recording an event takes no lock. When a buffer fills up the
+ *       oldest events are overwritten. All buffers are written to the
+ *       trace file once, when the program exits.
+ *
+ *       The TRACE_ macros cost one test of Trace_active when tracing is
+ *       off. The x and y arguments of TRACE_BEGIN_XY identify a tile or
+ *       band and show up as event args in the viewer.
+ *
+ *       Names and categories are not copied: they must be string
+ *       literals or otherwise outlive the program.
+ *
+ *****************************************************************/
+
+extern int Trace_active;
+
+void Trace_Enable(const char *filename);
+
+void Trace_Begin(const char *name, const char *category, int x, int y);
+
+void Trace_End(const char *name, const char *category);
+
+#define TRACE_BEGIN(NAME, CATEGORY) do {                        \
+        if (Trace_active)                                       \
+                Trace_Begin((NAME), (CATEGORY), -1, -1);        \
+} while (0)
+
+#define TRACE_BEGIN_XY(NAME, CATEGORY, X, Y) do {               \
+        if (Trace_active)                                       \
+                Trace_Begin((NAME), (CATEGORY), (X), (Y));      \
+} while (0)
+
+#define TRACE_END(NAME, CATEGORY) do {                          \
+        if (Trace_active)                                       \
+                Trace_End((NAME), (CATEGORY));                  \
+} while (0)
+
+#endif
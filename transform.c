@@ -0,0 +1,950 @@
+/*
+ *     transform.c
+ *     Locality
+ *
+ *     This file implements the geometric transformations used by ppmtrans
+ *     (rotation, flipping, transposing). Every transformation is an apply
+ *     function that is handed to an A2Methods map function over the
+ *     original image and writes each pixel to its new position in the
+ *     image stored in the closure. Each one also has a gather function,
+ *     mapped over the new image instead, that reads every pixel from its
+ *     old position in the original image stored in the closure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "assert.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "a2special.h"
+#include "a2cursor.h"
+#include "uarray2.h"
+#include "uarray2b.h"
+#include "pnm.h"
+#include "transform.h"
+
+/* the specialized kernels, for Pnm_rgb pixels, four per operation;
+   rotate0 and vertical move whole rows, so their row-major kernels are
+   the row-span copies below */
+A2SPECIAL_DEFINE_PLAIN_COL(rotate0_plain_col, struct Pnm_rgb,
+                           A2SPECIAL_ROTATE0)
+A2SPECIAL_DEFINE_PLAIN_CO(rotate0_plain_co, struct Pnm_rgb,
+                          A2SPECIAL_ROTATE0)
+A2SPECIAL_DEFINE_BLOCKED(rotate0_blocked_any, struct Pnm_rgb,
+                         A2SPECIAL_ROTATE0)
+A2SPECIAL_DEFINE_ALL(rotate90,   struct Pnm_rgb, A2SPECIAL_ROTATE90)
+A2SPECIAL_DEFINE_ALL(rotate180,  struct Pnm_rgb, A2SPECIAL_ROTATE180)
+A2SPECIAL_DEFINE_ALL(rotate270,  struct Pnm_rgb, A2SPECIAL_ROTATE270)
+A2SPECIAL_DEFINE_ALL(horizontal, struct Pnm_rgb, A2SPECIAL_FLIP_HORIZONTAL)
+A2SPECIAL_DEFINE_PLAIN_COL(vertical_plain_col, struct Pnm_rgb,
+                           A2SPECIAL_FLIP_VERTICAL)
+A2SPECIAL_DEFINE_PLAIN_CO(vertical_plain_co, struct Pnm_rgb,
+                          A2SPECIAL_FLIP_VERTICAL)
+A2SPECIAL_DEFINE_BLOCKED(vertical_blocked, struct Pnm_rgb,
+                         A2SPECIAL_FLIP_VERTICAL)
+A2SPECIAL_DEFINE_ALL(transpose,  struct Pnm_rgb, A2SPECIAL_TRANSPOSE)
+
+/* and their gathering counterparts; rotate0 and vertical copy rows in the
+   same order either way, so they gather with their scattering kernels */
+A2SPECIAL_DEFINE_ALL_GATHER(rotate90,   struct Pnm_rgb,
+                            A2SPECIAL_GATHER_ROTATE90)
+A2SPECIAL_DEFINE_ALL_GATHER(rotate180,  struct Pnm_rgb,
+                            A2SPECIAL_GATHER_ROTATE180)
+A2SPECIAL_DEFINE_ALL_GATHER(rotate270,  struct Pnm_rgb,
+                            A2SPECIAL_GATHER_ROTATE270)
+A2SPECIAL_DEFINE_ALL_GATHER(horizontal, struct Pnm_rgb,
+                            A2SPECIAL_GATHER_FLIP_HORIZONTAL)
+A2SPECIAL_DEFINE_ALL_GATHER(transpose,  struct Pnm_rgb,
+                            A2SPECIAL_GATHER_TRANSPOSE)
+
+/* and the streaming versions of the gathering row-major and blocked
+   kernels, for images larger than the last-level cache */
+A2SPECIAL_DEFINE_ALL_STREAM(rotate0,    struct Pnm_rgb,
+                            A2SPECIAL_GATHER_ROTATE0)
+A2SPECIAL_DEFINE_ALL_STREAM(rotate90,   struct Pnm_rgb,
+                            A2SPECIAL_GATHER_ROTATE90)
+A2SPECIAL_DEFINE_ALL_STREAM(rotate180,  struct Pnm_rgb,
+                            A2SPECIAL_GATHER_ROTATE180)
+A2SPECIAL_DEFINE_ALL_STREAM(rotate270,  struct Pnm_rgb,
+                            A2SPECIAL_GATHER_ROTATE270)
+A2SPECIAL_DEFINE_ALL_STREAM(horizontal, struct Pnm_rgb,
+                            A2SPECIAL_GATHER_FLIP_HORIZONTAL)
+A2SPECIAL_DEFINE_ALL_STREAM(vertical,   struct Pnm_rgb,
+                            A2SPECIAL_GATHER_FLIP_VERTICAL)
+A2SPECIAL_DEFINE_ALL_STREAM(transpose,  struct Pnm_rgb,
+                            A2SPECIAL_GATHER_TRANSPOSE)
+
+/*
+ * gather apply functions, one per operation: called on each pixel (i, j)
+ * of the new image, with the original image in the closure, they copy in
+ * the original pixel that lands on (i, j)
+ */
+#define GATHER_APPLY(NAME, GOP)                                              \
+static void NAME(int i, int j, A2Methods_UArray2 array2, void *elem,         \
+                 void *cl)                                                   \
+{                                                                            \
+        (void)array2;                                                        \
+        struct closure *info = cl;                                           \
+        int width  = info->methods->width(info->array2);                     \
+        int height = info->methods->height(info->array2);                    \
+        int si, sj;                                                          \
+        (void)width;                                                         \
+        (void)height;                                                        \
+        GOP(i, j, width, height, si, sj);                                    \
+        Pnm_rgb new_pixel = elem;                                            \
+        *new_pixel = *(Pnm_rgb)info->methods->at(info->array2, si, sj);      \
+}
+
+GATHER_APPLY(gatherRotate0,        A2SPECIAL_GATHER_ROTATE0)
+GATHER_APPLY(gatherRotate90,       A2SPECIAL_GATHER_ROTATE90)
+GATHER_APPLY(gatherRotate180,      A2SPECIAL_GATHER_ROTATE180)
+GATHER_APPLY(gatherRotate270,      A2SPECIAL_GATHER_ROTATE270)
+GATHER_APPLY(gatherFlipHorizontal, A2SPECIAL_GATHER_FLIP_HORIZONTAL)
+GATHER_APPLY(gatherFlipVertical,   A2SPECIAL_GATHER_FLIP_VERTICAL)
+GATHER_APPLY(gatherTranspose,      A2SPECIAL_GATHER_TRANSPOSE)
+
+/* copy row j of the source to row j of the destination in cl */
+static void copy_row(int j, int width, A2Methods_UArray2 array2,
+                     A2Methods_Object *row, void *cl)
+{
+        (void)array2;
+        if (width > 0) {
+                memcpy(UArray2_at(cl, 0, j), row,
+                       (size_t)width * sizeof(struct Pnm_rgb));
+        }
+}
+
+/* copy row j of the source to row height - j - 1 of the destination */
+static void copy_row_flipped(int j, int width, A2Methods_UArray2 array2,
+                             A2Methods_Object *row, void *cl)
+{
+        if (width > 0) {
+                int height = UArray2_height(array2);
+                memcpy(UArray2_at(cl, 0, height - j - 1), row,
+                       (size_t)width * sizeof(struct Pnm_rgb));
+        }
+}
+
+static void rotate0_plain_row(void *source, void *dest)
+{
+        A2Plain_map_row_spans(source, copy_row, dest);
+}
+
+static void vertical_plain_row(void *source, void *dest)
+{
+        A2Plain_map_row_spans(source, copy_row_flipped, dest);
+}
+
+/* rotate0 between blocked images: with equal blocksizes both images have
+   the same layout, so they are walked in lockstep with cursors */
+static void rotate0_blocked(void *source, void *dest)
+{
+        if (UArray2b_blocksize(source) != UArray2b_blocksize(dest)) {
+                rotate0_blocked_any(source, dest);
+                return;
+        }
+        struct A2Cursor src, dst;
+        A2Cursor_start(&src, uarray2_methods_blocked, source);
+        A2Cursor_start(&dst, uarray2_methods_blocked, dest);
+        for (bool more = !src.done; more; ) {
+                *(struct Pnm_rgb *)A2Cursor_deref(&dst) =
+                        *(struct Pnm_rgb *)A2Cursor_deref(&src);
+                more = A2Cursor_advance(&src);
+                A2Cursor_advance(&dst);
+        }
+}
+
+/* the coordinate maps of a2special.h as functions */
+#define POSITION(NAME, MAP)                                                  \
+static void NAME(int i, int j, int width, int height, int *di, int *dj)      \
+{                                                                            \
+        (void)width;                                                         \
+        (void)height;                                                        \
+        MAP(i, j, width, height, *di, *dj);                                  \
+}
+
+POSITION(rotate0_position,    A2SPECIAL_ROTATE0)
+POSITION(rotate90_position,   A2SPECIAL_ROTATE90)
+POSITION(rotate180_position,  A2SPECIAL_ROTATE180)
+POSITION(rotate270_position,  A2SPECIAL_ROTATE270)
+POSITION(horizontal_position, A2SPECIAL_FLIP_HORIZONTAL)
+POSITION(vertical_position,   A2SPECIAL_FLIP_VERTICAL)
+POSITION(transpose_position,  A2SPECIAL_TRANSPOSE)
+
+#define KERNELS(P) { P##_plain_row, P##_plain_col, P##_plain_co, P##_blocked }
+#define GATHER_KERNELS(P) \
+        { P##_gather_plain_row, P##_gather_plain_col, P##_gather_plain_co, \
+          P##_gather_blocked }
+#define STREAM_KERNELS(P) \
+        { P##_stream_plain_row, NULL, NULL, P##_stream_blocked }
+
+/* every operation ppmtrans knows about, in the order they are benchmarked */
+const Transform Transform_table[] = {
+        { "rotate0",    rotate0,        gatherRotate0,        false,
+          rotate0_position,
+          KERNELS(rotate0),    KERNELS(rotate0),
+          STREAM_KERNELS(rotate0) },
+        { "rotate90",   rotate90,       gatherRotate90,       true,
+          rotate90_position,
+          KERNELS(rotate90),   GATHER_KERNELS(rotate90),
+          STREAM_KERNELS(rotate90) },
+        { "rotate180",  rotate180,      gatherRotate180,      false,
+          rotate180_position,
+          KERNELS(rotate180),  GATHER_KERNELS(rotate180),
+          STREAM_KERNELS(rotate180) },
+        { "rotate270",  rotate270,      gatherRotate270,      true,
+          rotate270_position,
+          KERNELS(rotate270),  GATHER_KERNELS(rotate270),
+          STREAM_KERNELS(rotate270) },
+        { "horizontal", flipHorizontal, gatherFlipHorizontal, false,
+          horizontal_position,
+          KERNELS(horizontal), GATHER_KERNELS(horizontal),
+          STREAM_KERNELS(horizontal) },
+        { "vertical",   flipVertical,   gatherFlipVertical,   false,
+          vertical_position,
+          KERNELS(vertical),   KERNELS(vertical),
+          STREAM_KERNELS(vertical) },
+        { "transpose",  doTranspose,    gatherTranspose,      true,
+          transpose_position,
+          KERNELS(transpose),  GATHER_KERNELS(transpose),
+          STREAM_KERNELS(transpose) },
+};
+
+static const char *traversal_names[] = { "scatter", "gather" };
+
+const int Transform_count = sizeof(Transform_table) /
+                            sizeof(Transform_table[0]);
+
+
+/*
+ * Name: Transform_find
+ * 
+ * Description: looks up an operation in Transform_table by its name
+ *
+ * Parameters:
+ *           const char *name: the name of the operation, e.g. "rotate90"
+ *        
+ * Returns: the matching table entry, or NULL if there is none
+ * 
+ * Expects: name is not NULL
+ * 
+ * Notes: results in a checked runtime error if name is NULL
+ */
+const Transform *Transform_find(const char *name)
+{
+        assert(name != NULL);
+        for (int i = 0; i < Transform_count; i++) {
+                if (strcmp(Transform_table[i].name, name) == 0) {
+                        return &Transform_table[i];
+                }
+        }
+        return NULL;
+}
+
+
+/*
+ * Name: Transform_new_image
+ * 
+ * Description: allocates the image an operation writes into: the source's
+ * dimensions, swapped for rotations by 90/270 and transpose, with the
+ * source's blocksize so that both images share one layout
+ *
+ * Parameters:
+ *           const Transform *transform: the operation to perform
+ *           A2Methods_T methods: the methods used for both images
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *        
+ * Returns: the new, uninitialized image, owned by the caller
+ * 
+ * Expects: all arguments are non-NULL
+ * 
+ * Notes: results in a checked runtime error if any argument is NULL
+ */
+A2Methods_UArray2 Transform_new_image(const Transform *transform,
+                                      A2Methods_T methods,
+                                      A2Methods_UArray2 source)
+{
+        assert(transform != NULL && methods != NULL && source != NULL);
+
+        int width  = methods->width(source);
+        int height = methods->height(source);
+        if (transform->swaps_dimensions) {
+                int temp = width;
+                width  = height;
+                height = temp;
+        }
+        return methods->new_with_blocksize(width, height,
+                                           sizeof(struct Pnm_rgb),
+                                           methods->blocksize(source));
+}
+
+
+/*
+ * Name: Transform_traversal
+ * 
+ * Description: looks up a traversal by its name, "scatter" or "gather"
+ *
+ * Parameters:
+ *           const char *name: the name to look up
+ *           Transform_Traversal *traversal: set to the traversal found
+ *        
+ * Returns: true if name is a traversal, false otherwise
+ * 
+ * Expects: name and traversal are not NULL
+ * 
+ * Notes: *traversal is left alone when name is unknown
+ */
+bool Transform_traversal(const char *name, Transform_Traversal *traversal)
+{
+        assert(name != NULL && traversal != NULL);
+        for (int i = 0; i < 2; i++) {
+                if (strcmp(traversal_names[i], name) == 0) {
+                        *traversal = (Transform_Traversal)i;
+                        return true;
+                }
+        }
+        return false;
+}
+
+
+/* the name of a traversal, as accepted by Transform_traversal */
+const char *Transform_traversal_name(Transform_Traversal traversal)
+{
+        assert(traversal == Transform_SCATTER ||
+               traversal == Transform_GATHER);
+        return traversal_names[traversal];
+}
+
+
+/*
+ * Name: Transform_choose_traversal
+ * 
+ * Description: picks the traversal that keeps writes to the new image
+ * sequential where one side of the copy has to be strided. Only the
+ * operations that swap dimensions have a strided side. Walking the
+ * original image row by row would write the new image a column at a time,
+ * so row-major maps gather. Column-major maps already write a row at a
+ * time when they scatter. In block-major maps both sides of the copy stay
+ * within one block of each image, and they keep scattering
+ *
+ * Parameters:
+ *           const Transform *transform: the operation to perform
+ *           A2Methods_T methods: the methods used for both images
+ *           A2Methods_mapfun *map: the traversal order
+ *        
+ * Returns: Transform_GATHER or Transform_SCATTER
+ * 
+ * Expects: transform and methods are not NULL
+ * 
+ * Notes: operations that keep rows as rows scatter, since both sides of
+ * their copy are sequential either way. bench -traversals compares both
+ * traversals on a given machine
+ */
+Transform_Traversal Transform_choose_traversal(const Transform *transform,
+                                               A2Methods_T methods,
+                                               A2Methods_mapfun *map)
+{
+        assert(transform != NULL && methods != NULL);
+        if (transform->swaps_dimensions && map != NULL &&
+            map == methods->map_row_major) {
+                return Transform_GATHER;
+        }
+        return Transform_SCATTER;
+}
+
+
+/*
+ * Name: Transform_map
+ * 
+ * Description: copies every pixel of source into its new position in dest
+ * by mapping one of the operation's apply functions. Scattering maps the
+ * apply function over source, gathering maps the gather function over dest
+ *
+ * Parameters:
+ *           const Transform *transform: the operation to perform
+ *           A2Methods_T methods: the methods used for both images
+ *           A2Methods_mapfun *map: the order in which the walked image is
+ *                                  visited
+ *           Transform_Traversal traversal: which image map walks
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           A2Methods_UArray2 dest: an image from Transform_new_image
+ *        
+ * Returns: nothing
+ * 
+ * Expects: all arguments are non-NULL and map belongs to methods
+ * 
+ * Notes: results in a checked runtime error if any argument is NULL
+ */
+void Transform_map(const Transform *transform, A2Methods_T methods,
+                   A2Methods_mapfun *map, Transform_Traversal traversal,
+                   A2Methods_UArray2 source, A2Methods_UArray2 dest)
+{
+        assert(transform != NULL && methods != NULL);
+        assert(map != NULL && source != NULL && dest != NULL);
+
+        if (traversal == Transform_GATHER) {
+                struct closure infoGet = {methods, source};
+                map(dest, transform->gather, &infoGet);
+        } else {
+                struct closure infoGet = {methods, dest};
+                map(source, transform->apply, &infoGet);
+        }
+}
+
+
+/*
+ * Name: Transform_find_kernel
+ * 
+ * Description: finds the compile-time specialized kernel that does the same
+ * work as Transform_map with the same arguments: the plain row-major,
+ * column-major or cache-oblivious kernel for the plain methods, or the
+ * blocked kernel for the blocked methods' block-major map
+ *
+ * Parameters:
+ *           const Transform *transform: the operation to perform
+ *           A2Methods_T methods: the methods used for both images
+ *           A2Methods_mapfun *map: the order the walked image is visited
+ *           Transform_Traversal traversal: which image is walked
+ *        
+ * Returns: the kernel, or NULL if there is none for this combination (for
+ * instance when methods is a wrapper around the plain or blocked methods)
+ * 
+ * Expects: transform and methods are not NULL
+ * 
+ * Notes: the kernels only handle struct Pnm_rgb elements
+ */
+Transform_kernel *Transform_find_kernel(const Transform *transform,
+                                        A2Methods_T methods,
+                                        A2Methods_mapfun *map,
+                                        Transform_Traversal traversal)
+{
+        assert(transform != NULL && methods != NULL);
+        const Transform_kernels *kernels = &transform->scatter_kernels;
+        if (traversal == Transform_GATHER) {
+                kernels = &transform->gather_kernels;
+        }
+        if (methods == uarray2_methods_plain) {
+                if (map == methods->map_row_major) {
+                        return kernels->plain_row;
+                } else if (map == methods->map_col_major) {
+                        return kernels->plain_col;
+                } else if (map == A2Plain_map_cache_oblivious) {
+                        return kernels->plain_co;
+                }
+        } else if (methods == uarray2_methods_blocked) {
+                if (map == methods->map_block_major) {
+                        return kernels->blocked;
+                }
+        }
+        return NULL;
+}
+
+
+/*
+ * Name: Transform_find_stream_kernel
+ * 
+ * Description: finds the gathering kernel that writes the new image with
+ * non-temporal stores, for a plain row-major or blocked block-major map.
+ * Those are the kernels that write the new image sequentially, so the
+ * streaming stores fill whole cache lines
+ *
+ * Parameters:
+ *           const Transform *transform: the operation to perform
+ *           A2Methods_T methods: the methods used for both images
+ *           A2Methods_mapfun *map: the order the new image is visited
+ *        
+ * Returns: the kernel, which gathers, or NULL if there is none for this
+ * combination
+ * 
+ * Expects: transform and methods are not NULL
+ * 
+ * Notes: only worth it when the new image does not fit in the last-level
+ * cache (see Transform_cache_bytes); on targets without SSE2 the kernels
+ * fall back to ordinary stores
+ */
+Transform_kernel *Transform_find_stream_kernel(const Transform *transform,
+                                               A2Methods_T methods,
+                                               A2Methods_mapfun *map)
+{
+        assert(transform != NULL && methods != NULL);
+        if (methods == uarray2_methods_plain &&
+            map == methods->map_row_major) {
+                return transform->stream_kernels.plain_row;
+        } else if (methods == uarray2_methods_blocked &&
+                   map == methods->map_block_major) {
+                return transform->stream_kernels.blocked;
+        }
+        return NULL;
+}
+
+
+/*
+ * Name: Transform_cache_bytes
+ * 
+ * Description: returns the size of the last-level data cache, the point
+ * past which an output image evicts its own source
+ *
+ * Parameters: none
+ *        
+ * Returns: the size in bytes as reported by the C library, or 8 MB when
+ * it is not known
+ * 
+ * Expects: nothing
+ * 
+ * Notes: the size is looked up once
+ */
+long Transform_cache_bytes(void)
+{
+        static long bytes = 0;
+        if (bytes == 0) {
+                long size = -1;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+                size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+                if (size <= 0) {
+                        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+                }
+#endif
+                bytes = size > 0 ? size : 8L << 20;
+        }
+        return bytes;
+}
+
+
+/* where a region's blocks are copied to, and from where */
+struct region {
+        A2Methods_UArray2 dest;
+        int col, row;           /* the region's origin in the source */
+        int size, blocksize;    /* of both arrays */
+};
+
+/* copy a part of a source block into dest, a run of each part row at a
+   time; a run ends where a row of a dest block does */
+static void copy_part(int col, int row, int width, int height,
+                      A2Methods_UArray2 array2, A2Methods_Object *first,
+                      void *cl)
+{
+        (void)array2;
+        struct region *region = cl;
+        int bs = region->blocksize, size = region->size;
+        for (int r = 0; r < height; r++) {
+                const char *src = (char *)first + (size_t)r * bs * size;
+                int di = col - region->col, dj = row + r - region->row;
+                for (int c = 0; c < width; ) {
+                        int run = bs - (di + c) % bs;
+                        run = run < width - c ? run : width - c;
+                        memcpy(UArray2b_at(region->dest, di + c, dj),
+                               src + (size_t)c * size, (size_t)run * size);
+                        c += run;
+                }
+        }
+}
+
+
+/*
+ * Name: Transform_region
+ * 
+ * Description: makes the width x height region at (col, row) of source an
+ * image of its own, for the operations to work on. A plain image gives a
+ * view that shares source's pixels (A2Plain_view); a blocked image gives a
+ * copy with the same blocksize, made from only the blocks the region
+ * overlaps (A2Blocked_map_region). Other suites are copied pixel by pixel
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of source
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           int col, row: the region's top-left pixel
+ *           int width, height: the size of the region
+ *        
+ * Returns: the region, to be freed by the caller with methods->free
+ * before source is
+ * 
+ * Expects: methods and source are non-NULL and the region lies inside
+ * source
+ * 
+ * Notes: results in a checked runtime error for a NULL argument or a
+ * region outside source
+ */
+A2Methods_UArray2 Transform_region(A2Methods_T methods,
+                                   A2Methods_UArray2 source, int col,
+                                   int row, int width, int height)
+{
+        assert(methods != NULL && source != NULL);
+        assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+        assert(col + width <= methods->width(source) &&
+               row + height <= methods->height(source));
+
+        if (methods == uarray2_methods_plain) {
+                return A2Plain_view(source, col, row, width, height);
+        }
+        int size = methods->size(source);
+        A2Methods_UArray2 dest = methods->new_with_blocksize(
+                width, height, size, methods->blocksize(source));
+        if (methods == uarray2_methods_blocked) {
+                struct region region = { dest, col, row, size,
+                                         methods->blocksize(source) };
+                A2Blocked_map_region(source, col, row, width, height,
+                                     copy_part, &region);
+        } else {
+                for (int j = 0; j < height; j++) {
+                        for (int i = 0; i < width; i++) {
+                                memcpy(methods->at(dest, i, j),
+                                       methods->at(source, col + i, row + j),
+                                       size);
+                        }
+                }
+        }
+        return dest;
+}
+
+
+/*
+ * Name: Transform_apply
+ * 
+ * Description: creates a new image with Transform_new_image and fills it
+ * with Transform_map
+ *
+ * Parameters:
+ *           const Transform *transform: the operation to perform
+ *           A2Methods_T methods: the methods used for both images
+ *           A2Methods_mapfun *map: the order the walked image is visited
+ *           Transform_Traversal traversal: which image is walked
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *        
+ * Returns: the transformed image, owned by the caller
+ * 
+ * Expects: all arguments are non-NULL and map belongs to methods
+ * 
+ * Notes: results in a checked runtime error if any argument is NULL
+ */
+A2Methods_UArray2 Transform_apply(const Transform *transform,
+                                  A2Methods_T methods, A2Methods_mapfun *map,
+                                  Transform_Traversal traversal,
+                                  A2Methods_UArray2 source)
+{
+        A2Methods_UArray2 new_image = Transform_new_image(transform, methods,
+                                                          source);
+        Transform_map(transform, methods, map, traversal, source, new_image);
+        return new_image;
+}
+
+
+/*
+ * Name: rotate0
+ * 
+ * Description: rotates the given UArray2 by 0 degrees. This is called in main 
+ * as an apply function, which means that it maps each element it is called on
+ * (each pixel) to the respective position in the rotated image
+ *
+ * Parameters:
+ *           int i: the column position the elem is at
+ *           int j: the row position the elem is at
+ *           A2Methods_UArray2 array2: the UArray containing the image
+ *           void *elem: the element at the previously mentioned location in 
+ *           the uarray containing the image
+ *           void *cl: the struct containing the methods and the second UArray2
+ *           we need to create the new image (rotated version)
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid position of the pixel
+ * 
+ * Notes: results in checked runtime error if: the column pos is a non-positive 
+ * value or the row is a non-positive value 
+ */
+void rotate0(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
+{
+        /* check for the bounds passed as parameters */
+        assert(i >= 0 && j >= 0);
+        (void)array2;
+        /* create instance of the struct to be able to access its information */
+        struct closure *info = cl;
+        int height = info->methods->height(array2);
+        int width = info->methods->width(array2);
+
+        /* check for the mapping coordinates to be inside of bounds */
+        if (i < 0 || i >= width || j < 0 || j >= height) {
+                fprintf(stderr, 
+                        "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
+                        i, j, height - j - 1, i);
+                exit(EXIT_FAILURE);
+        }
+
+        /* element in the original array*/
+        Pnm_rgb array_pixel = elem;
+        /* position where we want to store the element in the tranformed 
+        image */
+        Pnm_rgb rotated_pixel = info->methods->at(info->array2, i, j);
+        /* assign the element read to the respective position in the transformed
+        image */
+        *rotated_pixel = *array_pixel;
+}       
+
+
+/*
+ * Name: rotate90
+ * 
+ * Description: rotates the given UArray2 by 90 degrees. This is called in main 
+ * as an apply function, which means that it maps each element it is called on
+ * (each pixel) to the respective position in the rotated image
+ *
+ * Parameters:
+ *           int i: the column position the elem is at
+ *           int j: the row position the elem is at
+ *           A2Methods_UArray2 array2: the UArray containing the image
+ *           void *elem: the element at the previously mentioned location in the
+ *           uarray containing the image
+ *           void *cl: the struct containing the methods and the second UArray2
+ *           we need to create the new image (rotated version)
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid position of the pixel
+ * 
+ * Notes: results in checked runtime error if: the column pos is a non-positive 
+ * value or the row is a non-positive value 
+ */
+void rotate90(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
+{
+        assert(i >= 0 && j >= 0);
+        struct closure *info = cl;
+        int height = info->methods->height(array2);
+        int width = info->methods->width(array2);
+
+        if (height - j - 1 < 0 || height - j - 1 >= height || 
+            i < 0 || i >= width) {
+                fprintf(stderr, 
+                       "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
+                        i, j, height - j - 1, i);
+                exit(EXIT_FAILURE);
+        }
+
+        Pnm_rgb array_pixel = elem;
+        Pnm_rgb rotated_pixel = info->methods->at(info->array2, 
+                                                  height - j - 1, i);
+        *rotated_pixel = *array_pixel;
+}
+
+
+/*
+ * Name: rotate180
+ * 
+ * Description: rotates the given UArray2 by 180 degrees. This is called in main 
+ * as an apply function, which means that it maps each element it is called on
+ * (each pixel) to the respective position in the rotated image
+ *
+ * Parameters:
+ *           int i: the column position the elem is at
+ *           int j: the row position the elem is at
+ *           A2Methods_UArray2 array2: the UArray containing the image
+ *           void *elem: the element at the previously mentioned location in the
+ *           uarray containing the image
+ *           void *cl: the struct containing the methods and the second UArray2
+ *           we need to create the new image (rotated version)
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid position of the pixel
+ * 
+ * Notes: results in checked runtime error if: the column pos is a non-positive 
+ * value or the row is a non-positive value 
+ */
+void rotate180(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
+{
+        assert(i >= 0 && j >= 0);
+        struct closure *info = cl;
+        int height = info->methods->height(array2);
+        int width = info->methods->width(array2);
+
+        if (i < 0 || i >= width || j < 0 || j >= height) {
+                fprintf(stderr, 
+                "Error: Invalid pixel coordinates (%d, %d)\n",
+                i, j);
+        exit(EXIT_FAILURE);
+        }
+
+        Pnm_rgb array_pixel = elem;
+        Pnm_rgb rotated_pixel = info->methods->at(info->array2, width - i - 1, 
+                                                  height - j - 1);
+        *rotated_pixel = *array_pixel;
+}
+
+
+/*
+ * Name: rotate270
+ * 
+ * Description: rotates the given UArray2 by 270 degrees. This is called in main 
+ * as an apply function, which means that it maps each element it is called on
+ * (each pixel) to the respective position in the rotated image
+ *
+ * Parameters:
+ *           int i: the column position the elem is at
+ *           int j: the row position the elem is at
+ *           A2Methods_UArray2 array2: the UArray containing the image
+ *           void *elem: the element at the previously mentioned location in the
+ *           uarray containing the image
+ *           void *cl: the struct containing the methods and the second UArray2
+ *           we need to create the new image (rotated version)
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid position of the pixel
+ * 
+ * Notes: results in checked runtime error if: the column pos is a non-positive 
+ * value or the row is a non-positive value 
+ */
+void rotate270(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
+{
+        assert(i >= 0 && j >= 0);
+        struct closure *info = cl;
+        int height = info->methods->height(array2);
+        int width = info->methods->width(array2);
+
+        if (j < 0 || j >= height || width - i - 1 < 0 || 
+                                    width - i - 1 >= width) {
+                fprintf(stderr, 
+                       "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
+                        i, j, height - j - 1, i);
+                exit(EXIT_FAILURE);
+        }
+
+        Pnm_rgb array_pixel = elem;
+        Pnm_rgb rotated_pixel = info->methods->at(info->array2, j,
+                                                  width - i - 1);
+        *rotated_pixel = *array_pixel;
+}  
+
+
+/*
+ * Name: flipHorizontal
+ * 
+ * Description: flips the given UArray2 horizontally. This is called in main 
+ * as an apply function, which means that it maps each element it is called on
+ * (each pixel) to the respective position in the flipped image
+ *
+ * Parameters:
+ *           int i: the column position the elem is at
+ *           int j: the row position the elem is at
+ *           A2Methods_UArray2 array2: the UArray containing the image
+ *           void *elem: the element at the previously mentioned location in the
+ *           uarray containing the image
+ *           void *cl: the struct containing the methods and the second UArray2
+ *           we need to create the new image (flipped version)
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid position of the pixel
+ * 
+ * Notes: results in checked runtime error if: the column pos is a non-positive 
+ * value or the row is a non-positive value 
+ */
+void flipHorizontal(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
+{
+        assert(i >= 0 && j >= 0);
+        struct closure *info = cl;
+        int width = info->methods->width(array2);
+        int height = info->methods->height(array2);
+
+        if (width - i - 1 < 0 || width - i - 1 >= width || 
+            j < 0 || j >= height) {
+                fprintf(stderr, 
+                        "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
+                        i, j, width - i - 1, j);
+                exit(EXIT_FAILURE);
+        }
+
+        Pnm_rgb array_pixel = elem;
+        Pnm_rgb rotated_pixel = info->methods->at(info->array2,
+                                                  width - i - 1, j);
+        *rotated_pixel = *array_pixel;
+}
+
+
+/*
+ * Name: flipVertical
+ * 
+ * Description: flips the given UArray2 vertically. This is called in main 
+ * as an apply function, which means that it maps each element it is called on
+ * (each pixel) to the respective position in the flipped image
+ *
+ * Parameters:
+ *           int i: the column position the elem is at
+ *           int j: the row position the elem is at
+ *           A2Methods_UArray2 array2: the UArray containing the image
+ *           void *elem: the element at the previously mentioned location in the
+ *           uarray containing the image
+ *           void *cl: the struct containing the methods and the second UArray2
+ *           we need to create the new image (flipped version)
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid position of the pixel
+ * 
+ * Notes: results in checked runtime error if: the column pos is a non-positive 
+ * value or the row is a non-positive value 
+ */
+void flipVertical(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl)
+{
+        assert(i >= 0 && j >= 0);
+        struct closure *info = cl;
+        int height = info->methods->height(array2);
+
+        // if (i < 0 || i >= height || height - j - 1 < 0 || 
+        //                             height - j - 1 >= height) {
+        //         fprintf(stderr, 
+        //                 "Error: Invalid pixel coordinates (%d, %d)->(%d, %d)\n",
+        //                 i, j, i, height - j - 1);
+        //         exit(EXIT_FAILURE);
+        // }
+
+        Pnm_rgb array_pixel = elem;
+        Pnm_rgb rotated_pixel = info->methods->at(info->array2, i,
+                                                  height - j - 1);
+        *rotated_pixel = *array_pixel;
+}
+
+
+/*
+ * Name: doTranspose
+ * 
+ * Description: transposes the given UArray2. This is called in main 
+ * as an apply function, which means that it maps each element it is called on
+ * (each pixel) to the respective position in the transposed image
+ *
+ * Parameters:
+ *           int i: the column position the elem is at
+ *           int j: the row position the elem is at
+ *           A2Methods_UArray2 array2: the UArray containing the image
+ *           void *elem: the element at the previously mentioned location in the
+ *           uarray containing the image
+ *           void *cl: the struct containing the methods and the second UArray2
+ *           we need to create the new image (transposed version)
+ *        
+ * Returns: nothing
+ * 
+ * Expects: valid position of the pixel
+ * 
+ * Notes: results in checked runtime error if: the column pos is a non-positive 
+ * value or the row is a non-positive value 
+ */
+void doTranspose(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl) 
+{
+        assert(i >= 0 && j >= 0);
+        struct closure *info = cl;
+        int height = info->methods->height(array2);
+        int width = info->methods->width(array2);
+
+        if (i < 0 || i >= width || j < 0 || j >= height) {
+                fprintf(stderr, 
+                        "Error: Invalid pixel coordinates (%d, %d)\n",
+                        i, j);
+                exit(EXIT_FAILURE);
+        }
+
+        Pnm_rgb array_pixel = elem;
+        Pnm_rgb rotated_pixel = info->methods->at(info->array2, j, i);
+        *rotated_pixel = *array_pixel;
+}
+
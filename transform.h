@@ -0,0 +1,105 @@
+/*
+ *     transform.h
+ *     Locality
+ *
+ *     Interface to the geometric transformations performed by ppmtrans.
+ *     Each transformation is an A2Methods apply function that copies the
+ *     pixel it is called on into its new position in a second image, and
+ *     is described by an entry in Transform_table so that ppmtrans and the
+ *     benchmark driver can select operations by name.
+ *
+ *     Every transformation can run two ways. Scattering maps over the
+ *     original image and writes each pixel to its new position; gathering
+ *     maps over the new image and reads each pixel from its old position.
+ *     Rotating by 90 or 270 degrees or transposing makes one side of the
+ *     copy strided, and the traversal decides which side that is.
+ */
+
+#ifndef TRANSFORM_INCLUDED
+#define TRANSFORM_INCLUDED
+
+#include <stdbool.h>
+#include "a2methods.h"
+
+/* struct to allow us to access the second picture and A2 methods */
+struct closure {
+        A2Methods_T methods;
+        A2Methods_UArray2 array2;
+};
+
+/* which image the map walks */
+typedef enum {
+        Transform_SCATTER,      /* the original image */
+        Transform_GATHER        /* the new image */
+} Transform_Traversal;
+
+/* a whole map+apply specialized at compile time (see a2special.h) */
+typedef void Transform_kernel(A2Methods_UArray2 source, A2Methods_UArray2 dest);
+
+/* where pixel (i, j) of a width x height original lands in the new image */
+typedef void Transform_position(int i, int j, int width, int height, int *di,
+                                int *dj);
+
+/* the specialized kernels of one traversal */
+typedef struct Transform_kernels {
+        Transform_kernel *plain_row, *plain_col, *plain_co, *blocked;
+} Transform_kernels;
+
+/* one geometric operation: its name, scatter and gather apply functions,
+   output shape and coordinate map, plus specialized kernels for plain row-major,
+   column-major and cache-oblivious maps and blocked maps, for each
+   traversal, and gathering kernels that write with non-temporal stores
+   (row-major and blocked only) */
+typedef struct Transform {
+        const char *name;
+        A2Methods_applyfun *apply;      /* called on original pixels */
+        A2Methods_applyfun *gather;     /* called on new pixels */
+        bool swaps_dimensions;  /* output is height x width */
+        Transform_position *position;
+        Transform_kernels scatter_kernels, gather_kernels, stream_kernels;
+} Transform;
+
+extern const Transform Transform_table[];
+extern const int       Transform_count;
+
+extern const Transform *Transform_find(const char *name);
+extern A2Methods_UArray2 Transform_new_image(const Transform *transform,
+                                             A2Methods_T methods,
+                                             A2Methods_UArray2 source);
+extern bool Transform_traversal(const char *name,
+                                Transform_Traversal *traversal);
+extern const char *Transform_traversal_name(Transform_Traversal traversal);
+extern Transform_Traversal Transform_choose_traversal(
+        const Transform *transform, A2Methods_T methods,
+        A2Methods_mapfun *map);
+extern void Transform_map(const Transform *transform, A2Methods_T methods,
+                          A2Methods_mapfun *map, Transform_Traversal traversal,
+                          A2Methods_UArray2 source, A2Methods_UArray2 dest);
+extern Transform_kernel *Transform_find_kernel(const Transform *transform,
+                                               A2Methods_T methods,
+                                               A2Methods_mapfun *map,
+                                               Transform_Traversal traversal);
+extern Transform_kernel *Transform_find_stream_kernel(
+        const Transform *transform, A2Methods_T methods,
+        A2Methods_mapfun *map);
+extern long Transform_cache_bytes(void);
+extern A2Methods_UArray2 Transform_region(A2Methods_T methods,
+                                          A2Methods_UArray2 source, int col,
+                                          int row, int width, int height);
+extern A2Methods_UArray2 Transform_apply(const Transform *transform,
+                                         A2Methods_T methods,
+                                         A2Methods_mapfun *map,
+                                         Transform_Traversal traversal,
+                                         A2Methods_UArray2 source);
+
+/* apply functions, one per operation */
+void rotate0(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
+void rotate90(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
+void rotate180(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
+void rotate270(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
+void flipHorizontal(int i, int j, A2Methods_UArray2 array2, void *elem,
+                    void *cl);
+void flipVertical(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
+void doTranspose(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
+
+#endif
@@ -3,70 +3,111 @@
 
 #include "assert.h"
 #include "mem.h"
-#include "uarray.h"
 #include "uarray2.h"
+#include "hugemem.h"
+#include "trace.h"
 
 #define T UArray2_T
 
+/* rows (or columns) per event when a map is traced */
+#define TRACE_BAND 64
+
 /* 
  * Element (i, j) in the world of ideas maps to
- * rows[j][i] where the square brackets stand for access
- * to a Hanson UArray_T
+ * elems[j * stride + i * size]: the rows are stored one after the other
+ * in a single buffer from hugemem.c, so a large array can sit on huge
+ * pages and a row is always contiguous. An array's stride is width * size;
+ * a view (UArray2_view) keeps the stride of the array it looks into and
+ * does not own its elements
  */
 struct T {
         int width, height;
         int size;
-        UArray_T rows; /* UArray_T of 'height' UArray_Ts,
-                          each of length 'width' and size 'size' */
+        size_t stride;  /* bytes from one row to the next */
+        char *elems;
+        bool mapped;    /* elems came from a mapping, for HugeMem_free */
+        bool view;      /* elems belong to another array */
 };
 
-static inline UArray_T row(T a, int j)
+static inline size_t nbytes(T a)
 {
-        UArray_T *prow = UArray_at(a->rows, j);   /* Ramsey idiom */
-        return *prow;
+        return (size_t)a->width * a->height * a->size;
 }
 
-static int is_ok(T a)
+static inline char *row(T a, int j)
 {
-        return a && UArray_length(a->rows) == a->height &&
-               UArray_size(a->rows) == sizeof(UArray_T) &&
-               (a->height == 0 || (UArray_length(row(a, 0)) == a->width
-                                   && UArray_size  (row(a, 0)) == a->size));
+        return a->elems + (size_t)j * a->stride;
 }
 
 T UArray2_new(int width, int height, int size)
 {
-        int i;  /* interates over row number */
         T array;
+        assert(width >= 0 && height >= 0 && size > 0);
+        TRACE_BEGIN("UArray2_new", "alloc");
         NEW(array);
         array->width  = width;
         array->height = height;
         array->size   = size;
-        array->rows   = UArray_new(height, sizeof(UArray_T));
-        for (i = 0; i < height; i++) {
-                UArray_T *rowp = UArray_at(array->rows, i);
-                *rowp = UArray_new(width, size);
-        }
-        assert(is_ok(array));
+        array->stride = (size_t)width * size;
+        array->view   = false;
+        array->elems  = HugeMem_alloc(nbytes(array), &array->mapped);
+        TRACE_END("UArray2_new", "alloc");
         return array;
 }
 
 void UArray2_free(T *array2)
 {
-        int i;
         assert(array2 != NULL && *array2 != NULL);
-        for (i = 0; i < (*array2)->height; i++) {
-                UArray_T p = row(*array2, i);
-                UArray_free(&p);
+        TRACE_BEGIN("UArray2_free", "alloc");
+        if (!(*array2)->view) {
+                HugeMem_free((*array2)->elems, nbytes(*array2),
+                             (*array2)->mapped);
         }
-        UArray_free(&(*array2)->rows);
         FREE(*array2);
+        TRACE_END("UArray2_free", "alloc");
+}
+
+/*
+ * Name: UArray2_view
+ *
+ * Description: makes a width x height array whose element (0, 0) is
+ * element (i, j) of array2, sharing array2's storage: writes through
+ * either are seen by both
+ *
+ * Parameters:
+ *           T array2: the array to look into
+ *           int i, j: the column and row of the view's first element
+ *           int width, height: the size of the view
+ *
+ * Returns: the view, to be freed with UArray2_free before array2 is
+ *
+ * Expects: the region lies inside array2
+ *
+ * Notes: freeing a view leaves the elements alone. Results in a checked
+ * runtime error for a NULL array2 or a region outside it
+ */
+T UArray2_view(T array2, int i, int j, int width, int height)
+{
+        assert(array2 != NULL);
+        assert(i >= 0 && j >= 0 && width >= 0 && height >= 0);
+        assert(i + width <= array2->width && j + height <= array2->height);
+        T view;
+        NEW(view);
+        view->width  = width;
+        view->height = height;
+        view->size   = array2->size;
+        view->stride = array2->stride;
+        view->elems  = row(array2, j) + (size_t)i * array2->size;
+        view->mapped = false;
+        view->view   = true;
+        return view;
 }
 
 void *UArray2_at(T array2, int i, int j)
 {
         assert(array2 != NULL);
-        return UArray_at(row(array2, j), i);
+        assert(i >= 0 && i < array2->width && j >= 0 && j < array2->height);
+        return row(array2, j) + (size_t)i * array2->size;
 }
 
 int UArray2_height(T array2)
@@ -94,13 +135,23 @@ void UArray2_map_row_major(T array2, void apply(int i, int j, T array2,
         int h = array2->height;  /* keeping height and width in registers */
         int w = array2->width;   /* avoids extra memory traffic           */
         for (int j = 0; j < h; j++) {
-                /* don't want row/UArray_at in inner loop */
-                UArray_T thisrow = row(array2, j); 
+                if (j % TRACE_BAND == 0) {
+                        if (j > 0) {
+                                TRACE_END("rows", "map");
+                        }
+                        TRACE_BEGIN_XY("rows", "map", 0, j);
+                }
+                /* don't want row lookups in inner loop */
+                char *thisrow = row(array2, j);
                 for (int i = 0; i < w; i++) {   
                         // fprintf(stderr, "[%d][%d]\n", i, j);
-                        apply(i, j, array2, UArray_at(thisrow, i), cl);
+                        apply(i, j, array2,
+                              thisrow + (size_t)i * array2->size, cl);
                 }
         }
+        if (h > 0) {
+                TRACE_END("rows", "map");
+        }
 }
 
 void UArray2_map_col_major(T array2, void apply(int i, int j, T array2, 
@@ -109,7 +160,86 @@ void UArray2_map_col_major(T array2, void apply(int i, int j, T array2,
         assert(array2 != NULL);
         int h = array2->height;  /* keeping height and width in registers */
         int w = array2->width;   /* avoids extra memory traffic           */
-        for (int i = 0; i < w; i++)
+        for (int i = 0; i < w; i++) {
+                if (i % TRACE_BAND == 0) {
+                        if (i > 0) {
+                                TRACE_END("columns", "map");
+                        }
+                        TRACE_BEGIN_XY("columns", "map", i, 0);
+                }
                 for (int j = 0; j < h; j++)
-                        apply(i, j, array2, UArray_at(row(array2, j), i), cl);
-}
\ No newline at end of file
+                        apply(i, j, array2,
+                              row(array2, j) + (size_t)i * array2->size, cl);
+        }
+        if (w > 0) {
+                TRACE_END("columns", "map");
+        }
+}
+
+/* calls apply once per row, top to bottom, with a pointer to the row's
+   contiguous storage; rows of a zero-width array are passed as NULL */
+void UArray2_map_row_spans(T array2, UArray2_spanfun apply, void *cl)
+{
+        assert(array2 != NULL && apply != NULL);
+        int h = array2->height;
+        int w = array2->width;
+        for (int j = 0; j < h; j++) {
+                if (j % TRACE_BAND == 0) {
+                        if (j > 0) {
+                                TRACE_END("rows", "map");
+                        }
+                        TRACE_BEGIN_XY("rows", "map", 0, j);
+                }
+                void *span = w > 0 ? row(array2, j) : NULL;
+                apply(j, w, array2, span, cl);
+        }
+        if (h > 0) {
+                TRACE_END("rows", "map");
+        }
+}
+
+/* visits the cols x rows region at (i0, j0): while it is larger than a
+   leaf, its longer side is halved and the first half visited before the
+   second; a leaf is visited row by row. The first regions no larger than
+   TRACE_BAND on either side are traced as one event each */
+static void map_region(T array2, int i0, int j0, int cols, int rows,
+                       UArray2_applyfun apply, void *cl, bool traced)
+{
+        if (!traced && cols <= TRACE_BAND && rows <= TRACE_BAND) {
+                TRACE_BEGIN_XY("region", "map", i0, j0);
+                map_region(array2, i0, j0, cols, rows, apply, cl, true);
+                TRACE_END("region", "map");
+        } else if (cols > UARRAY2_CO_LEAF && cols >= rows) {
+                int half = cols / 2;
+                map_region(array2, i0, j0, half, rows, apply, cl, traced);
+                map_region(array2, i0 + half, j0, cols - half, rows, apply,
+                           cl, traced);
+        } else if (rows > UARRAY2_CO_LEAF) {
+                int half = rows / 2;
+                map_region(array2, i0, j0, cols, half, apply, cl, traced);
+                map_region(array2, i0, j0 + half, cols, rows - half, apply,
+                           cl, traced);
+        } else {
+                for (int j = j0; j < j0 + rows; j++) {
+                        char *thisrow = row(array2, j);
+                        for (int i = i0; i < i0 + cols; i++) {
+                                apply(i, j, array2,
+                                      thisrow + (size_t)i * array2->size,
+                                      cl);
+                        }
+                }
+        }
+}
+
+/* calls apply on every element in the order of a recursive split of the
+   array along its longer side, down to UARRAY2_CO_LEAF x UARRAY2_CO_LEAF
+   regions. Elements that are close in the array are visited close in
+   time at every scale, whatever the cache sizes */
+void UArray2_map_cache_oblivious(T array2, UArray2_applyfun apply, void *cl)
+{
+        assert(array2 != NULL && apply != NULL);
+        if (array2->width > 0 && array2->height > 0) {
+                map_region(array2, 0, 0, array2->width, array2->height,
+                           apply, cl, false);
+        }
+}
@@ -8,8 +8,14 @@ typedef struct T *T;
 
 typedef void UArray2_applyfun(int i, int j, T array2, void *elem, void *cl);
 typedef void UArray2_mapfun(T array2, UArray2_applyfun apply, void *cl);
+/* row-span apply: row points at the 'width' contiguous elements of row j */
+typedef void UArray2_spanfun(int j, int width, T array2, void *row, void *cl);
+
+/* map_cache_oblivious stops splitting regions no wider or taller than this */
+#define UARRAY2_CO_LEAF 16
 
 extern T     UArray2_new   (int width, int height, int size);
+extern T     UArray2_view  (T array2, int i, int j, int width, int height);
 extern void  UArray2_free  (T *array2);
 extern int   UArray2_width (T array2);
 extern int   UArray2_height(T array2);
@@ -17,6 +23,9 @@ extern int   UArray2_size  (T array2);
 extern void *UArray2_at    (T array2, int i, int j);
 extern void  UArray2_map_row_major(T array2, UArray2_applyfun apply, void *cl);
 extern void  UArray2_map_col_major(T array2, UArray2_applyfun apply, void *cl);
+extern void  UArray2_map_row_spans(T array2, UArray2_spanfun apply, void *cl);
+extern void  UArray2_map_cache_oblivious(T array2, UArray2_applyfun apply,
+                                         void *cl);
 
 
 #undef T
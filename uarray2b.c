@@ -33,12 +33,18 @@
 #include <assert.h>
 #include "mem.h"
 #include "uarray2b.h"
-#include "uarray2.h"
-#include <uarray.h>
+#include "hugemem.h"
+#include "trace.h"
 
 
 #define T UArray2b_T
 
+/* blocks start on a cache line boundary */
+#define BLOCK_ALIGN 64
+
+/* the tile budget of arrays that do not pick a tilesize, 0 for none */
+static int tile_bytes = UARRAY2B_TILE_BYTES;
+
 /* Struct definition for UArray2b */
 /* Struct definition for UArray2b */
 struct T {
@@ -46,18 +52,64 @@ struct T {
     int height;
     int size;
     int blocksize;
-    /* each block is represented by a uarray */
-    /* each block is represented by a uarray */
-    UArray2_T blocks;
+    /* the blocks are stored one after the other, row of blocks by row of
+    blocks, in a single buffer from hugemem.c; each block holds its
+    blocksize * blocksize cells row by row and is padded to block_bytes */
+    int block_width;
+    size_t block_bytes;
+    /* UArray2b_map visits each block tilesize x tilesize cells at a time */
+    int tilesize;
+    char *elems;
+    bool mapped;
 };
 
+/* total size of the buffer holding every block */
+static inline size_t nbytes(T array2b)
+{
+        int block_height = (array2b->height + array2b->blocksize - 1) /
+                           array2b->blocksize;
+        return (size_t)array2b->block_width * block_height *
+               array2b->block_bytes;
+}
+
+/* first cell of the block in column block_col, row block_row of blocks */
+static inline char *block_at(T array2b, int block_col, int block_row)
+{
+        return array2b->elems +
+               ((size_t)block_row * array2b->block_width + block_col) *
+               array2b->block_bytes;
+}
+
+/* the tilesize under the current tile budget: the largest tile that fits
+   in tile_bytes, shrunk so the tiles split a block evenly (a 147 x 147
+   block of 12-byte cells gets 30 x 30 tiles rather than four of 36 and one
+   of 3). Blocks of up to UARRAY2B_TILED_TILES tiles are not tiled: walked
+   row by row they already miss in L1 only on first touch, and tiles would
+   only cut their rows into partial cache lines */
+static int default_tilesize(int blocksize, int size)
+{
+        if (tile_bytes <= 0 || (long)blocksize * blocksize * size <=
+                               (long)UARRAY2B_TILED_TILES * tile_bytes) {
+                return blocksize;
+        }
+        int fit = 1;
+        while ((long)(fit + 1) * (fit + 1) * size <= tile_bytes) {
+                fit++;
+        }
+        if (fit >= blocksize) {
+                return blocksize;
+        }
+        int tiles = (blocksize + fit - 1) / fit;
+        return (blocksize + tiles - 1) / tiles;
+}
+
 
 /*
  * Name: UArray2b_new
  * 
  * Description: Creates a new UArray2b structure with the specified width, height,
- * size, and blocksize. Allocates memory for the blocks array and initializes each
- * block with a new UArray_T.
+ * size, and blocksize. Allocates one zeroed buffer for all of the blocks, on
+ * huge pages when it is large enough (see hugemem.h).
  *
  * Parameters:
  *           int width: the width of the UArray2b
@@ -76,8 +128,8 @@ struct T {
  * Name: UArray2b_new
  * 
  * Description: Creates a new UArray2b structure with the specified width, 
- * height, size, and blocksize. Allocates memory for the blocks array and 
- * initializes each block with a new UArray_T.
+ * height, size, and blocksize. Allocates one zeroed buffer for all of the
+ * blocks, on huge pages when it is large enough (see hugemem.h).
  *
  * Parameters:
  *           int width: the width of the UArray2b
@@ -93,42 +145,82 @@ struct T {
  * non positive or 0
  */
 T UArray2b_new (int width, int height, int size, int blocksize) 
+{
+        assert(blocksize > 0);
+        assert(size > 0);
+        return UArray2b_new_tiled(width, height, size, blocksize,
+                                  default_tilesize(blocksize, size));
+}
+
+
+/*
+ * Name: UArray2b_new_tiled
+ * 
+ * Description: Creates a new UArray2b structure like UArray2b_new, whose
+ * map visits each block tilesize x tilesize cells at a time
+ *
+ * Parameters:
+ *           int width: the width of the UArray2b
+ *           int height: the height of the UArray2b
+ *           int size: the size of each element in the UArray2b
+ *           int blocksize: the size of each block in the UArray2b
+ *           int tilesize: the size of the tiles UArray2b_map visits within
+ *                         a block
+ *        
+ * Returns: the UArray2b_T we created 
+ * 
+ * Expects: valid dimensions, and 0 < tilesize <= blocksize
+ * 
+ * Notes: results in checked runtime errors for any of the dimensions being 
+ * non positive or 0, or for a tilesize larger than the blocksize
+ */
+T UArray2b_new_tiled(int width, int height, int size, int blocksize,
+                     int tilesize)
 {
         /* check for correct dimensions given */
         assert(blocksize > 0);
         assert(width > 0);
         assert(height > 0);
         assert(size > 0);
+        assert(tilesize > 0 && tilesize <= blocksize);
 
         /* create the instance of the blocked 2D array */
+        TRACE_BEGIN("UArray2b_new", "alloc");
         T array2b;
         NEW(array2b);
         array2b->width     = width;
         array2b->height    = height;
         array2b->size      = size;
         array2b->blocksize = blocksize;
+        array2b->tilesize  = tilesize;
 
-        /* get the corresponding dimensions of each block */
-        int block_width  = (width + blocksize - 1) / blocksize;
-        int block_height = (height + blocksize - 1) / blocksize;
-
-        /* create a UArray2 of blocks */
-        array2b->blocks = UArray2_new(block_width, block_height, sizeof(UArray_T));
-        assert(array2b->blocks != NULL);
-
-        /* for each element in the previous UArray2 create a UArray that 
-        represents a block */
-        for (int i = 0; i < block_width; i++) {
-                for (int j = 0; j < block_height; j++) {
-                        UArray_T *block = UArray2_at(array2b->blocks, i, j);
-                        /* create the uarray */
-                        *block = UArray_new(blocksize * blocksize, size);
-                }
-        }
+        /* get the number of blocks in a row of blocks, and the size of a
+        block rounded up to a whole number of cache lines */
+        array2b->block_width = (width + blocksize - 1) / blocksize;
+        array2b->block_bytes = ((size_t)blocksize * blocksize * size +
+                                BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+
+        array2b->elems = HugeMem_alloc(nbytes(array2b), &array2b->mapped);
+        TRACE_END("UArray2b_new", "alloc");
         return array2b;
 }
 
 
+/* Set the tile budget, in bytes, of arrays created from now on without an
+explicit tilesize; 0 or less turns tiling off */
+void UArray2b_set_tile_bytes(int nbytes)
+{
+        tile_bytes = nbytes;
+}
+
+
+/* Return the current tile budget in bytes */
+int UArray2b_tile_bytes(void)
+{
+        return tile_bytes;
+}
+
+
 /*
  * Name: UArray2b_new_64K_block
  * 
@@ -186,23 +278,12 @@ T UArray2b_new_64K_block(int width, int height, int size)
 void UArray2b_free (T *array2b) 
 {
         assert(array2b != NULL && *array2b != NULL);
-        /* purely for style (readability) and the 80 characters */
-        int blocksize = (*array2b)->blocksize;
-        
-        int block_width = ( (*array2b)->width + blocksize - 1) / blocksize;
-        int block_height = ( (*array2b)->height + blocksize - 1) / blocksize;
-
-        /* iterate through the 2D array and free each block */
-        for (int i = 0; i < block_width; i++) {
-                for (int j = 0; j < block_height; j++) {
-                        UArray_T *block = UArray2_at((*array2b)->blocks, i, j);
-                        UArray_free(block);
-                }
-        }
-        
-        /* free the actual 2d array and the container of all of the blocks */
-        UArray2_free(&((*array2b)->blocks));
+        TRACE_BEGIN("UArray2b_free", "alloc");
+
+        /* free the buffer holding all of the blocks, then the struct */
+        HugeMem_free((*array2b)->elems, nbytes(*array2b), (*array2b)->mapped);
         FREE(*array2b);
+        TRACE_END("UArray2b_free", "alloc");
 }
 
 
@@ -290,6 +371,14 @@ int UArray2b_blocksize(T array2b)
 }
 
 
+/* Return the size of the tiles UArray2b_map visits within each block */
+int UArray2b_tilesize(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->tilesize;
+}
+
+
 /*
  * Name: UArray2b_at
  * 
@@ -324,8 +413,35 @@ void *UArray2b_at(T array2b, int column, int row)
         int index = (row % blocksize) * blocksize + (column % blocksize);
 
         /* access the block and the wanted element */
-        UArray_T *block = UArray2_at(array2b->blocks, block_col, block_row);
-        return UArray_at(*block, index);
+        return block_at(array2b, block_col, block_row) +
+               (size_t)index * array2b->size;
+}
+
+
+/* visit the cols x rows cells of the block at (col0, row0), whose storage
+   starts at cell, one tile at a time and each tile row by row */
+static void map_tiles(T array2b, int col0, int row0, int cols, int rows,
+                      char *cell, void apply(int col, int row, T array2b,
+                                             void *elem, void *cl),
+                      void *cl)
+{
+        int blocksize = array2b->blocksize;
+        int tilesize = array2b->tilesize;
+        for (int r0 = 0; r0 < rows; r0 += tilesize) {
+                int rend = r0 + tilesize < rows ? r0 + tilesize : rows;
+                for (int c0 = 0; c0 < cols; c0 += tilesize) {
+                        int cend = c0 + tilesize < cols ? c0 + tilesize : cols;
+                        for (int i = r0; i < rend; i++) {
+                                char *elem = cell + ((size_t)i * blocksize +
+                                                     c0) * array2b->size;
+                                for (int j = c0; j < cend; j++) {
+                                        apply(col0 + j, row0 + i, array2b,
+                                              elem, cl);
+                                        elem += array2b->size;
+                                }
+                        }
+                }
+        }
 }
 
 
@@ -333,7 +449,8 @@ void *UArray2b_at(T array2b, int column, int row)
  * Name: UArray2b_map
  * 
  * Description: Applies the provided apply function to each element in the UArray2b,
- * iterating in row-major order. The apply function takes as arguments the column
+ * iterating block by block, each block tile by tile (see UArray2b_tilesize),
+ * and each tile in row-major order. The apply function takes as arguments the column
  * index, row index, the UArray2b, a pointer to the element, and a closure pointer.
  *
  * Parameters:
@@ -361,23 +478,125 @@ void UArray2b_map(T array2b, void apply(int col, int row, T array2b, void *elem,
         int block_height = (array2b->height + blocksize - 1) / blocksize;
 
         /* iterate throuhg the blocks and for each block iterate through all of
-        the elements */
+        the elements. Cells are read straight out of the block's storage, which
+        is laid out row by row, rather than through UArray2b_at */
         for (int block_row = 0; block_row < block_height; block_row++) {
+                int row0 = block_row * blocksize;
+                /* only the last row of blocks can stick out of the array */
+                int rows = array2b->height - row0 < blocksize ?
+                           array2b->height - row0 : blocksize;
                 for (int block_col = 0; block_col < block_width; block_col++) {
-                        for (int i = 0; i < blocksize; i++) {
-                                for (int j = 0; j < blocksize; j++) {
-                                        int col = block_col * blocksize + j;
-                                        int row = block_row * blocksize + i;
-                                        /* check for right dimensions (unused
-                                        cells)*/
-                                        if (col < array2b->width && 
-                                            row < array2b->height) {
-                                                apply(col, row, array2b, 
-                                                UArray2b_at(array2b, col, row),
-                                                cl);
-                                        }
-                                }
-                        }
+                        int col0 = block_col * blocksize;
+                        int cols = array2b->width - col0 < blocksize ?
+                                   array2b->width - col0 : blocksize;
+                        char *cell = block_at(array2b, block_col, block_row);
+
+                        TRACE_BEGIN_XY("block", "map", block_col, block_row);
+                        map_tiles(array2b, col0, row0, cols, rows, cell,
+                                  apply, cl);
+                        TRACE_END("block", "map");
+                }
+        }
+}
+
+
+/*
+ * Name: UArray2b_map_blocks
+ * 
+ * Description: Calls the provided apply function once per block of the
+ * UArray2b, in the same block order as UArray2b_map, with a pointer to the
+ * block's contiguous storage instead of to a single element.
+ *
+ * Parameters:
+ *           T array2b: the UArray2b structure
+ *           UArray2b_blockfun apply: called with the column and row of the
+ *               block's first element, the number of columns and rows of
+ *               the block inside the array, the UArray2b, the block storage
+ *               and the closure
+ *           void *cl: a closure pointer
+ *        
+ * Returns: None
+ * 
+ * Expects: array2b != NULL, apply != NULL
+ * 
+ * Notes: rows of a block are blocksize elements apart even when the block
+ * is cut short by the edge of the array; the cells past the edge are
+ * unused and may be written by the client. Results in a checked runtime
+ * error for a NULL array2b or apply
+ */
+void UArray2b_map_blocks(T array2b, UArray2b_blockfun apply, void *cl)
+{
+        assert(array2b != NULL);
+        UArray2b_map_region(array2b, 0, 0, array2b->width, array2b->height,
+                            apply, cl);
+}
+
+
+/*
+ * Name: UArray2b_map_region
+ * 
+ * Description: Like UArray2b_map_blocks, but only over the width x height
+ * region at (col, row): apply is called once for each block the region
+ * overlaps, with the part of the block inside the region, and no other
+ * block is touched.
+ *
+ * Parameters:
+ *           T array2b: the UArray2b structure
+ *           int col, row: the region's top-left element
+ *           int width, height: the size of the region
+ *           UArray2b_blockfun apply: called with the column and row of the
+ *               first element of the part, the number of columns and rows
+ *               of the part, the UArray2b, a pointer to that first element
+ *               and the closure
+ *           void *cl: a closure pointer
+ *        
+ * Returns: None
+ * 
+ * Expects: array2b != NULL, apply != NULL, the region inside the array
+ * 
+ * Notes: rows of a part are blocksize elements apart, as in a block.
+ * Results in a checked runtime error for a NULL array2b or apply or a
+ * region outside the array
+ */
+void UArray2b_map_region(T array2b, int col, int row, int width, int height,
+                         UArray2b_blockfun apply, void *cl)
+{
+        assert(array2b != NULL);
+        assert(apply != NULL);
+        assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+        assert(col + width <= array2b->width &&
+               row + height <= array2b->height);
+        if (width == 0 || height == 0) {
+                return;
+        }
+
+        int blocksize = array2b->blocksize;
+        int first_col = col / blocksize, last_col = (col + width - 1) /
+                                                    blocksize;
+        int first_row = row / blocksize, last_row = (row + height - 1) /
+                                                    blocksize;
+
+        for (int block_row = first_row; block_row <= last_row; block_row++) {
+                /* the rows of this block inside the region */
+                int row0 = block_row * blocksize > row ?
+                           block_row * blocksize : row;
+                int row1 = (block_row + 1) * blocksize < row + height ?
+                           (block_row + 1) * blocksize : row + height;
+                for (int block_col = first_col; block_col <= last_col;
+                     block_col++) {
+                        int col0 = block_col * blocksize > col ?
+                                   block_col * blocksize : col;
+                        int col1 = (block_col + 1) * blocksize < col + width ?
+                                   (block_col + 1) * blocksize : col + width;
+                        char *first = block_at(array2b, block_col, block_row)
+                                      + ((size_t)(row0 % blocksize) *
+                                         blocksize + col0 % blocksize) *
+                                        array2b->size;
+
+                        TRACE_BEGIN_XY("block", "map", block_col, block_row);
+                        apply(col0, row0, col1 - col0, row1 - row0, array2b,
+                              first, cl);
+                        TRACE_END("block", "map");
                 }
         }
 }
@@ -0,0 +1,55 @@
+#ifndef UARRAY2B_INCLUDED
+#define UARRAY2B_INCLUDED
+
+#define T UArray2b_T
+
+typedef struct T *T;
+
+/*
+ * block-granular apply: called once per block with the column and row of
+ * the block's top-left element, the number of columns and rows of the
+ * block that lie inside the array (less than blocksize only for the last
+ * block of a row or column of blocks), and a pointer to the block's
+ * storage. The element at (col + c, row + r) is at
+ * (char *)block + (r * blocksize + c) * size
+ */
+typedef void UArray2b_blockfun(int col, int row, int width, int height,
+                               T array2b, void *block, void *cl);
+
+/*
+ * Blocks are the unit of storage and can be sized for L2. UArray2b_map
+ * visits each block as a grid of tilesize x tilesize tiles, sized for L1, so
+ * the cells visited together stay in L1 even when a whole block does not.
+ * Storage is the same whatever the tilesize. A block of more than
+ * UARRAY2B_TILED_TILES times UArray2b_tile_bytes() bytes gets the largest
+ * tiles of at most that many bytes that split it evenly; smaller blocks,
+ * such as the 64K default, are visited row by row (a tilesize equal to the
+ * blocksize). UArray2b_new_tiled picks the tilesize explicitly
+ */
+#define UARRAY2B_TILE_BYTES  (16 * 1024)
+#define UARRAY2B_TILED_TILES 8
+
+extern T     UArray2b_new (int width, int height, int size, int blocksize);
+extern T     UArray2b_new_64K_block(int width, int height, int size);
+extern T     UArray2b_new_tiled(int width, int height, int size, int blocksize,
+                                int tilesize);
+extern void  UArray2b_set_tile_bytes(int nbytes);
+extern int   UArray2b_tile_bytes(void);
+extern void  UArray2b_free     (T *array2b);
+extern int   UArray2b_width    (T  array2b);
+extern int   UArray2b_height   (T  array2b);
+extern int   UArray2b_size     (T  array2b);
+extern int   UArray2b_blocksize(T  array2b);
+extern int   UArray2b_tilesize (T  array2b);
+extern void *UArray2b_at(T array2b, int column, int row);
+extern void  UArray2b_map(T array2b, void apply(int col, int row, T array2b,
+                                                void *elem, void *cl),
+                          void *cl);
+extern void  UArray2b_map_blocks(T array2b, UArray2b_blockfun apply,
+                                 void *cl);
+extern void  UArray2b_map_region(T array2b, int col, int row, int width,
+                                 int height, UArray2b_blockfun apply,
+                                 void *cl);
+
+#undef T
+#endif
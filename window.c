@@ -0,0 +1,424 @@
+/*
+ *     window.c
+ *     Locality
+ *
+ *     Implementation of the median and box filters (see window.h): the
+ *     median from sliding two-level histograms, strip by strip, and the
+ *     box from a wrapping summed-area table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "assert.h"
+#include "mem.h"
+#include "a2methods.h"
+#include "a2pixels.h"
+#include "parallel.h"
+#include "trace.h"
+#include "pnm.h"
+#include "window.h"
+
+/* new columns per median strip, at least; strips widen with the radius so
+   that starting the window histogram on each row stays a small share */
+#define STRIP 128
+
+/* rows per band, and columns per strip, of the summed-area table */
+#define BAND 32
+
+/* the median filter in progress, shared by every strip */
+struct median_job {
+        struct A2Pixels src, dst;
+        int radius;
+        unsigned maxval;
+        int strip, strips;
+        int fine_bits;                  /* values per bucket: 1 << this */
+        int buckets;
+};
+
+/* one entry of the summed-area table, per channel, modulo 2^32 */
+struct sum {
+        uint32_t c[3];
+};
+
+/* the box filter in progress */
+struct box_job {
+        struct A2Pixels src, dst;
+        int radius;
+        struct sum *table;              /* (height + 1) x (width + 1) */
+        long stride;
+};
+
+/* channel c of a pixel: 0 red, 1 green, 2 blue */
+static inline unsigned *channel(struct Pnm_rgb *pixel, int c)
+{
+        return c == 0 ? &pixel->red : c == 1 ? &pixel->green : &pixel->blue;
+}
+
+/* channel c of old pixel (i, j), clamped to maxval so that it always has a
+   histogram bin */
+static inline unsigned median_value(const struct median_job *job, int i,
+                                    int j, int c)
+{
+        unsigned v = *channel(A2Pixels_at(&job->src, i, j), c);
+        return v > job->maxval ? job->maxval : v;
+}
+
+/* adds sign times the fine bucket b of column histogram from to window
+   histogram to */
+static inline void add_bucket(uint16_t *to, const uint16_t *from, int b,
+                              int fine_bits, int sign)
+{
+        int width = 1 << fine_bits;
+        to += b << fine_bits;
+        from += b << fine_bits;
+        for (int v = 0; v < width; v++) {
+                to[v] += sign * from[v];
+        }
+}
+
+/*
+ * Name: median_channel
+ *
+ * Description: the median of channel c over the strip of new columns
+ * [x0, x1), every row
+ *
+ * Parameters:
+ *           const struct median_job *job: the filter
+ *           int c: the channel
+ *           int x0, x1: the strip
+ *           int lo, hi: the old columns the strip reads, [lo, hi)
+ *           uint16_t *fine, *coarse: histograms of columns lo .. hi - 1,
+ *           zeroed
+ *
+ * Returns: nothing
+ *
+ * Expects: fine holds buckets << fine_bits counts per column, coarse
+ * buckets
+ *
+ * Notes: a column histogram counts the old pixels at rows j - r .. j + r,
+ * edge rows repeated; the window histogram is the sum of those of columns
+ * x - r .. x + r, edge columns repeated
+ */
+static void median_channel(const struct median_job *job, int c, int x0,
+                           int x1, int lo, int hi, uint16_t *fine,
+                           uint16_t *coarse)
+{
+        const struct A2Pixels *src = &job->src;
+        int r = job->radius, fb = job->fine_bits, nb = job->buckets;
+        int values = nb << fb;
+        int last_row = src->height - 1, last_col = src->width - 1;
+        unsigned half = (unsigned)((2 * r + 1) * (2 * r + 1)) / 2;
+
+        uint16_t *window_fine = ALLOC((long)values * sizeof(*window_fine));
+        uint16_t *window_coarse = ALLOC((long)nb * sizeof(*window_coarse));
+        /* the column at which each window bucket was last brought up to
+           date */
+        int *updated = ALLOC((long)nb * sizeof(*updated));
+
+        for (int i = lo; i < hi; i++) {
+                uint16_t *f = fine + (long)(i - lo) * values;
+                uint16_t *k = coarse + (long)(i - lo) * nb;
+                for (int d = -r; d <= r; d++) {
+                        int j = A2Pixels_clamp(d, last_row);
+                        unsigned v = median_value(job, i, j, c);
+                        f[v]++;
+                        k[v >> fb]++;
+                }
+        }
+
+        for (int j = 0; j < src->height; j++) {
+                if (j > 0) {
+                        /* every column histogram moves down a row */
+                        int out = A2Pixels_clamp(j - 1 - r, last_row);
+                        int in = A2Pixels_clamp(j + r, last_row);
+                        for (int i = lo; i < hi; i++) {
+                                uint16_t *f = fine + (long)(i - lo) * values;
+                                uint16_t *k = coarse + (long)(i - lo) * nb;
+                                unsigned v = median_value(job, i, out, c);
+                                f[v]--;
+                                k[v >> fb]--;
+                                v = median_value(job, i, in, c);
+                                f[v]++;
+                                k[v >> fb]++;
+                        }
+                }
+
+                memset(window_coarse, 0, (long)nb * sizeof(*window_coarse));
+                for (int d = -r; d <= r; d++) {
+                        int i = A2Pixels_clamp(x0 + d, last_col);
+                        const uint16_t *k = coarse + (long)(i - lo) * nb;
+                        for (int b = 0; b < nb; b++) {
+                                window_coarse[b] += k[b];
+                        }
+                }
+                /* far enough back that every bucket starts from scratch */
+                for (int b = 0; b < nb; b++) {
+                        updated[b] = x0 - 2 * r - 2;
+                }
+
+                for (int x = x0; x < x1; x++) {
+                        if (x > x0) {
+                                int i_out = A2Pixels_clamp(x - 1 - r,
+                                                           last_col);
+                                int i_in = A2Pixels_clamp(x + r, last_col);
+                                const uint16_t *out = coarse +
+                                        (long)(i_out - lo) * nb;
+                                const uint16_t *in = coarse +
+                                        (long)(i_in - lo) * nb;
+                                for (int b = 0; b < nb; b++) {
+                                        window_coarse[b] += in[b] - out[b];
+                                }
+                        }
+
+                        /* the bucket holding the median */
+                        unsigned below = 0;
+                        int b = 0;
+                        while (below + window_coarse[b] <= half) {
+                                below += window_coarse[b++];
+                        }
+
+                        /* bring it up to date, from scratch if that is
+                           less work */
+                        if (2 * (x - updated[b]) > 2 * r + 1) {
+                                memset(window_fine + (b << fb), 0,
+                                       (1L << fb) * sizeof(*window_fine));
+                                for (int d = -r; d <= r; d++) {
+                                        int i = A2Pixels_clamp(x + d,
+                                                               last_col);
+                                        add_bucket(window_fine, fine +
+                                                   (long)(i - lo) * values,
+                                                   b, fb, 1);
+                                }
+                        } else {
+                                for (int t = updated[b] + 1; t <= x; t++) {
+                                        int i_out = A2Pixels_clamp(
+                                                t - 1 - r, last_col);
+                                        int i_in = A2Pixels_clamp(t + r,
+                                                                  last_col);
+                                        add_bucket(window_fine, fine +
+                                                   (long)(i_out - lo) *
+                                                   values, b, fb, -1);
+                                        add_bucket(window_fine, fine +
+                                                   (long)(i_in - lo) * values,
+                                                   b, fb, 1);
+                                }
+                        }
+                        updated[b] = x;
+
+                        int v = b << fb;
+                        while (below + window_fine[v] <= half) {
+                                below += window_fine[v++];
+                        }
+                        *channel(A2Pixels_at(&job->dst, x, j), c) =
+                                (unsigned)v;
+                }
+        }
+
+        FREE(window_fine);
+        FREE(window_coarse);
+        FREE(updated);
+}
+
+static void median_strip(int index, void *cl)
+{
+        const struct median_job *job = cl;
+        int width = job->src.width;
+        int x0 = index * job->strip;
+        int x1 = x0 + job->strip < width ? x0 + job->strip : width;
+        int lo = x0 - job->radius > 0 ? x0 - job->radius : 0;
+        int hi = x1 + job->radius < width ? x1 + job->radius : width;
+        long values = (long)job->buckets << job->fine_bits;
+
+        TRACE_BEGIN_XY("strip", "median", x0, 0);
+        uint16_t *fine = ALLOC((hi - lo) * values * sizeof(*fine));
+        uint16_t *coarse = ALLOC((long)(hi - lo) * job->buckets *
+                                 sizeof(*coarse));
+        for (int c = 0; c < 3; c++) {
+                memset(fine, 0, (hi - lo) * values * sizeof(*fine));
+                memset(coarse, 0, (long)(hi - lo) * job->buckets *
+                                  sizeof(*coarse));
+                median_channel(job, c, x0, x1, lo, hi, fine, coarse);
+        }
+        FREE(fine);
+        FREE(coarse);
+        TRACE_END("strip", "median");
+}
+
+/*
+ * Name: Window_median
+ *
+ * Description: fills dest with the median of each channel over the
+ * (2 radius + 1)-square window around each pixel of source
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of both images
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           A2Methods_UArray2 dest: an image of the same size
+ *           int radius: r
+ *           unsigned maxval: the largest channel value of the images
+ *
+ * Returns: nothing
+ *
+ * Expects: no NULL argument, images of the same size, 0 < radius <=
+ * WINDOW_MAX_RADIUS, 0 < maxval <= 65535
+ *
+ * Notes: a strip's histograms take 2 (maxval + 1) bytes per column it
+ * reads, about 80 KB for 8-bit pixels and r = 15, 20 MB for 16-bit. A
+ * channel value above maxval counts as maxval
+ */
+void Window_median(A2Methods_T methods, A2Methods_UArray2 source,
+                   A2Methods_UArray2 dest, int radius, unsigned maxval)
+{
+        assert(methods != NULL && source != NULL && dest != NULL);
+        assert(radius > 0 && radius <= WINDOW_MAX_RADIUS);
+        assert(maxval > 0 && maxval <= 65535);
+        struct median_job job;
+        A2Pixels_open(&job.src, methods, source);
+        A2Pixels_open(&job.dst, methods, dest);
+        assert(job.src.width == job.dst.width &&
+               job.src.height == job.dst.height);
+        job.radius = radius;
+        job.maxval = maxval;
+
+        /* about the square root of maxval + 1 values per bucket, and as
+           many buckets */
+        int bits = 0;
+        while ((maxval >> bits) != 0) {
+                bits++;
+        }
+        job.fine_bits = (bits + 1) / 2;
+        job.buckets = (int)((maxval >> job.fine_bits) + 1);
+
+        job.strip = 8 * radius > STRIP ? 8 * radius : STRIP;
+        job.strips = (job.src.width + job.strip - 1) / job.strip;
+        Parallel_for(job.strips, median_strip, &job);
+
+        A2Pixels_close(&job.src);
+        A2Pixels_close(&job.dst);
+}
+
+/* row sums: entry (x + 1, j + 1) sums old pixels 0 .. x of row j */
+static void sum_rows(int band, void *cl)
+{
+        const struct box_job *job = cl;
+        int y0 = band * BAND;
+        int y1 = y0 + BAND < job->src.height ? y0 + BAND : job->src.height;
+        for (int j = y0; j < y1; j++) {
+                struct sum *row = job->table + (j + 1) * job->stride;
+                struct sum run = { { 0, 0, 0 } };
+                row[0] = run;
+                for (int i = 0; i < job->src.width; i++) {
+                        const struct Pnm_rgb *p = A2Pixels_at(&job->src, i,
+                                                              j);
+                        run.c[0] += p->red;
+                        run.c[1] += p->green;
+                        run.c[2] += p->blue;
+                        row[i + 1] = run;
+                }
+        }
+}
+
+/* column sums over BAND columns of row sums, walking down so each row of
+   the strip is read in order */
+static void sum_columns(int strip, void *cl)
+{
+        const struct box_job *job = cl;
+        int x0 = strip * BAND + 1;
+        int x1 = x0 + BAND <= job->src.width + 1 ? x0 + BAND
+                                                 : job->src.width + 1;
+        for (int j = 2; j <= job->src.height; j++) {
+                struct sum *row = job->table + j * job->stride;
+                const struct sum *above = row - job->stride;
+                for (int x = x0; x < x1; x++) {
+                        for (int c = 0; c < 3; c++) {
+                                row[x].c[c] += above[x].c[c];
+                        }
+                }
+        }
+}
+
+static void box_band(int band, void *cl)
+{
+        const struct box_job *job = cl;
+        int r = job->radius, width = job->src.width;
+        int y0 = band * BAND;
+        int y1 = y0 + BAND < job->src.height ? y0 + BAND : job->src.height;
+
+        TRACE_BEGIN_XY("band", "box", 0, y0);
+        for (int j = y0; j < y1; j++) {
+                int top = j - r > 0 ? j - r : 0;
+                int bottom = j + r + 1 < job->src.height ? j + r + 1
+                                                         : job->src.height;
+                const struct sum *above = job->table + top * job->stride;
+                const struct sum *below = job->table + bottom * job->stride;
+                for (int i = 0; i < width; i++) {
+                        int left = i - r > 0 ? i - r : 0;
+                        int right = i + r + 1 < width ? i + r + 1 : width;
+                        uint32_t count = (uint32_t)(right - left) *
+                                         (uint32_t)(bottom - top);
+                        struct Pnm_rgb *out = A2Pixels_at(&job->dst, i, j);
+                        for (int c = 0; c < 3; c++) {
+                                /* exact, modulo 2^32, see window.h */
+                                uint32_t s = below[right].c[c] -
+                                             below[left].c[c] -
+                                             above[right].c[c] +
+                                             above[left].c[c];
+                                *channel(out, c) = (unsigned)
+                                        (((uint64_t)s + count / 2) / count);
+                        }
+                }
+        }
+        TRACE_END("band", "box");
+}
+
+/*
+ * Name: Window_box
+ *
+ * Description: fills dest with the mean of each channel over the part of
+ * the (2 radius + 1)-square window around each pixel of source that lies
+ * in the image
+ *
+ * Parameters:
+ *           A2Methods_T methods: the methods of both images
+ *           A2Methods_UArray2 source: the image holding Pnm_rgb pixels
+ *           A2Methods_UArray2 dest: an image of the same size
+ *           int radius: r
+ *
+ * Returns: nothing
+ *
+ * Expects: no NULL argument, images of the same size, 0 < radius <=
+ * WINDOW_MAX_RADIUS, channel values at most 65535
+ *
+ * Notes: the table takes 12 bytes per pixel, as much as the image
+ */
+void Window_box(A2Methods_T methods, A2Methods_UArray2 source,
+                A2Methods_UArray2 dest, int radius)
+{
+        assert(methods != NULL && source != NULL && dest != NULL);
+        assert(radius > 0 && radius <= WINDOW_MAX_RADIUS);
+        struct box_job job;
+        A2Pixels_open(&job.src, methods, source);
+        A2Pixels_open(&job.dst, methods, dest);
+        assert(job.src.width == job.dst.width &&
+               job.src.height == job.dst.height);
+        job.radius = radius;
+
+        /* row 0 and column 0 are zero */
+        job.stride = (long)job.src.width + 1;
+        job.table = ALLOC(job.stride * ((long)job.src.height + 1) *
+                          sizeof(*job.table));
+        memset(job.table, 0, job.stride * sizeof(*job.table));
+
+        int bands = (job.src.height + BAND - 1) / BAND;
+        TRACE_BEGIN("table", "box");
+        Parallel_for(bands, sum_rows, &job);
+        Parallel_for((job.src.width + BAND - 1) / BAND, sum_columns, &job);
+        TRACE_END("table", "box");
+        Parallel_for(bands, box_band, &job);
+
+        FREE(job.table);
+        A2Pixels_close(&job.src);
+        A2Pixels_close(&job.dst);
+}
@@ -0,0 +1,50 @@
+#ifndef WINDOW_INCLUDED
+#define WINDOW_INCLUDED
+/****************************************************************
+ *
+ *                         window.h
+ *
+ *       Filters of a Pnm_rgb image over the (2r + 1) x (2r + 1)
+ *       window centered on each pixel, each channel on its own, at a
+ *       cost per pixel that does not grow with r:
+ *
+ *         Window_median  the median of the window; pixels past the
+ *                        edges repeat the nearest edge pixel, as in
+ *                        convolve.h
+ *         Window_box     the mean of the window, rounded; the window
+ *                        is cut at the edges and the mean taken over
+ *                        the pixels left
+ *
+ *       Window_median keeps a histogram of every column of 2r + 1
+ *       pixels and of the whole window (Perreault and Hebert): going
+ *       down a row moves each column histogram by one pixel, and going
+ *       across adds one column histogram and removes another. The
+ *       histograms have two levels, coarse buckets and the values in
+ *       them, so finding the median reads one coarse histogram and one
+ *       bucket, and a bucket of the window histogram is only brought up
+ *       to date when the median falls in it. The image is split into
+ *       strips of columns, each with the histograms of its own columns
+ *       and spread over threads (see parallel.h).
+ *
+ *       Window_box builds a summed-area table, each entry the sum of
+ *       every pixel above and to the left, as prefix sums along rows
+ *       and then down columns, both in parallel; any window is then
+ *       four lookups. Entries are 32 bits and wrap around: the
+ *       difference that gives a window is still exact, since no
+ *       window of WINDOW_MAX_RADIUS sums past 2^32.
+ *
+ *****************************************************************/
+
+#include "a2methods.h"
+
+/* largest r accepted; keeps window counts and sums within 16 and 32
+   bits */
+#define WINDOW_MAX_RADIUS 127
+
+extern void Window_median(A2Methods_T methods, A2Methods_UArray2 source,
+                          A2Methods_UArray2 dest, int radius,
+                          unsigned maxval);
+extern void Window_box(A2Methods_T methods, A2Methods_UArray2 source,
+                       A2Methods_UArray2 dest, int radius);
+
+#endif